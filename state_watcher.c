@@ -1,7 +1,10 @@
 #include "state_watcher.h"
 #include <linux/kernel.h>
+#include <linux/export.h>
 #include <linux/slab.h>
 #include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/refcount.h>
 
 #ifdef DEBUG
 #define STATE_WATCHER_DEBUG(fmt, ...) \
@@ -15,6 +18,130 @@
 #define STATE_WATCHER_ERR(fmt, ...) \
     printk(KERN_ERR "wlbt: state_watcher: " fmt "\n", ##__VA_ARGS__)
 
+#define STATE_WATCHER_F_VALID \
+    (STATE_WATCHER_F_COALESCE | STATE_WATCHER_F_ASYNC_ACTIONS | STATE_WATCHER_F_MERGE_ACTIONS)
+
+/* Slab cache for watch items, shared by all watchers */
+static struct kmem_cache *watch_item_cache;
+static unsigned int watch_item_cache_users;
+static DEFINE_MUTEX(watch_item_cache_mutex);
+
+/**
+ * watch_item_cache_get() - Take a reference on the watch item cache
+ *
+ * The first initialized watcher creates the cache, later ones share it.
+ * Items are cacheline aligned so the work function walking one item never
+ * bounces a line that another CPU is updating for a neighbouring item.
+ *
+ * Context: Process context
+ * Return: 0 on success, -ENOMEM if the cache cannot be created
+ */
+static int watch_item_cache_get(void)
+{
+    int ret = 0;
+
+    mutex_lock(&watch_item_cache_mutex);
+    if (!watch_item_cache_users) {
+        watch_item_cache = KMEM_CACHE(watch_item, SLAB_HWCACHE_ALIGN);
+        if (!watch_item_cache) {
+            STATE_WATCHER_ERR("Failed to create watch item cache");
+            ret = -ENOMEM;
+        }
+    }
+    if (!ret) {
+        watch_item_cache_users++;
+    }
+    mutex_unlock(&watch_item_cache_mutex);
+
+    return ret;
+}
+
+/**
+ * watch_item_cache_put() - Drop a reference on the watch item cache
+ *
+ * Destroys the cache when the last watcher is cleaned up. All items of the
+ * watcher must have been freed.
+ *
+ * Context: Process context
+ */
+static void watch_item_cache_put(void)
+{
+    mutex_lock(&watch_item_cache_mutex);
+    if (!--watch_item_cache_users) {
+        kmem_cache_destroy(watch_item_cache);
+        watch_item_cache = NULL;
+    }
+    mutex_unlock(&watch_item_cache_mutex);
+}
+
+/**
+ * watch_group_free() - Free a group and the items it owns
+ * @group: Watch group, the head item is not freed
+ *
+ * Context: Any context
+ */
+static void watch_group_free(struct watch_group *group)
+{
+    unsigned int i;
+
+    for (i = 0; i < group->count; i++) {
+        if (group->items[i]) {
+            kmem_cache_free(watch_item_cache, group->items[i]);
+        }
+    }
+    kfree(group->states);
+    kfree(group);
+}
+
+/**
+ * watch_item_ref_owner() - Item whose reference count covers an item
+ * @item: Watch item
+ *
+ * Members of a group are freed with the group, so their references are
+ * taken on the group head; a reference on a member pins the whole group.
+ *
+ * Context: Any context
+ * Return: The group head for group members, @item otherwise
+ */
+static struct watch_item *watch_item_ref_owner(struct watch_item *item)
+{
+    return item->group ? item->group->head : item;
+}
+
+/**
+ * watch_item_get() - Take a reference on a watch item
+ * @item: Watch item
+ *
+ * Context: Any context
+ */
+static void watch_item_get(struct watch_item *item)
+{
+    refcount_inc(&watch_item_ref_owner(item)->refcnt);
+}
+
+/**
+ * watch_item_put() - Drop a reference on a watch item
+ * @item: Watch item
+ *
+ * The watcher's item list holds one reference, the work function takes
+ * another for every item it is evaluating. The item is freed with the
+ * last reference. Items of a group are only referenced through the group
+ * head, which frees them along with the group, see watch_item_ref_owner().
+ *
+ * Context: Any context
+ */
+static void watch_item_put(struct watch_item *item)
+{
+    item = watch_item_ref_owner(item);
+
+    if (refcount_dec_and_test(&item->refcnt)) {
+        if (item->group) {
+            watch_group_free(item->group);
+        }
+        kmem_cache_free(watch_item_cache, item);
+    }
+}
+
 /**
  * state_watcher_state_changed_with_hysteresis() - Check if state has changed with hysteresis filtering
  * @item: Pointer to watch item to evaluate
@@ -108,91 +235,543 @@ static bool state_watcher_state_changed_with_hysteresis(struct watch_item *item,
     return false;
 }
 
+/**
+ * state_watcher_band_state() - Map a value onto a dual-threshold band
+ * @item: Watch item with band_enter >= band_exit
+ * @value: Sample or average to classify
+ *
+ * Values at or above band_enter are state 1, values at or below band_exit
+ * are state 0, and values in between keep the last action state, so a
+ * signal hovering around one threshold cannot flap.
+ *
+ * Return: Band state (0 or 1)
+ */
+static unsigned long state_watcher_band_state(struct watch_item *item, unsigned long value)
+{
+    if (value >= item->band_enter) {
+        return 1;
+    }
+    if (value <= item->band_exit) {
+        return 0;
+    }
+
+    return item->last_action_state;
+}
+
+/**
+ * state_watcher_ewma_limit() - Largest sample the EWMA can average
+ * @shift: EWMA shift of the item
+ *
+ * The average is kept with STATE_WATCHER_EWMA_FRAC_BITS fraction bits and
+ * scaled by 2^@shift while it is updated; the limit leaves room for the
+ * rounding term as well. Any band_enter accepted by
+ * state_watcher_hysteresis_valid() is below this limit, which at
+ * STATE_WATCHER_EWMA_MAX_SHIFT is 255 on 32-bit and 2^40 - 1 on 64-bit.
+ *
+ * Return: Upper bound for samples fed to the average
+ */
+static inline unsigned long state_watcher_ewma_limit(unsigned int shift)
+{
+    return ULONG_MAX >> (STATE_WATCHER_EWMA_FRAC_BITS + shift);
+}
+
+/**
+ * state_watcher_filter_state() - Apply the hysteresis policy of an item
+ * @item: Pointer to watch item to evaluate
+ * @sample: New state value returned by the state function
+ * @current_time: Time of the sample (in jiffies)
+ * @filtered: Returns the state to act on
+ *
+ * Policies (enum watch_hysteresis_mode):
+ * - WATCH_HYST_COUNT: the sample itself, after hysteresis consecutive
+ *   identical samples, see state_watcher_state_changed_with_hysteresis()
+ * - WATCH_HYST_BAND: band state of the sample, see state_watcher_band_state()
+ * - WATCH_HYST_EWMA: band state of an exponential moving average of the
+ *   samples, weight 1/2^ewma_shift for the newest sample, rounded towards
+ *   the sample so a steady sample equal to band_enter enters. Samples are
+ *   clamped to state_watcher_ewma_limit() so the fixed point average
+ *   cannot overflow; the clamped values are still above the band.
+ * - WATCH_HYST_TIME: the sample itself, once it has been seen for at least
+ *   debounce_ms without interruption
+ *
+ * Context: Called from state watcher work function with watcher lock held
+ * Return: true if *@filtered differs from the last action state and should
+ *         trigger the action, false otherwise
+ */
+static bool state_watcher_filter_state(struct watch_item *item, unsigned long sample,
+                                       unsigned long current_time, unsigned long *filtered)
+{
+    switch (item->hysteresis_mode) {
+    case WATCH_HYST_BAND:
+        *filtered = state_watcher_band_state(item, sample);
+        return *filtered != item->last_action_state;
+
+    case WATCH_HYST_EWMA:
+        /* Fixed point with STATE_WATCHER_EWMA_FRAC_BITS fraction bits */
+        sample = min(sample, state_watcher_ewma_limit(item->ewma_shift));
+        if (!item->ewma_valid) {
+            item->ewma_avg = sample << STATE_WATCHER_EWMA_FRAC_BITS;
+            item->ewma_valid = true;
+        } else {
+            unsigned long target = sample << STATE_WATCHER_EWMA_FRAC_BITS;
+            /* Round towards the sample so a steady sample is reached exactly */
+            unsigned long round = target > item->ewma_avg ? (1UL << item->ewma_shift) - 1 : 0;
+
+            item->ewma_avg = ((item->ewma_avg << item->ewma_shift) - item->ewma_avg +
+                              target + round) >> item->ewma_shift;
+        }
+        *filtered = state_watcher_band_state(item,
+                                             item->ewma_avg >> STATE_WATCHER_EWMA_FRAC_BITS);
+        return *filtered != item->last_action_state;
+
+    case WATCH_HYST_TIME:
+        *filtered = sample;
+        if (sample == item->last_action_state) {
+            item->candidate_state = sample;
+            return false;
+        }
+        if (sample != item->candidate_state) {
+            item->candidate_state = sample;
+            item->candidate_since = current_time;
+        }
+        return !time_before(current_time, item->candidate_since + item->debounce_jiffies);
+
+    default:
+        *filtered = sample;
+        return state_watcher_state_changed_with_hysteresis(item, sample);
+    }
+}
+
+/**
+ * state_watcher_due_less() - Due-time tree ordering
+ * @a: Node of the item being inserted
+ * @b: Node already in the tree
+ *
+ * Return: true if @a is due before @b
+ */
+static bool state_watcher_due_less(struct rb_node *a, const struct rb_node *b)
+{
+    return time_before(rb_entry(a, struct watch_item, due_node)->next_due,
+                       rb_entry(b, struct watch_item, due_node)->next_due);
+}
+
+/**
+ * state_watcher_queue_item() - Insert an item into the due-time tree
+ * @watcher: Pointer to state watcher
+ * @item: Item with next_due set, not in the tree
+ *
+ * Context: Caller holds watcher->lock
+ * Return: true if @item is now the earliest item of the watcher
+ */
+static bool state_watcher_queue_item(struct state_watcher *watcher, struct watch_item *item)
+{
+    rb_add_cached(&item->due_node, &watcher->due_tree, state_watcher_due_less);
+
+    return rb_first_cached(&watcher->due_tree) == &item->due_node;
+}
+
+/**
+ * state_watcher_dequeue_item() - Remove an item from the due-time tree
+ * @watcher: Pointer to state watcher
+ * @item: Item to remove, may already be off the tree
+ *
+ * Context: Caller holds watcher->lock
+ */
+static void state_watcher_dequeue_item(struct state_watcher *watcher, struct watch_item *item)
+{
+    if (!RB_EMPTY_NODE(&item->due_node)) {
+        rb_erase_cached(&item->due_node, &watcher->due_tree);
+        RB_CLEAR_NODE(&item->due_node);
+    }
+}
+
+/**
+ * state_watcher_due_delay() - Delay until a due time
+ * @watcher: Pointer to state watcher
+ * @due: Due time in jiffies
+ *
+ * Normally the time left until @due, or 0 if it has passed. With
+ * STATE_WATCHER_F_COALESCE the wakeup is moved up to the next multiple of
+ * the base interval in absolute jiffies, so coalesced tickers with
+ * commensurate intervals wake up together.
+ *
+ * Context: Any context
+ * Return: Delay in jiffies
+ */
+static unsigned long state_watcher_due_delay(struct state_watcher *watcher, unsigned long due)
+{
+    unsigned long now = jiffies;
+    unsigned long delay = time_after(due, now) ? due - now : 0;
+    unsigned long base, rem;
+
+    if (!(watcher->flags & STATE_WATCHER_F_COALESCE)) {
+        return delay;
+    }
+
+    base = msecs_to_jiffies(watcher->base_interval_ms);
+    if (!base) {
+        return delay;
+    }
+
+    rem = (now + delay) % base;
+
+    return rem ? delay + base - rem : delay;
+}
+
+/**
+ * state_watcher_rearm() - Arm the work for the earliest due item
+ * @watcher: Pointer to state watcher
+ *
+ * Moves the pending work (or queues it) to the next due time of the
+ * earliest item, or runs it right away while pushed states are waiting on
+ * push_list. Nothing is queued when the watcher has no items; adding one
+ * calls this again.
+ *
+ * Context: Caller holds watcher->lock
+ */
+static void state_watcher_rearm(struct state_watcher *watcher)
+{
+    struct rb_node *node = rb_first_cached(&watcher->due_tree);
+
+    if (!READ_ONCE(watcher->running)) {
+        return;
+    }
+
+    /* A push queued while the work evaluated must not wait for a poll */
+    if (!list_empty(&watcher->push_list)) {
+        mod_delayed_work(system_wq, &watcher->work, 0);
+        return;
+    }
+
+    if (!node) {
+        return;
+    }
+
+    mod_delayed_work(system_wq, &watcher->work,
+                     state_watcher_due_delay(watcher,
+                                             rb_entry(node, struct watch_item, due_node)->next_due));
+}
+
+/**
+ * state_watcher_action_work_func() - Deliver the queued transitions of an item
+ * @work: action_work of the item
+ *
+ * Calls the action function for each queued transition in order, without
+ * the watcher lock. Transitions of a removed item are discarded. Drops the
+ * reference taken when the work was queued.
+ *
+ * Context: Workqueue context (action_wq)
+ */
+static void state_watcher_action_work_func(struct work_struct *work)
+{
+    struct watch_item *item = container_of(work, struct watch_item, action_work);
+    struct state_watcher *watcher = item->watcher;
+    struct watch_transition t;
+    unsigned long flags;
+
+    spin_lock_irqsave(&watcher->lock, flags);
+
+    while (item->actions_pending && !item->removed) {
+        t = item->actions[item->actions_head];
+        item->actions_head = (item->actions_head + 1) % STATE_WATCHER_ACTION_QUEUE_LEN;
+        item->actions_pending--;
+
+        spin_unlock_irqrestore(&watcher->lock, flags);
+
+        STATE_WATCHER_DEBUG("Item %s: executing action, state change %lu -> %lu",
+                           item->name, t.old_state, t.new_state);
+
+        item->action_func(t.old_state, t.new_state, item->private_data);
+
+        spin_lock_irqsave(&watcher->lock, flags);
+        WRITE_ONCE(item->action_count, item->action_count + 1);
+        this_cpu_inc(watcher->stats->actions);
+    }
+    item->actions_pending = 0;
+
+    spin_unlock_irqrestore(&watcher->lock, flags);
+
+    watch_item_put(item);
+}
+
+/**
+ * state_watcher_queue_action() - Queue a state transition for delivery
+ * @watcher: Pointer to state watcher
+ * @item: Item whose state changed
+ * @old_state: State of the last transition
+ * @new_state: New state
+ *
+ * Appends the transition to the item's action queue and queues its
+ * action_work. Queued transitions always chain (each one starts where the
+ * previous one ended), so merging two keeps the first start and the last
+ * end; a merge that ends where it started delivers nothing. Transitions
+ * are merged into the newest queued one with STATE_WATCHER_F_MERGE_ACTIONS
+ * (A->B->C is delivered as A->C), and otherwise only when the queue of
+ * STATE_WATCHER_ACTION_QUEUE_LEN entries is full.
+ *
+ * Context: Caller holds watcher->lock
+ */
+static void state_watcher_queue_action(struct state_watcher *watcher, struct watch_item *item,
+                                       unsigned long old_state, unsigned long new_state)
+{
+    unsigned int n = item->actions_pending;
+
+    if (n && ((watcher->flags & STATE_WATCHER_F_MERGE_ACTIONS) ||
+              n == STATE_WATCHER_ACTION_QUEUE_LEN)) {
+        struct watch_transition *last =
+            &item->actions[(item->actions_head + n - 1) % STATE_WATCHER_ACTION_QUEUE_LEN];
+
+        last->new_state = new_state;
+        if (last->old_state == new_state) {
+            item->actions_pending--;
+        }
+        return;
+    }
+
+    item->actions[(item->actions_head + n) % STATE_WATCHER_ACTION_QUEUE_LEN] =
+        (struct watch_transition){ .old_state = old_state, .new_state = new_state };
+    item->actions_pending++;
+
+    /* A group member pins its group until the work ran */
+    watch_item_get(item);
+    if (!queue_work(watcher->action_wq, &item->action_work)) {
+        /* Already queued, it will find the new transition */
+        refcount_dec(&watch_item_ref_owner(item)->refcnt);
+    }
+}
+
+/**
+ * state_watcher_commit_item() - Commit a probed state of one item
+ * @watcher: Pointer to state watcher
+ * @item: Probed item, referenced by the caller
+ * @state_result: State returned by the item's (or its group's) probe
+ * @current_time: Time of this work run (in jiffies)
+ *
+ * Commits the result under the lock: statistics, forced state override and
+ * hysteresis. The action function runs unlocked, and its outcome is
+ * committed afterwards. With STATE_WATCHER_F_ASYNC_ACTIONS the transition
+ * is committed right away and handed to the action queue instead, so a
+ * slow action never delays the checks of other items. An item removed while it is being probed keeps its
+ * memory through the caller's reference, but nothing is committed to it.
+ *
+ * Evaluations of one item never run concurrently: the watcher's work never
+ * runs concurrently with itself, and with a check workqueue each item has
+ * a single non-reentrant check_work. The hysteresis state therefore needs
+ * no protection across the unlocked sections.
+ *
+ * Context: Workqueue context, watcher lock not held
+ */
+static void state_watcher_commit_item(struct state_watcher *watcher, struct watch_item *item,
+                                      unsigned long state_result, unsigned long current_time)
+{
+    unsigned long new_state, old_state;
+    unsigned long flags;
+    bool state_changed;
+
+    /* Check if forced state has expired */
+    if (item->is_forced && time_after(current_time, item->forced_state_expire_time)) {
+        item->is_forced = false;
+        STATE_WATCHER_DEBUG("Item %s: forced state expired, resuming normal watching",
+                           item->name);
+    }
+
+    spin_lock_irqsave(&watcher->lock, flags);
+
+    if (item->removed) {
+        spin_unlock_irqrestore(&watcher->lock, flags);
+        return;
+    }
+
+    WRITE_ONCE(item->check_count, item->check_count + 1);
+    this_cpu_inc(watcher->stats->checks);
+
+    /* Use forced state if active, otherwise use state result */
+    if (item->is_forced) {
+        new_state = item->forced_state;
+        STATE_WATCHER_DEBUG("Item %s: using forced state %lu (state func returned %lu)", 
+                           item->name, new_state, state_result);
+
+        /* For forced state, ignore hysteresis and trigger action immediately */
+        state_changed = (item->last_action_state != new_state);
+        STATE_WATCHER_DEBUG("Item %s: forced state bypass hysteresis, state change %lu -> %lu",
+                           item->name, item->last_action_state, new_state);
+        item->current_state = new_state;
+    } else {
+        STATE_WATCHER_DEBUG("Item %s: state %lu -> %lu", 
+                           item->name, item->current_state, state_result);
+
+        /* Hysteresis policy of the item, may map the sample to a filtered state */
+        state_changed = state_watcher_filter_state(item, state_result, current_time, &new_state);
+        item->current_state = state_result;
+    }
+
+    old_state = item->last_action_state;
+    item->last_check_time = current_time;
+
+    if (state_changed && item->action_func && watcher->action_wq) {
+        /* The transition is decided now, the action runs on the action queue */
+        item->last_action_state = new_state;
+        state_watcher_queue_action(watcher, item, old_state, new_state);
+        spin_unlock_irqrestore(&watcher->lock, flags);
+        return;
+    }
+
+    spin_unlock_irqrestore(&watcher->lock, flags);
+
+    if (!state_changed || !item->action_func) {
+        return;
+    }
+
+    /* State changed - call action function (may sleep) */
+    STATE_WATCHER_DEBUG("Item %s: executing action, state change %lu -> %lu",
+                       item->name, old_state, new_state);
+
+    item->action_func(old_state, new_state, item->private_data);
+
+    spin_lock_irqsave(&watcher->lock, flags);
+    if (!item->removed) {
+        item->last_action_state = new_state;
+        WRITE_ONCE(item->action_count, item->action_count + 1);
+        this_cpu_inc(watcher->stats->actions);
+    }
+    spin_unlock_irqrestore(&watcher->lock, flags);
+}
+
+/**
+ * state_watcher_check_item() - Probe one due item and commit the result
+ * @watcher: Pointer to state watcher
+ * @item: Due item or group head, referenced by the caller
+ * @current_time: Time of this work run (in jiffies)
+ *
+ * The state function runs without the watcher lock, so slow or sleeping
+ * probes (bus reads, firmware queries) neither disable interrupts nor hold
+ * up state_watcher_add_item() and state_watcher_remove_item(). For a group
+ * head, the group's batch state function fills the states of all members
+ * in one call, and each member then goes through its own forced state,
+ * hysteresis and action handling. A state pushed by state_watcher_notify()
+ * since the last check is committed instead of probing.
+ *
+ * Context: Workqueue context, watcher lock not held
+ */
+static void state_watcher_check_item(struct state_watcher *watcher, struct watch_item *item,
+                                     unsigned long current_time)
+{
+    struct watch_group *group = item->group;
+    unsigned int i;
+
+    if (!group) {
+        unsigned long flags, state_result;
+        bool pushed;
+
+        /* A state pushed by state_watcher_notify() replaces the probe */
+        spin_lock_irqsave(&watcher->lock, flags);
+        pushed = item->push_pending;
+        state_result = item->pushed_state;
+        item->push_pending = false;
+        spin_unlock_irqrestore(&watcher->lock, flags);
+
+        if (!pushed) {
+            if (!item->state_func) {
+                return;
+            }
+            /* Probe without the lock, the state function may sleep */
+            state_result = item->state_func(item->private_data);
+        }
+
+        state_watcher_commit_item(watcher, item, state_result, current_time);
+        return;
+    }
+
+    /* One probe for the whole group, the group's items are owned by the head */
+    group->batch_state_func(group->states, group->count, group->private_data);
+
+    for (i = 0; i < group->count; i++) {
+        state_watcher_commit_item(watcher, group->items[i], group->states[i], current_time);
+    }
+}
+
+/**
+ * state_watcher_check_work_func() - Evaluate one item on the check workqueue
+ * @work: check_work of the item
+ *
+ * Drops the reference taken when the work was queued.
+ *
+ * Context: Workqueue context (check_wq)
+ */
+static void state_watcher_check_work_func(struct work_struct *work)
+{
+    struct watch_item *item = container_of(work, struct watch_item, check_work);
+    struct state_watcher *watcher = item->watcher;
+
+    if (READ_ONCE(watcher->running) && !READ_ONCE(item->removed)) {
+        state_watcher_check_item(watcher, item, jiffies);
+    }
+    watch_item_put(item);
+}
+
 /**
  * state_watcher_work_func() - Main periodic monitoring work function
  * @work: Work structure embedded in delayed_work (container_of to get watcher)
  *
- * This is the core monitoring function that runs periodically via the Linux
- * kernel workqueue mechanism. It iterates through all watch items and performs
- * state checking and action triggering according to their individual configurations.
- * The function handles timing, locking, state evaluation, and automatic rescheduling.
+ * This is the core monitoring function that runs via the Linux kernel
+ * workqueue mechanism whenever the earliest watch item is due. It snapshots
+ * the due items, evaluates them one by one without holding the watcher lock
+ * and rearms itself for the next due time.
  *
  * Execution flow:
  * 1. Extract watcher from delayed_work container structure
  * 2. Check if watcher is still running (early exit if stopped)
- * 3. Acquire spinlock to protect item list traversal
- * 4. Iterate through all watch items with safe list traversal
- * 5. Check each item's interval timing for readiness
- * 6. Call state functions and evaluate state changes
- * 7. Release spinlock temporarily for action function calls
- * 8. Re-acquire spinlock and continue iteration
- * 9. Schedule next work execution if still running
+ * 3. Under the spinlock, move items pushed by state_watcher_notify() to a
+ *    local batch, then take every due item off the due-time tree, requeue
+ *    it one interval later and add it to the batch with a reference
+ * 4. Release the spinlock
+ * 5. For each batched item, call state_watcher_check_item() and drop the
+ *    reference (freeing the item if it was removed meanwhile)
+ *
+ * With a check workqueue (config max_workers > 1), step 3 queues each due
+ * item's check_work instead of batching it, and the workqueue spreads the
+ * evaluations over up to max_workers workers. An item whose previous check
+ * is still pending is skipped rather than queued twice.
+ * 6. Arm the work for the earliest remaining due time if still running
  *
  * Timing management:
  * - Uses current jiffies for time calculations
- * - Compares against item->last_check_time + interval
- * - Updates last_check_time after successful state check
+ * - Items whose next_due has been reached are due; items that are not due
+ *   are never visited
+ * - Updates last_check_time and next_due on every state check
  * - Handles forced state expiration automatically
- * - Schedules next execution using base_interval_ms
+ * - Schedules next execution for the earliest next_due
  *
  * Lock management strategy:
- * - Acquires spinlock with interrupts disabled (irqsave)
- * - Temporarily releases lock during action function calls
- * - Re-acquires lock after action completion
- * - Uses list_for_each_entry_safe for safe iteration during lock release
- * - Rechecks watcher running state after lock re-acquisition
- *
- * State evaluation process:
- * - Calls item->state_func() to get current state
- * - Handles forced state override logic
- * - Applies hysteresis filtering via state_changed_with_hysteresis()
- * - Updates statistics (check_count, total_checks)
- * - Triggers action functions when state changes detected
- *
- * Forced state handling:
- * - Checks for forced state expiration using jiffies comparison
- * - Automatically clears expired forced states
- * - Uses forced_state value instead of state_func() result when active
- * - Bypasses hysteresis for forced states (immediate action triggering)
- * - Logs forced state usage and expiration events
- *
- * Action function execution:
- * - Temporarily releases spinlock to allow blocking operations
- * - Calls action_func with old_state, new_state, and private_data
- * - Updates last_action_state and action_count statistics
- * - Handles potential item list changes during action execution
- * - Re-validates watcher state after action completion
- *
- * Error handling and robustness:
- * - Graceful handling of NULL state functions
- * - Safe list iteration even with concurrent modifications
- * - Automatic recovery from individual item failures
- * - Continues processing other items if one item fails
- * - Maintains system stability despite user code issues
+ * - The spinlock (irqsave) is held only to build the batch and to commit
+ *   each result, never across state or action function calls
+ * - A slow probe therefore never delays add/remove or interrupts
+ * - Batch entries are referenced, so removal during a probe is safe
+ * - Stops evaluating the batch when the watcher is stopped
  *
  * Self-scheduling mechanism:
- * - Automatically reschedules using schedule_delayed_work()
- * - Uses watcher->base_interval_ms for consistent timing
+ * - Automatically rearms via state_watcher_rearm()
+ * - Sleeps until the earliest item is due instead of ticking every base interval
  * - Only reschedules if watcher->running flag is still true
  * - Ensures continuous monitoring until explicitly stopped
  *
  * Performance characteristics:
- * - Processes multiple items efficiently in single work execution
- * - Minimizes lock hold time by releasing during action calls
- * - Scales well with increasing number of watch items
- * - Balances responsiveness with CPU overhead
+ * - Cost per run is O(due items * log n), independent of idle items
+ * - Lock hold time per item is a few comparisons, whatever the probe costs
  *
- * Context: Workqueue context (process context, can sleep during action calls)
- * Synchronization: Uses watcher spinlock for item list protection
+ * Context: Workqueue context (process context, state and action functions may sleep)
+ * Synchronization: Uses watcher spinlock for due-time tree and result commits
  * Return: void (no return value)
  *
  */
-static void state_watcher_work_func(struct work_struct *work);
+static void state_watcher_work_func(struct work_struct *work)
 {
     struct state_watcher *watcher = container_of(work, struct state_watcher, work.work);
     struct watch_item *item, *tmp;
+    struct rb_node *node;
     unsigned long current_time = jiffies;
     unsigned long flags;
+    LIST_HEAD(due);
 
     if (!READ_ONCE(watcher->running)) {
         return;
@@ -200,87 +779,52 @@ static void state_watcher_work_func(struct work_struct *work);
 
     spin_lock_irqsave(&watcher->lock, flags);
 
-    /* Iterate through all watch items */
-    list_for_each_entry_safe(item, tmp, &watcher->item_list, list) {
-        /* Check if it's time to watch this item */
-        if (time_after(current_time, item->last_check_time + 
-                      msecs_to_jiffies(item->interval_ms))) {
-            unsigned long new_state;
-
-            /* Check if forced state has expired */
-            if (item->is_forced && time_after(current_time, item->forced_state_expire_time)) {
-                item->is_forced = false;
-                STATE_WATCHER_DEBUG("Item %s: forced state expired, resuming normal watching",
-                                   item->name);
-            }
+    /* Pushed items first, their reference moves to the batch */
+    list_for_each_entry_safe(item, tmp, &watcher->push_list, push_node) {
+        list_del_init(&item->push_node);
+        list_add_tail(&item->due_list, &due);
+    }
 
-            /* Call state function */
-            if (item->state_func) {
-                unsigned long state_result = item->state_func(item->private_data);
-                bool state_changed;
-
-                item->check_count++;
-                watcher->total_checks++;
-
-                /* Use forced state if active, otherwise use state result */
-                if (item->is_forced) {
-                    new_state = item->forced_state;
-                    STATE_WATCHER_DEBUG("Item %s: using forced state %lu (state func returned %lu)", 
-                                       item->name, new_state, state_result);
-                } else {
-                    new_state = state_result;
-                    STATE_WATCHER_DEBUG("Item %s: state %lu -> %lu", 
-                                       item->name, item->current_state, new_state);
-                }
-
-                /* Check for state change with hysteresis (ignore hysteresis for forced state) */
-                if (item->is_forced) {
-                    /* For forced state, ignore hysteresis and trigger action immediately */
-                    state_changed = (item->last_action_state != new_state);
-                    STATE_WATCHER_DEBUG("Item %s: forced state bypass hysteresis, state change %lu -> %lu",
-                                       item->name, item->last_action_state, new_state);
-                } else {
-                    /* Normal hysteresis checking */
-                    state_changed = state_watcher_state_changed_with_hysteresis(item, new_state);
-                }
-
-                if (state_changed) {
-                    /* State changed - call action function */
-                    if (item->action_func) {
-                        /* Release spinlock before calling action (may sleep) */
-                        spin_unlock_irqrestore(&watcher->lock, flags);
-
-                        STATE_WATCHER_DEBUG("Item %s: executing action, state change %lu -> %lu",
-                                           item->name, item->last_action_state, new_state);
-
-                        item->action_func(item->last_action_state, new_state, item->private_data);
-
-                        spin_lock_irqsave(&watcher->lock, flags);
-
-                        /* List might have changed - recheck watcher state */
-                        if (!READ_ONCE(watcher->running)) {
-                            spin_unlock_irqrestore(&watcher->lock, flags);
-                            return;
-                        }
-
-                        item->last_action_state = new_state;
-                        item->action_count++;
-                        watcher->total_actions++;
-                    }
-                }
-
-                item->current_state = new_state;
-                item->last_check_time = current_time;
+    /* Snapshot due items only, earliest first */
+    while ((node = rb_first_cached(&watcher->due_tree))) {
+        item = rb_entry(node, struct watch_item, due_node);
+        if (time_before(current_time, item->next_due)) {
+            break;
+        }
+
+        /* Requeue for the next check, the batch holds its own reference */
+        state_watcher_dequeue_item(watcher, item);
+        item->next_due = current_time + msecs_to_jiffies(item->interval_ms);
+        state_watcher_queue_item(watcher, item);
+
+        refcount_inc(&item->refcnt);
+        if (watcher->check_wq) {
+            if (!queue_work(watcher->check_wq, &item->check_work)) {
+                /* Previous check still pending, the list keeps the item */
+                refcount_dec(&item->refcnt);
             }
+        } else if (!item->push_pending) {
+            list_add_tail(&item->due_list, &due);
+        } else {
+            /* Already batched by a push, which takes precedence over polling */
+            refcount_dec(&item->refcnt);
         }
     }
 
     spin_unlock_irqrestore(&watcher->lock, flags);
 
-    /* Schedule next execution */
-    if (READ_ONCE(watcher->running)) {
-        schedule_delayed_work(&watcher->work, msecs_to_jiffies(watcher->base_interval_ms));
+    list_for_each_entry_safe(item, tmp, &due, due_list) {
+        list_del(&item->due_list);
+        if (READ_ONCE(watcher->running)) {
+            state_watcher_check_item(watcher, item, current_time);
+        }
+        watch_item_put(item);
     }
+
+    /* Schedule next execution for the earliest due item */
+    spin_lock_irqsave(&watcher->lock, flags);
+    state_watcher_rearm(watcher);
+    spin_unlock_irqrestore(&watcher->lock, flags);
 }
 
 /**
@@ -319,7 +863,8 @@ static void state_watcher_work_func(struct work_struct *work);
  * Prerequisites:
  * - watcher structure must be allocated (stack or heap)
  * - Structure doesn't need pre-initialization or zeroing
- * - Can be called multiple times (re-initializes cleanly)
+ * - An initialized watcher must be cleaned up with state_watcher_cleanup()
+ *   before it is initialized again
  *
  * Thread safety:
  * - Safe to call from any process context
@@ -328,11 +873,12 @@ static void state_watcher_work_func(struct work_struct *work);
  *
  * Error conditions:
  * - Returns -EINVAL if watcher pointer is NULL
- * - Always succeeds with valid watcher pointer
- * - Does not perform memory allocation (cannot fail due to OOM)
+ * - Returns -ENOMEM if the shared watch item cache cannot be created
+ *   (only possible for the first watcher)
  *
  * Context: Process context
- * Return: 0 on success, -EINVAL if watcher is NULL
+ * Return: 0 on success, -EINVAL if watcher is NULL, -ENOMEM if the watch
+ *         item cache cannot be created
  *
  * Example:
  * @code
@@ -395,25 +941,136 @@ static void state_watcher_work_func(struct work_struct *work);
  */
 int state_watcher_init(struct state_watcher *watcher, unsigned long base_interval_ms)
 {
-    if (!watcher) {
+    struct state_watcher_config config = {
+        .base_interval_ms = base_interval_ms,
+    };
+
+    return state_watcher_init_config(watcher, &config);
+}
+EXPORT_SYMBOL_GPL(state_watcher_init);
+
+/**
+ * state_watcher_init_config() - Initialize state watcher framework with a configuration
+ * @watcher: Pointer to state watcher structure to initialize
+ * @config: Watcher configuration, see struct state_watcher_config
+ *
+ * Same as state_watcher_init(), with access to options that do not fit its
+ * signature. state_watcher_init() is equivalent to a configuration that only
+ * sets base_interval_ms.
+ *
+ * Context: Process context
+ * Return: 0 on success, -EINVAL if watcher or config is NULL or config has
+ *         unknown flags, -ENOMEM if the watch item cache, the statistics or
+ *         one of the check and action workqueues cannot be allocated
+ *
+ * Example:
+ * @code
+ * // Background health checks that must not wake idle CPUs
+ * struct state_watcher_config cfg = {
+ *     .base_interval_ms = 1000,
+ *     .flags = STATE_WATCHER_F_COALESCE,
+ * };
+ *
+ * ret = state_watcher_init_config(&health_watcher, &cfg);
+ * if (ret)
+ *     return ret;
+ *
+ * // Thousands of slow firmware probes, up to 8 in flight
+ * struct state_watcher_config fw_cfg = {
+ *     .base_interval_ms = 500,
+ *     .max_workers = 8,
+ * };
+ *
+ * ret = state_watcher_init_config(&fw_watcher, &fw_cfg);
+ * @endcode
+ */
+int state_watcher_init_config(struct state_watcher *watcher,
+                              const struct state_watcher_config *config)
+{
+    unsigned int flags;
+    int ret;
+
+    if (!watcher || !config || (config->flags & ~STATE_WATCHER_F_VALID)) {
         return -EINVAL;
     }
 
+    /* Merging transitions needs the action queue */
+    flags = config->flags;
+    if (flags & STATE_WATCHER_F_MERGE_ACTIONS) {
+        flags |= STATE_WATCHER_F_ASYNC_ACTIONS;
+    }
+
+    ret = watch_item_cache_get();
+    if (ret) {
+        return ret;
+    }
+
     memset(watcher, 0, sizeof(*watcher));
 
+    watcher->stats = alloc_percpu(struct state_watcher_pcpu_stats);
+    if (!watcher->stats) {
+        ret = -ENOMEM;
+        goto err_put_cache;
+    }
+    atomic_set(&watcher->nr_items, 0);
+
+    if (config->max_workers > 1) {
+        watcher->check_wq = alloc_workqueue("state_watcher", WQ_UNBOUND,
+                                            config->max_workers);
+        if (!watcher->check_wq) {
+            STATE_WATCHER_ERR("Failed to create check workqueue");
+            ret = -ENOMEM;
+            goto err_free_stats;
+        }
+    }
+
+    if (flags & STATE_WATCHER_F_ASYNC_ACTIONS) {
+        watcher->action_wq = alloc_workqueue("state_watcher_action", WQ_UNBOUND, 0);
+        if (!watcher->action_wq) {
+            STATE_WATCHER_ERR("Failed to create action workqueue");
+            ret = -ENOMEM;
+            goto err_destroy_check_wq;
+        }
+    }
+
     INIT_LIST_HEAD(&watcher->item_list);
-    INIT_DELAYED_WORK(&watcher->work, state_watcher_work_func);
+    INIT_LIST_HEAD(&watcher->group_list);
+    INIT_LIST_HEAD(&watcher->push_list);
+    watcher->due_tree = RB_ROOT_CACHED;
+    if (flags & STATE_WATCHER_F_COALESCE) {
+        INIT_DEFERRABLE_WORK(&watcher->work, state_watcher_work_func);
+    } else {
+        INIT_DELAYED_WORK(&watcher->work, state_watcher_work_func);
+    }
     spin_lock_init(&watcher->lock);
 
-    watcher->base_interval_ms = base_interval_ms ? base_interval_ms : DEFAULT_STATE_WATCHER_INTERVAL_MS;
+    watcher->base_interval_ms = config->base_interval_ms ? config->base_interval_ms :
+                                DEFAULT_STATE_WATCHER_INTERVAL_MS;
+    watcher->flags = flags;
     watcher->running = false;
     watcher->initialized = true;
 
-    STATE_WATCHER_INFO("State watcher initialized with base interval %lu ms", 
-                       watcher->base_interval_ms);
+    STATE_WATCHER_INFO("State watcher initialized with base interval %lu ms%s, %u workers%s", 
+                       watcher->base_interval_ms,
+                       watcher->flags & STATE_WATCHER_F_COALESCE ? " (coalesced)" : "",
+                       watcher->check_wq ? config->max_workers : 1,
+                       watcher->action_wq ? ", async actions" : "");
 
     return 0;
+
+err_destroy_check_wq:
+    if (watcher->check_wq) {
+        destroy_workqueue(watcher->check_wq);
+        watcher->check_wq = NULL;
+    }
+err_free_stats:
+    free_percpu(watcher->stats);
+    watcher->stats = NULL;
+err_put_cache:
+    watch_item_cache_put();
+    return ret;
 }
+EXPORT_SYMBOL_GPL(state_watcher_init_config);
 
 /**
  * state_watcher_force_state() - Force a watch item to report a specific state
@@ -686,6 +1343,7 @@ int state_watcher_force_state(struct watch_item *item, unsigned long forced_stat
 
     return 0;
 }
+EXPORT_SYMBOL_GPL(state_watcher_force_state);
 
 /**
  * state_watcher_clear_forced_state() - Clear forced state and resume normal monitoring
@@ -1007,6 +1665,7 @@ int state_watcher_clear_forced_state(struct watch_item *item)
 
     return 0;
 }
+EXPORT_SYMBOL_GPL(state_watcher_clear_forced_state);
 
 /**
  * state_watcher_is_state_forced() - Check if a watch item has an active forced state
@@ -1325,6 +1984,7 @@ bool state_watcher_is_state_forced(struct watch_item *item, unsigned long *remai
 
     return item->is_forced;
 }
+EXPORT_SYMBOL_GPL(state_watcher_is_state_forced);
 
 /**
  * state_watcher_cleanup() - Clean up state watcher and free all resources
@@ -1483,16 +2143,41 @@ void state_watcher_cleanup(struct state_watcher *watcher)
 
     /* Remove and free all items */
     spin_lock_irqsave(&watcher->lock, flags);
+    list_for_each_entry_safe(item, tmp, &watcher->push_list, push_node) {
+        list_del_init(&item->push_node);
+        refcount_dec(&item->refcnt);
+    }
     list_for_each_entry_safe(item, tmp, &watcher->item_list, list) {
         list_del(&item->list);
-        kfree(item);
+        if (!item->group) {
+            watch_item_put(item);
+        }
+    }
+    list_for_each_entry_safe(item, tmp, &watcher->group_list, list) {
+        list_del(&item->list);
+        watch_item_put(item);
     }
+    watcher->due_tree = RB_ROOT_CACHED;
+    atomic_set(&watcher->nr_items, 0);
     spin_unlock_irqrestore(&watcher->lock, flags);
 
+    if (watcher->check_wq) {
+        destroy_workqueue(watcher->check_wq);
+        watcher->check_wq = NULL;
+    }
+    if (watcher->action_wq) {
+        destroy_workqueue(watcher->action_wq);
+        watcher->action_wq = NULL;
+    }
+
+    free_percpu(watcher->stats);
+    watcher->stats = NULL;
     watcher->initialized = false;
+    watch_item_cache_put();
 
     STATE_WATCHER_INFO("State watcher cleaned up");
 }
+EXPORT_SYMBOL_GPL(state_watcher_cleanup);
 
 /**
  * state_watcher_start() - Start periodic watching and monitoring
@@ -1671,6 +2356,8 @@ void state_watcher_cleanup(struct state_watcher *watcher)
  */
 int state_watcher_start(struct state_watcher *watcher)
 {
+    unsigned long flags;
+
     if (!watcher || !watcher->initialized) {
         return -EINVAL;
     }
@@ -1681,11 +2368,14 @@ int state_watcher_start(struct state_watcher *watcher)
     }
 
     /* running=true is already visible due to cmpxchg barrier semantics */
-    schedule_delayed_work(&watcher->work, msecs_to_jiffies(watcher->base_interval_ms));
+    spin_lock_irqsave(&watcher->lock, flags);
+    state_watcher_rearm(watcher);
+    spin_unlock_irqrestore(&watcher->lock, flags);
 
     STATE_WATCHER_INFO("State watcher started");
     return 0;
 }
+EXPORT_SYMBOL_GPL(state_watcher_start);
 
 /**
  * state_watcher_stop() - Stop periodic watching and monitoring
@@ -1709,6 +2399,8 @@ int state_watcher_start(struct state_watcher *watcher)
  *
  * State preservation:
  * - Watch items remain in the list (not removed)
+ * - Pushed states not evaluated yet are dropped, like those pushed while
+ *   the watcher is stopped
  * - Item configurations and statistics preserved
  * - Watcher remains initialized and ready for restart
  * - Current states and hysteresis counters maintained
@@ -1867,22 +2559,247 @@ int state_watcher_start(struct state_watcher *watcher)
  * }
  * @endcode
  */
-void state_watcher_stop(struct state_watcher *watcher)
+void state_watcher_stop(struct state_watcher *watcher)
+{
+    struct watch_item *item, *tmp;
+    unsigned long flags;
+
+    if (!watcher || !watcher->initialized) {
+        return;
+    }
+
+    /* Atomic test-and-clear */
+    if (cmpxchg(&watcher->running, true, false) != true) {
+        /* Already stopped */
+        return;
+    }
+
+    /* cmpxchg has implicit memory barrier semantics */
+    cancel_delayed_work_sync(&watcher->work);
+
+    /* Wait for parallel checks queued by the last run, then their actions */
+    if (watcher->check_wq) {
+        flush_workqueue(watcher->check_wq);
+    }
+    if (watcher->action_wq) {
+        flush_workqueue(watcher->action_wq);
+    }
+
+    /*
+     * Drop pushes the last run did not take, as notify does while stopped;
+     * a stale push_node would keep later pushes from queuing the work.
+     */
+    spin_lock_irqsave(&watcher->lock, flags);
+    list_for_each_entry_safe(item, tmp, &watcher->push_list, push_node) {
+        list_del_init(&item->push_node);
+        item->push_pending = false;
+        refcount_dec(&item->refcnt);
+    }
+    spin_unlock_irqrestore(&watcher->lock, flags);
+
+    STATE_WATCHER_INFO("State watcher stopped");
+}
+EXPORT_SYMBOL_GPL(state_watcher_stop);
+
+/**
+ * state_watcher_item_interval() - Validate a requested item interval
+ * @watcher: Pointer to state watcher
+ * @requested_ms: Requested interval in milliseconds (0 = base interval)
+ *
+ * Context: Any context
+ * Return: The interval to use, or 0 if @requested_ms is not a multiple of
+ *         the base interval
+ */
+static unsigned long state_watcher_item_interval(struct state_watcher *watcher,
+                                                 unsigned long requested_ms)
+{
+    unsigned long interval_ms = requested_ms ? requested_ms : watcher->base_interval_ms;
+
+    /* interval_ms must be multiple of base_interval_ms */
+    if (interval_ms % watcher->base_interval_ms != 0) {
+        STATE_WATCHER_ERR("Invalid interval %lu ms: must be multiple of base interval %lu ms",
+                         interval_ms, watcher->base_interval_ms);
+        return 0;
+    }
+
+    /* interval_ms must be >= base_interval_ms */
+    if (interval_ms < watcher->base_interval_ms) {
+        STATE_WATCHER_ERR("Invalid interval %lu ms: must be >= base interval %lu ms",
+                         interval_ms, watcher->base_interval_ms);
+        return 0;
+    }
+
+    return interval_ms;
+}
+
+/**
+ * state_watcher_hysteresis_valid() - Check the hysteresis policy of an item
+ * @init: Item parameters
+ *
+ * Return: true if hysteresis_mode and its parameters can be used
+ */
+static bool state_watcher_hysteresis_valid(const struct watch_item_init *init)
+{
+    switch (init->hysteresis_mode) {
+    case WATCH_HYST_COUNT:
+    case WATCH_HYST_TIME:
+        return true;
+    case WATCH_HYST_EWMA:
+        if (init->ewma_shift > STATE_WATCHER_EWMA_MAX_SHIFT) {
+            return false;
+        }
+        /* Average is kept in fixed point, leave room for the scaling */
+        if (init->band_enter > state_watcher_ewma_limit(STATE_WATCHER_EWMA_MAX_SHIFT) ||
+            init->band_exit > state_watcher_ewma_limit(STATE_WATCHER_EWMA_MAX_SHIFT)) {
+            return false;
+        }
+        fallthrough;
+    case WATCH_HYST_BAND:
+        return init->band_exit <= init->band_enter;
+    default:
+        return false;
+    }
+}
+
+/**
+ * watch_item_create() - Allocate and initialize a watch item
+ * @watcher: Pointer to state watcher
+ * @init: Item parameters
+ * @interval_ms: Validated interval, see state_watcher_item_interval()
+ * @gfp: Allocation flags
+ *
+ * The item is not linked into the watcher yet and holds one reference.
+ *
+ * Context: Any context allowed by @gfp
+ * Return: The new item, or NULL on allocation failure
+ */
+static struct watch_item *watch_item_create(struct state_watcher *watcher,
+                                            const struct watch_item_init *init,
+                                            unsigned long interval_ms, gfp_t gfp)
+{
+    struct watch_item *item;
+
+    item = kmem_cache_zalloc(watch_item_cache, gfp);
+    if (!item) {
+        return NULL;
+    }
+
+    /* Initialize item, the watcher's list owns the first reference */
+    INIT_LIST_HEAD(&item->list);
+    INIT_LIST_HEAD(&item->due_list);
+    INIT_LIST_HEAD(&item->push_node);
+    RB_CLEAR_NODE(&item->due_node);
+    item->mode = init->mode;
+    refcount_set(&item->refcnt, 1);
+    item->removed = false;
+    item->watcher = watcher;
+    INIT_WORK(&item->check_work, state_watcher_check_work_func);
+    INIT_WORK(&item->action_work, state_watcher_action_work_func);
+    item->interval_ms = interval_ms;
+    item->hysteresis = init->hysteresis;
+    item->hysteresis_mode = init->hysteresis_mode;
+    item->band_enter = init->band_enter;
+    item->band_exit = init->band_exit;
+    item->ewma_shift = init->ewma_shift ? init->ewma_shift : STATE_WATCHER_EWMA_DEFAULT_SHIFT;
+    item->debounce_jiffies = msecs_to_jiffies(init->debounce_ms);
+    item->state_func = init->state_func;
+    item->action_func = init->action_func;
+    item->private_data = init->private_data;
+
+    /* Initialize state */
+    item->current_state = 0;
+    item->last_action_state = 0;
+    item->last_check_time = jiffies;
+    item->next_due = item->last_check_time + msecs_to_jiffies(interval_ms);
+
+    /* Initialize hysteresis state */
+    item->candidate_state = 0;
+    item->consecutive_count = 0;
+
+    /* Initialize forced state management */
+    item->forced_state = 0;
+    item->forced_state_expire_time = 0;
+    item->is_forced = false;
+
+    /* Initialize statistics */
+    item->check_count = 0;
+    item->action_count = 0;
+
+    /* Set name */
+    if (init->name) {
+        strncpy(item->name, init->name, sizeof(item->name) - 1);
+        item->name[sizeof(item->name) - 1] = '\0';
+    } else {
+        snprintf(item->name, sizeof(item->name), "item_%p", item);
+    }
+
+    return item;
+}
+
+/**
+ * state_watcher_item_check() - Validate the parameters of a stand-alone item
+ * @watcher: Pointer to state watcher
+ * @init: Item parameters
+ *
+ * Return: The interval to use, see state_watcher_item_interval(), or 0 if
+ *         @init cannot be used
+ */
+static unsigned long state_watcher_item_check(struct state_watcher *watcher,
+                                              const struct watch_item_init *init)
 {
-    if (!watcher || !watcher->initialized) {
-        return;
+    if (init->mode > WATCH_ITEM_PUSH_POLL || !state_watcher_hysteresis_valid(init)) {
+        return 0;
     }
 
-    /* Atomic test-and-clear */
-    if (cmpxchg(&watcher->running, true, false) != true) {
-        /* Already stopped */
-        return;
+    /* Only push-only items can do without a state function */
+    if (!init->state_func && init->mode != WATCH_ITEM_PUSH) {
+        return 0;
     }
 
-    /* cmpxchg has implicit memory barrier semantics */
-    cancel_delayed_work_sync(&watcher->work);
+    return state_watcher_item_interval(watcher, init->interval_ms);
+}
 
-    STATE_WATCHER_INFO("State watcher stopped");
+/**
+ * state_watcher_link_item() - Make a new stand-alone item visible to the watcher
+ * @watcher: Pointer to state watcher
+ * @item: Item from watch_item_create()
+ *
+ * Adds @item to the item list and, unless push-only, to the due-time tree.
+ *
+ * Context: Caller holds watcher->lock
+ * Return: true if @item is due first and the work has to be rearmed
+ */
+static bool state_watcher_link_item(struct state_watcher *watcher, struct watch_item *item)
+{
+    list_add_tail(&item->list, &watcher->item_list);
+    atomic_inc(&watcher->nr_items);
+
+    return item->mode != WATCH_ITEM_PUSH && state_watcher_queue_item(watcher, item);
+}
+
+/**
+ * state_watcher_unlink_item() - Hide a stand-alone item from the watcher
+ * @watcher: Pointer to state watcher
+ * @item: Item to remove
+ *
+ * Removes @item from the item list and the due-time tree and drops the
+ * reference of a pending push. An ongoing check of @item commits nothing.
+ * The caller drops the list reference with watch_item_put() after
+ * releasing the lock.
+ *
+ * Context: Caller holds watcher->lock
+ */
+static void state_watcher_unlink_item(struct state_watcher *watcher, struct watch_item *item)
+{
+    list_del(&item->list);
+    atomic_dec(&watcher->nr_items);
+    state_watcher_dequeue_item(watcher, item);
+    if (!list_empty(&item->push_node)) {
+        /* Pending push, drop the reference it holds */
+        list_del_init(&item->push_node);
+        refcount_dec(&item->refcnt);
+    }
+    item->removed = true;
 }
 
 /**
@@ -1910,14 +2827,15 @@ void state_watcher_stop(struct state_watcher *watcher)
  * - init->action_func: Can be NULL for monitoring-only items
  *
  * Memory management:
- * - Item allocated with kzalloc(GFP_KERNEL)
+ * - Item allocated from the shared watch item slab cache with init->gfp
+ *   (GFP_KERNEL when 0; GFP_ATOMIC allows adding from atomic context)
  * - Name string copied into item->name[32] buffer (truncated if needed)
  * - private_data pointer stored as-is (user manages lifetime)
  * - Automatic cleanup on watcher destruction
  *
  * Initial state setup:
  * - current_state and last_action_state initialized to 0
- * - last_check_time set to current jiffies
+ * - last_check_time set to current jiffies, first check one interval later
  * - Hysteresis counters reset to initial state
  * - Statistics counters zeroed
  * - Forced state disabled initially
@@ -1940,7 +2858,7 @@ void state_watcher_stop(struct state_watcher *watcher)
  * - Returns NULL if interval validation fails
  * - Returns NULL if memory allocation fails
  *
- * Context: Process context
+ * Context: Process context, or any context when init->gfp allows it
  * Return: Pointer to created watch_item on success, NULL on error
  *
  * Example:
@@ -2122,78 +3040,32 @@ struct watch_item *state_watcher_add_item(struct state_watcher *watcher,
     unsigned long flags;
     unsigned long interval_ms;
 
-    if (!watcher || !watcher->initialized || !init || !init->state_func) {
-        return NULL;
-    }
-
-    /* Validate interval_ms */
-    interval_ms = init->interval_ms ? init->interval_ms : watcher->base_interval_ms;
-
-    /* interval_ms must be multiple of base_interval_ms */
-    if (interval_ms % watcher->base_interval_ms != 0) {
-        state_watcher_err("Invalid interval %lu ms: must be multiple of base interval %lu ms",
-                         interval_ms, watcher->base_interval_ms);
+    if (!watcher || !watcher->initialized || !init) {
         return NULL;
     }
 
-    /* interval_ms must be >= base_interval_ms */
-    if (interval_ms < watcher->base_interval_ms) {
-        state_watcher_err("Invalid interval %lu ms: must be >= base interval %lu ms",
-                         interval_ms, watcher->base_interval_ms);
+    interval_ms = state_watcher_item_check(watcher, init);
+    if (!interval_ms) {
         return NULL;
     }
 
-    item = kzalloc(sizeof(*item), GFP_KERNEL);
+    item = watch_item_create(watcher, init, interval_ms, init->gfp ? init->gfp : GFP_KERNEL);
     if (!item) {
         return NULL;
     }
 
-    /* Initialize item */
-    INIT_LIST_HEAD(&item->list);
-    item->interval_ms = interval_ms;
-    item->hysteresis = init->hysteresis;
-    item->state_func = init->state_func;
-    item->action_func = init->action_func;
-    item->private_data = init->private_data;
-
-    /* Initialize state */
-    item->current_state = 0;
-    item->last_action_state = 0;
-    item->last_check_time = jiffies;
-
-    /* Initialize hysteresis state */
-    item->candidate_state = 0;
-    item->consecutive_count = 0;
-
-    /* Initialize forced state management */
-    item->forced_state = 0;
-    item->forced_state_expire_time = 0;
-    item->is_forced = false;
-
-    /* Initialize statistics */
-    item->check_count = 0;
-    item->action_count = 0;
-
-    /* Set name */
-    if (init->name) {
-        strncpy(item->name, init->name, sizeof(item->name) - 1);
-        item->name[sizeof(item->name) - 1] = '\0';
-    } else {
-        snprintf(item->name, sizeof(item->name), "item_%p", item);
-    }
-
     spin_lock_irqsave(&watcher->lock, flags);
-
-    /* Add to list */
-    list_add_tail(&item->list, &watcher->item_list);
-
+    if (state_watcher_link_item(watcher, item)) {
+        state_watcher_rearm(watcher);
+    }
     spin_unlock_irqrestore(&watcher->lock, flags);
 
-    STATE_WATCHER_INFO("Added watch item '%s' (addr:%p, interval:%lu ms, hysteresis:%lu)",
+    STATE_WATCHER_DEBUG("Added watch item '%s' (addr:%p, interval:%lu ms, hysteresis:%lu)",
                        item->name, item, item->interval_ms, item->hysteresis);
 
     return item;
 }
+EXPORT_SYMBOL_GPL(state_watcher_add_item);
 
 /**
  * state_watcher_remove_item() - Remove a watch item from the state watcher
@@ -2238,6 +3110,7 @@ struct watch_item *state_watcher_add_item(struct state_watcher *watcher,
  * Error conditions:
  * - Returns -EINVAL if watcher is NULL or uninitialized
  * - Returns -EINVAL if item is NULL
+ * - Returns -EBUSY if item belongs to a watch group
  * - Always succeeds with valid parameters
  * - Does not validate item membership in watcher
  *
@@ -2254,7 +3127,8 @@ struct watch_item *state_watcher_add_item(struct state_watcher *watcher,
  * - Consider removing dependent items if applicable
  *
  * Context: Process context
- * Return: 0 on success, -EINVAL if parameters are invalid
+ * Return: 0 on success, -EINVAL if parameters are invalid, -EBUSY if the
+ *         item is part of a group (use state_watcher_remove_group())
  *
  * Example:
  * @code
@@ -2456,18 +3330,406 @@ int state_watcher_remove_item(struct state_watcher *watcher, struct watch_item *
         return -EINVAL;
     }
 
+    if (item->group) {
+        STATE_WATCHER_ERR("Item %s belongs to a group, remove the group instead", item->name);
+        return -EBUSY;
+    }
+
     spin_lock_irqsave(&watcher->lock, flags);
+    state_watcher_unlink_item(watcher, item);
+    spin_unlock_irqrestore(&watcher->lock, flags);
 
-    /* Remove from list */
-    list_del(&item->list);
+    STATE_WATCHER_DEBUG("Removed watch item '%s' (addr:%p)", item->name, item);
+    watch_item_put(item);
+
+    return 0;
+}
+EXPORT_SYMBOL_GPL(state_watcher_remove_item);
+
+/**
+ * state_watcher_add_items() - Add several watch items at once
+ * @watcher: Pointer to initialized state watcher
+ * @init: Array of @n item parameters, see state_watcher_add_item()
+ * @n: Number of items
+ * @out: Array of @n pointers receiving the new items
+ *
+ * Same as calling state_watcher_add_item() for each entry of @init, but
+ * validates and allocates all items before taking the watcher lock once to
+ * link them, and rearms the work at most once. Either all items are added
+ * or none.
+ *
+ * Context: Any context allowed by the gfp flags of the entries
+ * Return: 0 on success, -EINVAL for invalid parameters, -ENOMEM on
+ *         allocation failure
+ *
+ * Example:
+ * @code
+ * for (i = 0; i < NR_PORTS; i++) {
+ *     inits[i] = (struct watch_item_init) {
+ *         .interval_ms = 1000,
+ *         .state_func = port_link_func,
+ *         .action_func = port_link_action,
+ *         .private_data = &card->ports[i],
+ *     };
+ * }
+ * ret = state_watcher_add_items(&card->watcher, inits, NR_PORTS, card->port_items);
+ * @endcode
+ */
+int state_watcher_add_items(struct state_watcher *watcher, const struct watch_item_init *init,
+                            unsigned int n, struct watch_item **out)
+{
+    unsigned long interval_ms;
+    unsigned long flags;
+    bool rearm = false;
+    unsigned int i;
+
+    if (!watcher || !watcher->initialized || !init || !out || !n) {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < n; i++) {
+        interval_ms = state_watcher_item_check(watcher, &init[i]);
+        if (!interval_ms) {
+            STATE_WATCHER_ERR("Invalid parameters for item %u of %u", i, n);
+            goto err_free;
+        }
+
+        out[i] = watch_item_create(watcher, &init[i], interval_ms,
+                                   init[i].gfp ? init[i].gfp : GFP_KERNEL);
+        if (!out[i]) {
+            goto err_free;
+        }
+    }
+
+    spin_lock_irqsave(&watcher->lock, flags);
+    for (i = 0; i < n; i++) {
+        rearm |= state_watcher_link_item(watcher, out[i]);
+    }
+    if (rearm) {
+        state_watcher_rearm(watcher);
+    }
+    spin_unlock_irqrestore(&watcher->lock, flags);
+
+    STATE_WATCHER_DEBUG("Added %u watch items", n);
+
+    return 0;
+
+err_free:
+    /* Nothing is linked yet, the items only hold their initial reference */
+    while (i--) {
+        watch_item_put(out[i]);
+        out[i] = NULL;
+    }
+    return interval_ms ? -ENOMEM : -EINVAL;
+}
+EXPORT_SYMBOL_GPL(state_watcher_add_items);
+
+/**
+ * state_watcher_remove_items() - Remove several watch items at once
+ * @watcher: Pointer to state watcher
+ * @items: Array of @n items from state_watcher_add_item() or
+ *         state_watcher_add_items(), NULL entries are skipped
+ * @n: Number of entries
+ *
+ * Same as calling state_watcher_remove_item() for each entry, but unlinks
+ * all items under a single acquisition of the watcher lock. The work needs
+ * no rearm; it skips over the gap on its next run.
+ *
+ * Context: Process context
+ * Return: 0 on success, -EINVAL for invalid parameters, -EBUSY if an item
+ *         belongs to a group (nothing is removed in both cases)
+ */
+int state_watcher_remove_items(struct state_watcher *watcher, struct watch_item **items,
+                               unsigned int n)
+{
+    unsigned long flags;
+    unsigned int i;
+
+    if (!watcher || !watcher->initialized || !items) {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (items[i] && items[i]->group) {
+            STATE_WATCHER_ERR("Item %s belongs to a group, remove the group instead",
+                              items[i]->name);
+            return -EBUSY;
+        }
+    }
+
+    spin_lock_irqsave(&watcher->lock, flags);
+    for (i = 0; i < n; i++) {
+        if (items[i]) {
+            state_watcher_unlink_item(watcher, items[i]);
+        }
+    }
+    spin_unlock_irqrestore(&watcher->lock, flags);
+
+    for (i = 0; i < n; i++) {
+        if (items[i]) {
+            watch_item_put(items[i]);
+        }
+    }
+
+    STATE_WATCHER_DEBUG("Removed %u watch items", n);
+
+    return 0;
+}
+EXPORT_SYMBOL_GPL(state_watcher_remove_items);
+
+/**
+ * state_watcher_add_group() - Add a group of items probed by one call
+ * @watcher: Pointer to state watcher
+ * @init: Group parameters, see struct watch_group_init
+ *
+ * Creates init->count watch items that share one schedule and one probe.
+ * When the group is due, init->batch_state_func fills the states of all
+ * items at once, e.g. from a single read of a status register block, and
+ * each item then applies its own forced state, hysteresis and action
+ * function to its entry exactly as a stand-alone item would.
+ *
+ * The items are taken from init->items: name, hysteresis, action_func and
+ * private_data are used, interval_ms and state_func are ignored. They are
+ * reachable through group->items[] and work with the item query and force
+ * functions, but can only be removed together with
+ * state_watcher_remove_group().
+ *
+ * Context: Any context allowed by init->gfp (process context for 0)
+ * Return: The new group, or NULL on invalid parameters or allocation failure
+ *
+ * Example:
+ * @code
+ * static void queue_status_batch(unsigned long *states, unsigned int count,
+ *                                void *private_data)
+ * {
+ *     struct my_dev *dev = private_data;
+ *     u64 status = readq(dev->regs + QUEUE_STATUS);
+ *     unsigned int i;
+ *
+ *     for (i = 0; i < count; i++)
+ *         states[i] = (status >> i) & 1;
+ * }
+ *
+ * struct watch_item_init queues[64] = {};
+ * struct watch_group_init group_init = {
+ *     .name = "queue_status",
+ *     .interval_ms = 1000,
+ *     .batch_state_func = queue_status_batch,
+ *     .private_data = dev,
+ *     .items = queues,
+ *     .count = ARRAY_SIZE(queues),
+ * };
+ *
+ * for (i = 0; i < ARRAY_SIZE(queues); i++) {
+ *     queues[i].hysteresis = 2;
+ *     queues[i].action_func = queue_stall_action;
+ *     queues[i].private_data = &dev->queues[i];
+ * }
+ *
+ * dev->status_group = state_watcher_add_group(&watcher, &group_init);
+ * @endcode
+ */
+struct watch_group *state_watcher_add_group(struct state_watcher *watcher,
+                                            const struct watch_group_init *init)
+{
+    struct watch_item_init head_init = {};
+    struct watch_item *head = NULL;
+    struct watch_group *group;
+    unsigned long interval_ms;
+    unsigned long flags;
+    unsigned int i;
+    gfp_t gfp;
+
+    if (!watcher || !watcher->initialized || !init || !init->batch_state_func ||
+        !init->items || !init->count) {
+        return NULL;
+    }
+
+    interval_ms = state_watcher_item_interval(watcher, init->interval_ms);
+    if (!interval_ms) {
+        return NULL;
+    }
+
+    gfp = init->gfp ? init->gfp : GFP_KERNEL;
+
+    group = kzalloc(struct_size(group, items, init->count), gfp);
+    if (!group) {
+        return NULL;
+    }
+
+    group->batch_state_func = init->batch_state_func;
+    group->private_data = init->private_data;
+    group->count = init->count;
+    group->states = kcalloc(init->count, sizeof(*group->states), gfp);
+    if (!group->states) {
+        goto err_free;
+    }
+
+    for (i = 0; i < init->count; i++) {
+        if (!state_watcher_hysteresis_valid(&init->items[i])) {
+            goto err_free;
+        }
+        group->items[i] = watch_item_create(watcher, &init->items[i], interval_ms, gfp);
+        if (!group->items[i]) {
+            goto err_free;
+        }
+        group->items[i]->group = group;
+        group->items[i]->mode = WATCH_ITEM_POLL;
+    }
+
+    /* The head carries the group's schedule and owns its items */
+    head_init.name = init->name;
+    head = watch_item_create(watcher, &head_init, interval_ms, gfp);
+    if (!head) {
+        goto err_free;
+    }
+    head->group = group;
+    group->head = head;
+
+    spin_lock_irqsave(&watcher->lock, flags);
+
+    for (i = 0; i < group->count; i++) {
+        list_add_tail(&group->items[i]->list, &watcher->item_list);
+    }
+    atomic_add(group->count, &watcher->nr_items);
+    list_add_tail(&head->list, &watcher->group_list);
+    if (state_watcher_queue_item(watcher, head)) {
+        state_watcher_rearm(watcher);
+    }
+
+    spin_unlock_irqrestore(&watcher->lock, flags);
+
+    STATE_WATCHER_INFO("Added watch group '%s' (addr:%p, items:%u, interval:%lu ms)",
+                       head->name, group, group->count, interval_ms);
+
+    return group;
+
+err_free:
+    watch_group_free(group);
+    return NULL;
+}
+EXPORT_SYMBOL_GPL(state_watcher_add_group);
+
+/**
+ * state_watcher_remove_group() - Remove a watch group and all its items
+ * @watcher: Pointer to state watcher
+ * @group: Group returned by state_watcher_add_group()
+ *
+ * Like state_watcher_remove_item(), a probe of the group that is in flight
+ * keeps the group's memory until it is done but commits nothing.
+ *
+ * Context: Process or atomic context
+ * Return: 0 on success, -EINVAL if parameters are invalid
+ */
+int state_watcher_remove_group(struct state_watcher *watcher, struct watch_group *group)
+{
+    unsigned long flags;
+    unsigned int i;
+
+    if (!watcher || !watcher->initialized || !group) {
+        return -EINVAL;
+    }
+
+    spin_lock_irqsave(&watcher->lock, flags);
+
+    for (i = 0; i < group->count; i++) {
+        list_del(&group->items[i]->list);
+        group->items[i]->removed = true;
+    }
+    atomic_sub(group->count, &watcher->nr_items);
+    list_del(&group->head->list);
+    state_watcher_dequeue_item(watcher, group->head);
+    group->head->removed = true;
 
     spin_unlock_irqrestore(&watcher->lock, flags);
 
-    STATE_WATCHER_INFO("Removed watch item '%s' (addr:%p)", item->name, item);
-    kfree(item);
+    STATE_WATCHER_INFO("Removed watch group '%s' (addr:%p)", group->head->name, group);
+    watch_item_put(group->head);
 
     return 0;
 }
+EXPORT_SYMBOL_GPL(state_watcher_remove_group);
+
+/**
+ * state_watcher_notify() - Push a new state for a watch item
+ * @item: Item added with mode WATCH_ITEM_PUSH or WATCH_ITEM_PUSH_POLL
+ * @new_state: Current state of the item
+ *
+ * Lets the owner of the watched resource report a state change as it
+ * happens, e.g. from its interrupt handler, instead of waiting for the
+ * next poll. The state is evaluated on the watcher's work right away with
+ * the same forced state and hysteresis handling as a polled state, and the
+ * action function is called from there. Several pushes before the work
+ * runs collapse into one evaluation of the latest state.
+ *
+ * For WATCH_ITEM_PUSH_POLL items the poll at interval_ms keeps running as a
+ * fallback for missed notifications; a pending push replaces the probe.
+ *
+ * Context: Any context, including hard and soft IRQ
+ * Return: 0 on success, -EINVAL if @item is NULL, poll-only, part of a
+ *         group or removed, -EAGAIN if the watcher is not running (the
+ *         state is dropped)
+ *
+ * Example:
+ * @code
+ * static irqreturn_t link_irq(int irq, void *data)
+ * {
+ *     struct my_dev *dev = data;
+ *
+ *     state_watcher_notify(dev->link_item, readl(dev->regs + LINK_STATUS) & 1);
+ *     return IRQ_HANDLED;
+ * }
+ *
+ * struct watch_item_init link_init = {
+ *     .name = "link",
+ *     .mode = WATCH_ITEM_PUSH_POLL,
+ *     .interval_ms = 10000,        // slow fallback poll
+ *     .state_func = link_poll,
+ *     .action_func = link_action,
+ *     .private_data = dev,
+ * };
+ * @endcode
+ */
+int state_watcher_notify(struct watch_item *item, unsigned long new_state)
+{
+    struct state_watcher *watcher;
+    unsigned long flags;
+    int ret = 0;
+
+    if (!item || item->mode == WATCH_ITEM_POLL || item->group) {
+        return -EINVAL;
+    }
+
+    watcher = item->watcher;
+
+    spin_lock_irqsave(&watcher->lock, flags);
+
+    if (item->removed) {
+        ret = -EINVAL;
+    } else if (!READ_ONCE(watcher->running)) {
+        ret = -EAGAIN;
+    } else {
+        item->pushed_state = new_state;
+        item->push_pending = true;
+
+        if (watcher->check_wq) {
+            refcount_inc(&item->refcnt);
+            if (!queue_work(watcher->check_wq, &item->check_work)) {
+                /* Pending check picks up the latest pushed state */
+                refcount_dec(&item->refcnt);
+            }
+        } else if (list_empty(&item->push_node)) {
+            refcount_inc(&item->refcnt);
+            list_add_tail(&item->push_node, &watcher->push_list);
+            mod_delayed_work(system_wq, &watcher->work, 0);
+        }
+    }
+
+    spin_unlock_irqrestore(&watcher->lock, flags);
+
+    return ret;
+}
+EXPORT_SYMBOL_GPL(state_watcher_notify);
 
 /**
  * state_watcher_get_item_state() - Retrieve current state of a watch item
@@ -2710,6 +3972,7 @@ int state_watcher_get_item_state(struct watch_item *item, unsigned long *current
     *current_state = item->current_state;
     return 0;
 }
+EXPORT_SYMBOL_GPL(state_watcher_get_item_state);
 
 /**
  * state_watcher_get_item_stats() - Retrieve statistics for a watch item
@@ -2981,14 +4244,15 @@ int state_watcher_get_item_stats(struct watch_item *item,
     }
 
     if (check_count) {
-        *check_count = item->check_count;
+        *check_count = READ_ONCE(item->check_count);
     }
     if (action_count) {
-        *action_count = item->action_count;
+        *action_count = READ_ONCE(item->action_count);
     }
 
     return 0;
 }
+EXPORT_SYMBOL_GPL(state_watcher_get_item_stats);
 
 /**
  * state_watcher_get_stats() - Retrieve overall statistics for the state watcher
@@ -3027,8 +4291,8 @@ int state_watcher_get_item_stats(struct watch_item *item,
  * - Useful for capacity planning and system tuning
  *
  * Synchronization behavior:
- * - Briefly acquires spinlock to safely count active items
- * - total_checks and total_actions read without locking (atomic access)
+ * - Lock-free: total_checks and total_actions are summed from per-CPU
+ *   counters, active_items is a counter maintained by add and remove
  * - Snapshot consistency not guaranteed across all three values
  * - Safe for concurrent access from multiple contexts
  *
@@ -3057,7 +4321,7 @@ int state_watcher_get_item_stats(struct watch_item *item,
  * - NULL output parameters are safely ignored
  * - No validation of individual item states
  *
- * Context: Any context (briefly holds spinlock for item counting)
+ * Context: Any context (lock-free)
  * Return: 0 on success, -EINVAL if watcher is invalid or uninitialized
  *
  * Example:
@@ -3288,30 +4552,30 @@ int state_watcher_get_stats(struct state_watcher *watcher,
                             unsigned long *total_checks, unsigned long *total_actions,
                             unsigned int *active_items)
 {
-    struct watch_item *item;
-    unsigned long flags;
-    unsigned int count = 0;
+    unsigned long checks = 0, actions = 0;
+    int cpu;
 
     if (!watcher || !watcher->initialized) {
         return -EINVAL;
     }
 
-    spin_lock_irqsave(&watcher->lock, flags);
+    for_each_possible_cpu(cpu) {
+        const struct state_watcher_pcpu_stats *stats = per_cpu_ptr(watcher->stats, cpu);
+
+        checks += READ_ONCE(stats->checks);
+        actions += READ_ONCE(stats->actions);
+    }
 
     if (total_checks) {
-        *total_checks = watcher->total_checks;
+        *total_checks = checks;
     }
     if (total_actions) {
-        *total_actions = watcher->total_actions;
+        *total_actions = actions;
     }
-
     if (active_items) {
-        list_for_each_entry(item, &watcher->item_list, list) {
-            count++;
-        }
-        *active_items = count;
+        *active_items = atomic_read(&watcher->nr_items);
     }
 
-    spin_unlock_irqrestore(&watcher->lock, flags);
     return 0;
 }
+EXPORT_SYMBOL_GPL(state_watcher_get_stats);
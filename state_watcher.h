@@ -2,7 +2,11 @@
 #define _STATE_WATCHER_H
 
 #include <linux/workqueue.h>
+#include <linux/atomic.h>
 #include <linux/list.h>
+#include <linux/percpu.h>
+#include <linux/rbtree.h>
+#include <linux/refcount.h>
 #include <linux/spinlock.h>
 
 /**
@@ -142,7 +146,8 @@
  * - Called from workqueue context (process context, can sleep if necessary)
  * - May be called frequently depending on watch item interval
  * - Should minimize execution time to avoid affecting other watch items
- * - Temporary spinlock release during execution allows sleeping if needed
+ * - Called without the watcher lock held, so it may sleep and take its time
+ *   without blocking item add/remove or disabling interrupts
  *
  * Error handling:
  * - Return a consistent "error state" value if reading fails
@@ -276,9 +281,102 @@ typedef unsigned long (*state_func_t)(void *private_data);
  */
 typedef void (*action_func_t)(unsigned long old_state, unsigned long new_state, void *private_data);
 
+/**
+ * batch_state_func_t - Batch state function callback type
+ * @states: Array to fill, one entry per item of the group
+ * @count: Number of entries in @states
+ * @private_data: Group private data from struct watch_group_init
+ *
+ * Probes the states of all items of a watch group in one call, so items
+ * backed by the same hardware source cost one register or bus read
+ * instead of one per item. @states[i] is handled like the return value of
+ * a state_func_t for the group's i-th item. Same context rules as
+ * state_func_t.
+ */
+typedef void (*batch_state_func_t)(unsigned long *states, unsigned int count, void *private_data);
+
+struct watch_group;
+
+/**
+ * STATE_WATCHER_ACTION_QUEUE_LEN - Queued transitions per item
+ *
+ * Depth of each item's action queue with STATE_WATCHER_F_ASYNC_ACTIONS.
+ * When it is full, a new transition is merged into the newest queued one
+ * rather than dropped, so the item's final state is always delivered.
+ */
+#define STATE_WATCHER_ACTION_QUEUE_LEN 4
+
+/**
+ * struct watch_transition - State transition waiting for its action call
+ * @old_state: State before the transition
+ * @new_state: State after the transition
+ */
+struct watch_transition {
+    unsigned long old_state;
+    unsigned long new_state;
+};
+
+/**
+ * enum watch_item_mode - How a watch item learns about its state
+ * @WATCH_ITEM_POLL: state_func is called every interval_ms (default)
+ * @WATCH_ITEM_PUSH: Only states reported with state_watcher_notify() are
+ *                   evaluated; state_func may be NULL and interval_ms is unused
+ * @WATCH_ITEM_PUSH_POLL: Pushed states are evaluated immediately, and
+ *                        state_func is still polled every interval_ms as a
+ *                        slow fallback
+ */
+enum watch_item_mode {
+    WATCH_ITEM_POLL,
+    WATCH_ITEM_PUSH,
+    WATCH_ITEM_PUSH_POLL,
+};
+
+/**
+ * enum watch_hysteresis_mode - How a watch item filters its samples
+ * @WATCH_HYST_COUNT: A new state must be seen hysteresis consecutive times
+ *                    (default)
+ * @WATCH_HYST_BAND: Dual-threshold band, the state is 1 once a sample
+ *                   reaches band_enter and 0 once it falls to band_exit
+ * @WATCH_HYST_EWMA: Like @WATCH_HYST_BAND, applied to an exponentially
+ *                   weighted moving average of the samples
+ * @WATCH_HYST_TIME: A new state must persist for debounce_ms
+ *
+ * With @WATCH_HYST_BAND and @WATCH_HYST_EWMA the action function receives
+ * the band states 0 and 1, while current_state keeps the raw sample. A
+ * single threshold is the band with band_enter == band_exit.
+ */
+enum watch_hysteresis_mode {
+    WATCH_HYST_COUNT,
+    WATCH_HYST_BAND,
+    WATCH_HYST_EWMA,
+    WATCH_HYST_TIME,
+};
+
+/* EWMA weight of the newest sample is 1/2^ewma_shift */
+#define STATE_WATCHER_EWMA_DEFAULT_SHIFT 3
+#define STATE_WATCHER_EWMA_MAX_SHIFT 16
+/* Fraction bits of the fixed point moving average */
+#define STATE_WATCHER_EWMA_FRAC_BITS 8
+
 /**
  * struct watch_item - Individual watch item for state monitoring
  * @list: List node for linking items in the state watcher's item list
+ * @due_node: Node in the watcher's due-time tree
+ * @next_due: Time of the next state check (in jiffies), key of @due_node
+ * @due_list: Link in the work function's batch of due items
+ * @refcnt: References held by the item list and by an ongoing check
+ * @removed: Set by state_watcher_remove_item(), an ongoing check commits nothing
+ * @watcher: Owning watcher, used by @check_work
+ * @check_work: Evaluation of this item on the watcher's check workqueue
+ * @group: Watch group of the item (or the group it heads), NULL if stand-alone
+ * @mode: enum watch_item_mode of the item
+ * @push_node: Link in the watcher's list of pushed items
+ * @pushed_state: Latest state from state_watcher_notify()
+ * @push_pending: @pushed_state has not been evaluated yet
+ * @action_work: Delivery of queued transitions on the watcher's action workqueue
+ * @actions: Ring of transitions waiting for action_func
+ * @actions_head: Index of the oldest entry in @actions
+ * @actions_pending: Number of entries in @actions
  * @interval_ms: Watching interval in milliseconds (must be multiple of base_interval_ms)
  * @hysteresis: Hysteresis value - consecutive count threshold for state change recognition
  * @state_func: Pointer to state function that reads current state
@@ -289,6 +387,14 @@ typedef void (*action_func_t)(unsigned long old_state, unsigned long new_state,
  * @last_check_time: Timestamp of last state check (in jiffies)
  * @candidate_state: Potential new state being evaluated for hysteresis
  * @consecutive_count: Number of consecutive occurrences of candidate_state
+ * @hysteresis_mode: enum watch_hysteresis_mode of the item
+ * @band_enter: Band threshold to enter state 1 (WATCH_HYST_BAND/EWMA)
+ * @band_exit: Band threshold to return to state 0 (WATCH_HYST_BAND/EWMA)
+ * @ewma_shift: Weight of the newest sample in @ewma_avg, as 1/2^ewma_shift
+ * @ewma_valid: @ewma_avg has been seeded with a first sample
+ * @ewma_avg: Moving average with STATE_WATCHER_EWMA_FRAC_BITS fraction bits
+ * @debounce_jiffies: Time a new state must persist (WATCH_HYST_TIME)
+ * @candidate_since: Time candidate_state was first seen (WATCH_HYST_TIME)
  * @forced_state: Forced state value when is_forced is true
  * @forced_state_expire_time: Expiration time for forced state (in jiffies)
  * @is_forced: Flag indicating if state is currently forced
@@ -301,6 +407,14 @@ typedef void (*action_func_t)(unsigned long old_state, unsigned long new_state,
  * Items are managed in a linked list and processed periodically according to
  * their individual intervals.
  *
+ * Memory layout:
+ * - Items come cacheline aligned from a slab cache
+ * - The first cache line holds what the due-time tree walk and requeue
+ *   touch, the following ones what a check reads and writes
+ * - Fields only used on a state transition, for add/remove, or for
+ *   identification start on their own cache line and stay cold while the
+ *   item's state is stable
+ *
  * Lifecycle:
  * 1. Created and initialized via state_watcher_add_item()
  * 2. Added to watcher's item list and monitored periodically
@@ -357,47 +471,152 @@ typedef void (*action_func_t)(unsigned long old_state, unsigned long new_state,
  * @endcode
  */
 struct watch_item {
-    struct list_head list;
-
-    /* User configuration parameters */
+    /* Hot: scheduling, read for every tree walk and requeue */
+    struct rb_node due_node;
+    unsigned long next_due;
     unsigned long interval_ms;
-    unsigned long hysteresis;
+    struct list_head due_list;
+    refcount_t refcnt;
+    bool removed;
+    bool push_pending;
+    bool is_forced;
+
+    /* Hot: probe and hysteresis, read and written on every check */
     state_func_t state_func;
-    action_func_t action_func;
     void *private_data;
-
-    /* Internal state management */
+    struct state_watcher *watcher;
+    struct watch_group *group;
     unsigned long current_state;
     unsigned long last_action_state;
     unsigned long last_check_time;
-
-    /* Hysteresis management */
     unsigned long candidate_state;
     unsigned long consecutive_count;
-
-    /* Forced state management */
+    unsigned long hysteresis;
+    unsigned long band_enter;
+    unsigned long band_exit;
+    unsigned long ewma_avg;
+    unsigned long debounce_jiffies;
+    unsigned long candidate_since;
+    unsigned int hysteresis_mode;
+    unsigned int ewma_shift;
+    bool ewma_valid;
+    unsigned long pushed_state;
     unsigned long forced_state;
     unsigned long forced_state_expire_time;
-    bool is_forced;
+    unsigned long check_count;
 
-    /* Identifier */
+    /* Cold: state transitions, configuration, identification */
+    action_func_t action_func ____cacheline_aligned;
+    unsigned long action_count;
+    unsigned int mode;
+    unsigned int actions_head;
+    unsigned int actions_pending;
+    struct watch_transition actions[STATE_WATCHER_ACTION_QUEUE_LEN];
+    struct work_struct action_work;
+    struct work_struct check_work;
+    struct list_head list;
+    struct list_head push_node;
     char name[32];
+};
 
-    /* Statistics */
-    unsigned long check_count;
-    unsigned long action_count;
+/**
+ * STATE_WATCHER_F_COALESCE - Batch watcher ticks with other timers
+ *
+ * Flag for struct state_watcher_config, for battery powered or power-capped
+ * systems. The watcher's work becomes deferrable, so it does not wake an
+ * idle CPU on its own, and each tick is moved up to the next multiple of
+ * base_interval_ms in absolute jiffies. Tickers of other watchers, the
+ * watchdog and the traffic monitor aligned the same way then expire
+ * together instead of at unrelated times, as long as their intervals are
+ * multiples of each other.
+ *
+ * Item checks may run up to one base interval late, or later while the
+ * CPU stays idle.
+ */
+#define STATE_WATCHER_F_COALESCE 0x1
+
+/**
+ * STATE_WATCHER_F_ASYNC_ACTIONS - Run action functions on a separate workqueue
+ *
+ * Flag for struct state_watcher_config. Detected transitions are recorded
+ * in the item's action queue and delivered by a work on a dedicated
+ * unbound workqueue, so a slow action_func never delays the state checks
+ * of other items. Actions of one item are delivered in order, one at a
+ * time; actions of different items may run concurrently. last_action_state
+ * is updated when the transition is detected, before its action runs.
+ */
+#define STATE_WATCHER_F_ASYNC_ACTIONS 0x2
+
+/**
+ * STATE_WATCHER_F_MERGE_ACTIONS - Deliver only the latest pending transition
+ *
+ * Implies STATE_WATCHER_F_ASYNC_ACTIONS. Transitions that are still queued
+ * when the next one is detected are merged: A->B followed by B->C before
+ * the first action ran is delivered as a single A->C, and A->B->A is not
+ * delivered at all. For actions that only care about the current state.
+ */
+#define STATE_WATCHER_F_MERGE_ACTIONS 0x4
+
+/**
+ * struct state_watcher_config - State watcher configuration
+ * @base_interval_ms: Base watching interval in milliseconds (0 = use default)
+ * @flags: Bitmask of STATE_WATCHER_F_* flags
+ * @max_workers: Maximum number of items evaluated concurrently (0 or 1 =
+ *               evaluate all items sequentially on the watcher's own work)
+ *
+ * Extended configuration for state_watcher_init_config(). Zero-initialized
+ * fields select the same defaults as state_watcher_init().
+ *
+ * With @max_workers above 1 the watcher gets an unbound workqueue limited to
+ * that many concurrent work items, and each due item is evaluated by its own
+ * work on it. Evaluations of one item never overlap and run in due order, so
+ * hysteresis and last_action_state transitions are the same as sequential
+ * evaluation; only different items run in parallel. State and action
+ * functions must then be safe against callbacks of other items running at
+ * the same time.
+ *
+ * Example:
+ * @code
+ * static const struct state_watcher_config idle_cfg = {
+ *     .base_interval_ms = 1000,
+ *     .flags = STATE_WATCHER_F_COALESCE,
+ * };
+ *
+ * ret = state_watcher_init_config(&watcher, &idle_cfg);
+ * @endcode
+ */
+struct state_watcher_config {
+    unsigned long base_interval_ms;
+    unsigned int flags;
+    unsigned int max_workers;
+};
+
+/**
+ * struct state_watcher_pcpu_stats - Per-CPU state watcher counters
+ * @checks: State evaluations committed on this CPU
+ * @actions: Action function calls completed on this CPU
+ */
+struct state_watcher_pcpu_stats {
+    unsigned long checks;
+    unsigned long actions;
 };
 
 /**
  * struct state_watcher - Main state watcher framework structure
  * @item_list: Head of linked list containing all watch_item structures
+ * @group_list: Head items of all watch groups
+ * @push_list: Items with a pushed state waiting for the work
+ * @due_tree: Watch items ordered by next_due, earliest cached
  * @work: Delayed work structure for periodic execution via workqueue
  * @lock: Spinlock protecting concurrent access to watcher state and item list
  * @base_interval_ms: Base check interval in milliseconds for work scheduling
+ * @flags: STATE_WATCHER_F_* flags from struct state_watcher_config
+ * @check_wq: Workqueue for parallel item evaluation, NULL if sequential
+ * @action_wq: Workqueue for asynchronous actions, NULL if actions run inline
  * @running: Flag indicating if periodic watching is currently active
  * @initialized: Flag indicating if watcher has been properly initialized
- * @total_checks: Cumulative count of all state function calls across all items
- * @total_actions: Cumulative count of all action function calls across all items
+ * @stats: Per-CPU check and action counters, summed by state_watcher_get_stats()
+ * @nr_items: Number of watch items, including items of groups
  *
  * This structure serves as the central coordinator for the state monitoring
  * framework. It manages a collection of watch items and orchestrates their
@@ -406,18 +625,23 @@ struct watch_item {
  * Architecture:
  * - Single watcher can manage multiple watch items with different intervals
  * - All item intervals must be multiples of base_interval_ms
- * - Work function runs every base_interval_ms and checks items individually
+ * - Items are kept in a due-time tree; the work function only visits the
+ *   items that are due and is then armed for the earliest next due time
  * - Thread-safe operation through spinlock protection
  *
  * Work scheduling:
- * - Uses delayed_work for periodic execution in process context
- * - base_interval_ms determines work queue scheduling frequency
+ * - Uses delayed_work for execution in process context
+ * - The work runs when the earliest item is due, not every base interval,
+ *   and is not queued at all while the watcher has no items
+ * - With STATE_WATCHER_F_COALESCE the work is deferrable and its ticks are
+ *   aligned to multiples of base_interval_ms
  * - Individual items checked according to their own interval requirements
  * - Automatic rescheduling continues while running flag is true
  *
  * Synchronization model:
  * - Spinlock protects item list modifications and watcher state
- * - Lock temporarily released during state/action function calls
+ * - Lock never held during state/action function calls; due items are
+ *   snapshotted with a reference and their results committed under the lock
  * - Allows blocking operations in user callbacks
  * - Prevents race conditions during start/stop operations
  *
@@ -427,8 +651,9 @@ struct watch_item {
  * - Uses cmpxchg for atomic start/stop operations
  *
  * Statistics tracking:
- * - total_checks: Incremented for every state function call
- * - total_actions: Incremented for every action function call
+ * - Checks and actions are counted per CPU, so parallel evaluation does not
+ *   bounce a shared cache line; readers sum the CPUs without locking
+ * - nr_items is maintained on add/remove instead of walking the list
  * - Provides overall framework usage metrics
  * - Individual item statistics maintained separately
  *
@@ -494,19 +719,25 @@ struct watch_item {
  */
 struct state_watcher {
     struct list_head item_list;
+    struct list_head group_list;
+    struct list_head push_list;
+    struct rb_root_cached due_tree;
     struct delayed_work work;
     spinlock_t lock;
     
     /* Watcher configuration */
     unsigned long base_interval_ms;
+    unsigned int flags;
+    struct workqueue_struct *check_wq;
+    struct workqueue_struct *action_wq;
     
     /* State flags */
     bool running;
     bool initialized;
     
     /* Statistics */
-    unsigned long total_checks;
-    unsigned long total_actions;
+    struct state_watcher_pcpu_stats __percpu *stats;
+    atomic_t nr_items;
 };
 
 /**
@@ -517,6 +748,15 @@ struct state_watcher {
  * @state_func: Pointer to state function that reads current state (required)
  * @action_func: Pointer to action function called on state changes (optional, can be NULL)
  * @private_data: User-provided private data passed to state and action functions
+ * @gfp: Allocation flags for the item, 0 for GFP_KERNEL
+ * @mode: enum watch_item_mode, 0 for WATCH_ITEM_POLL
+ * @hysteresis_mode: enum watch_hysteresis_mode, 0 for WATCH_HYST_COUNT
+ * @band_enter: Threshold entering band state 1, for WATCH_HYST_BAND/EWMA.
+ *              For WATCH_HYST_EWMA at most ULONG_MAX >> 24, i.e. 255 on
+ *              32-bit (the fixed point average needs the other bits)
+ * @band_exit: Threshold returning to band state 0, at most @band_enter
+ * @ewma_shift: EWMA weight 1/2^ewma_shift, 1..16, 0 for the default of 3
+ * @debounce_ms: Time a new state must persist, for WATCH_HYST_TIME
  *
  * This structure is used to pass initialization parameters when creating a new
  * watch item via state_watcher_add_item(). It provides a clean interface for
@@ -526,10 +766,14 @@ struct state_watcher {
  * - name: If NULL, a default name based on item pointer is generated
  * - interval_ms: If 0, uses watcher's base_interval_ms as default
  * - interval_ms: Must be >= base_interval_ms and multiple of base_interval_ms
- * - hysteresis: Can be 0 (immediate) or positive value for filtering
- * - state_func: Must not be NULL (required for monitoring)
+ * - hysteresis: Can be 0 (immediate) or positive value for filtering,
+ *   only used with WATCH_HYST_COUNT
+ * - band_enter/band_exit: band_exit must not exceed band_enter
+ * - state_func: Must not be NULL, except for WATCH_ITEM_PUSH items
  * - action_func: Can be NULL if only state tracking is needed
  * - private_data: Can be NULL if functions don't need additional context
+ * - gfp: 0 allocates with GFP_KERNEL; GFP_ATOMIC allows adding items from
+ *   atomic context (items come from a dedicated slab cache)
  *
  * Initialization patterns:
  * - Structure initialization: Use designated initializers for clarity
@@ -576,6 +820,18 @@ struct state_watcher {
  *     .action_func = NULL             // Only track, don't react
  * };
  * 
+ * // Overtemperature with a band: on at 85, off again only below 75,
+ * // evaluated on the average of the readings
+ * struct watch_item_init thermal_init = {
+ *     .name = "thermal_band",
+ *     .state_func = temperature_func,
+ *     .action_func = throttle_action_func,   // new_state is 0 or 1
+ *     .hysteresis_mode = WATCH_HYST_EWMA,
+ *     .band_enter = 85,
+ *     .band_exit = 75,
+ *     .ewma_shift = 2
+ * };
+ * 
  * // Batch initialization
  * static struct watch_item_init sensor_inits[] = {
  *     { .name = "temp_cpu", .state_func = cpu_temp_func, .hysteresis = 2 },
@@ -595,6 +851,55 @@ struct watch_item_init {
     state_func_t state_func;
     action_func_t action_func;
     void *private_data;
+    gfp_t gfp;
+    unsigned int mode;
+    unsigned int hysteresis_mode;
+    unsigned long band_enter;
+    unsigned long band_exit;
+    unsigned int ewma_shift;
+    unsigned long debounce_ms;
+};
+
+/**
+ * struct watch_group - Items sharing one batch probe
+ * @head: Internal item carrying the group's schedule, owns the group
+ * @batch_state_func: Probe filling @states for all items
+ * @private_data: Argument of @batch_state_func
+ * @count: Number of items
+ * @states: Probe results, one per item
+ * @items: The group's watch items
+ *
+ * Created by state_watcher_add_group(). The items behave like stand-alone
+ * items for hysteresis, forced states, actions and statistics, but are
+ * probed together and removed together.
+ */
+struct watch_group {
+    struct watch_item *head;
+    batch_state_func_t batch_state_func;
+    void *private_data;
+    unsigned int count;
+    unsigned long *states;
+    struct watch_item *items[];
+};
+
+/**
+ * struct watch_group_init - Watch group initialization parameters
+ * @name: Name of the group (NULL for a generated one)
+ * @interval_ms: Watching interval of the group, same rules as for items
+ * @batch_state_func: Probe for all items of the group (required)
+ * @private_data: Argument of @batch_state_func
+ * @items: Per-item parameters; interval_ms and state_func are ignored
+ * @count: Number of entries in @items (at least 1)
+ * @gfp: Allocation flags, 0 for GFP_KERNEL
+ */
+struct watch_group_init {
+    const char *name;
+    unsigned long interval_ms;
+    batch_state_func_t batch_state_func;
+    void *private_data;
+    const struct watch_item_init *items;
+    unsigned int count;
+    gfp_t gfp;
 };
 
 /**
@@ -602,6 +907,12 @@ struct watch_item_init {
  */
 int state_watcher_init(struct state_watcher *watcher, unsigned long base_interval_ms);
 
+/**
+ * state_watcher_init_config() - Initialize state watcher framework with a configuration
+ */
+int state_watcher_init_config(struct state_watcher *watcher,
+                              const struct state_watcher_config *config);
+
 /**
  * state_watcher_cleanup() - Clean up state watcher and free all resources
  */
@@ -628,6 +939,34 @@ struct watch_item *state_watcher_add_item(struct state_watcher *watcher,
  */
 int state_watcher_remove_item(struct state_watcher *watcher, struct watch_item *item);
 
+/**
+ * state_watcher_add_items() - Add several watch items under one lock acquisition
+ */
+int state_watcher_add_items(struct state_watcher *watcher, const struct watch_item_init *init,
+                            unsigned int n, struct watch_item **out);
+
+/**
+ * state_watcher_remove_items() - Remove several watch items under one lock acquisition
+ */
+int state_watcher_remove_items(struct state_watcher *watcher, struct watch_item **items,
+                               unsigned int n);
+
+/**
+ * state_watcher_add_group() - Add a group of items probed by one call
+ */
+struct watch_group *state_watcher_add_group(struct state_watcher *watcher,
+                                            const struct watch_group_init *init);
+
+/**
+ * state_watcher_remove_group() - Remove a watch group and all its items
+ */
+int state_watcher_remove_group(struct state_watcher *watcher, struct watch_group *group);
+
+/**
+ * state_watcher_notify() - Push a new state for a watch item
+ */
+int state_watcher_notify(struct watch_item *item, unsigned long new_state);
+
 /**
  * state_watcher_get_item_state() - Get current state of a watch item
  */
@@ -1,18 +1,38 @@
 #include "traffic_monitor.h"
+#include "state_watcher.h"
 #include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/netdevice.h>
-#include <linux/hashtable.h>
+#include <linux/glob.h>
+#include <linux/hash.h>
+#include <linux/mutex.h>
+#include <linux/rculist.h>
+#include <linux/rcupdate.h>
+#include <linux/seq_file.h>
+#include <linux/seqlock.h>
+#include <linux/moduleparam.h>
 #include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/vmalloc.h>
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
+#include <linux/rtnetlink.h>
 #include <linux/workqueue.h>
+#include <net/netdev_queues.h>
 
 /**
- * target_devices - Array of network interface names to monitor
+ * target_devices - Default network interface names to monitor
  *
  * This array contains a list of common network interface names that the
- * traffic monitoring system will attempt to track.
+ * traffic monitoring system will attempt to track unless the "devices"
+ * module parameter selects others.
  *
  * The array is NULL-terminated to allow for easy iteration. This is a
  * read-only configuration that defines which network devices should be
@@ -30,49 +50,117 @@ static const char* target_devices[] = {
 };
 
 /**
- * NETDEV_HASH_BITS - Number of bits for network device hash table size
+ * NETDEV_HASH_BITS_MIN, NETDEV_HASH_BITS_MAX - Range of the hash_bits parameter
  *
- * Defines the number of bits used to determine the hash table size for
- * network device monitoring. The actual hash table size will be 2^4 = 16
- * entries. This provides a reasonable balance between memory usage and
- * hash collision probability for typical network device monitoring scenarios.
+ * The lookup tables have 2^hash_bits buckets each. Sixteen buckets are
+ * enough for a handful of physical ports, 2^16 covers hosts with thousands
+ * of VF, VLAN or veth interfaces.
  */
-#define NETDEV_HASH_BITS 4
+#define NETDEV_HASH_BITS_MIN 4
+#define NETDEV_HASH_BITS_MAX 16
+
+/**
+ * hash_bits - Size of the device lookup tables as a power of two
+ *
+ * Read once in init_traffic_monitor() and clamped to
+ * [NETDEV_HASH_BITS_MIN, NETDEV_HASH_BITS_MAX]. The default of 256 buckets
+ * keeps chains short with several hundred monitored devices.
+ */
+static unsigned int hash_bits = 8;
+module_param(hash_bits, uint, 0444);
+MODULE_PARM_DESC(hash_bits, "log2 of the device lookup table size, 4..16 (default: 8)");
 
 /**
  * MONITOR_INTERVAL_MS - Traffic monitoring sampling interval in milliseconds
  *
  * Defines the time interval between consecutive traffic statistics sampling
  * operations. A 100ms interval provides sufficiently granular monitoring
- * while avoiding excessive system overhead. This interval determines the
- * frequency at which network interface statistics are read and processed.
+ * while avoiding excessive system overhead. This is the interval of busy
+ * devices and the tick of the shared sampler; idle devices back off up to
+ * max_interval_ms, see adapt_sample_interval().
  */
 #define MONITOR_INTERVAL_MS 100
 
 /**
- * netdev_monitor_hash - Hash table for actively monitored network devices
+ * MONITOR_RATE_CHANGE_SHIFT - Rate change that restores the fastest interval
+ *
+ * A device returns to MONITOR_INTERVAL_MS when its byte rate in either
+ * direction moved by more than 1/2^MONITOR_RATE_CHANGE_SHIFT (25%) since
+ * the previous sample.
+ */
+#define MONITOR_RATE_CHANGE_SHIFT 2
+
+/**
+ * max_interval_ms - Longest sampling interval of an idle device
  *
- * This hash table stores network device monitoring entries, providing fast
- * lookup and access to device-specific traffic statistics. The table size
- * is determined by NETDEV_HASH_BITS and uses the kernel's standard hash
- * table implementation for efficient device management.
+ * A device whose counters did not move between two samples doubles its
+ * interval, up to this value (rounded down to a multiple of
+ * MONITOR_INTERVAL_MS). Setting it to MONITOR_INTERVAL_MS disables the
+ * back-off. Read once in init_traffic_monitor().
  */
-DECLARE_HASHTABLE(netdev_monitor_hash, NETDEV_HASH_BITS);
+static unsigned int max_interval_ms = 3200;
+module_param(max_interval_ms, uint, 0444);
+MODULE_PARM_DESC(max_interval_ms, "Sampling interval of idle devices in ms, at least 100 (default: 3200)");
 
 /**
- * netdev_monitor_rwlock - Reader-writer lock for monitor hash table protection
+ * ring_records - Record slots of the shared sample ring
  *
- * This rwlock synchronizes access to the netdev_monitor_hash table:
- * - Read lock: Acquired when querying statistics or performing read-only
- *   operations on existing monitor entries (e.g., delta calculations)
- * - Write lock: Acquired when modifying the hash table structure, such as
- *   adding/removing devices or updating statistics that require exclusive access
+ * Rounded up to a power of two, at least TRAFFIC_RING_MIN_RECORDS. 0
+ * disables /dev/traffic_monitor. Read once in init_traffic_monitor().
+ */
+static unsigned int ring_records = 4096;
+module_param(ring_records, uint, 0444);
+MODULE_PARM_DESC(ring_records, "Records in the shared sample ring, 0 to disable (default: 4096)");
+
+#define TRAFFIC_RING_MIN_RECORDS 32
+#define TRAFFIC_RING_MAX_RECORDS (1U << 20)
+
+/* Sampling intervals in jiffies, set up in init_traffic_monitor() */
+static unsigned long monitor_min_interval;
+static unsigned long monitor_max_interval;
+
+/**
+ * coalesce_wakeups - Batch sampling wakeups with other timers
+ *
+ * When set, the sampling work is deferrable, so it does not wake an idle
+ * CPU on its own, and each sample is moved up to the next multiple of
+ * MONITOR_INTERVAL_MS in absolute jiffies. The watchdog and state watcher
+ * coalesce modes align the same way, so their ticks expire together
+ * instead of at unrelated times. Rates stay exact because they are
+ * computed from the measured time between samples. Read once in
+ * init_traffic_monitor().
+ */
+static bool coalesce_wakeups;
+module_param(coalesce_wakeups, bool, 0444);
+MODULE_PARM_DESC(coalesce_wakeups, "Use deferrable, interval-aligned sampling (default: false)");
+
+/**
+ * netdev_name_table, netdev_ifindex_table - Lookup tables of monitored devices
  *
- * The rwlock allows multiple concurrent readers while ensuring exclusive
- * access for writers, optimizing performance for the common case of
- * statistics queries.
+ * Each monitored device is hashed twice, by name for netdevice_stats_delta()
+ * and by ifindex for netdevice_stats_delta_ifindex(). Both tables have
+ * 1 << netdev_hash_bits buckets and are allocated in init_traffic_monitor().
  */
-static DEFINE_RWLOCK(netdev_monitor_rwlock);
+static struct hlist_head *netdev_name_table;
+static struct hlist_head *netdev_ifindex_table;
+static unsigned int netdev_hash_bits;
+
+/**
+ * netdev_monitor_list - All monitored devices, walked by the sampler
+ */
+static LIST_HEAD(netdev_monitor_list);
+
+/**
+ * netdev_monitor_lock - Serializes changes to the monitor tables
+ *
+ * Only taken to add or remove entries. The tables and netdev_monitor_list
+ * are walked under RCU, by the sampler as well as by the queries, and
+ * removed entries
+ * are released after a grace period. The statistics of an entry are
+ * protected by its own seqcount instead, so readers never take a lock and
+ * never write to a shared cache line.
+ */
+static DEFINE_SPINLOCK(netdev_monitor_lock);
 
 
 /**
@@ -107,24 +195,180 @@ static atomic_t active_monitors = ATOMIC_INIT(0);
 static atomic_t monitor_stop_flag = ATOMIC_INIT(0);
 
 /**
- * struct simple_net_device_stats - Simplified network device statistics
+ * netdev_monitor_total_seq - Protects netdev_monitor_total_rates
+ *
+ * Written by the sampler once per sample, read by netdevice_stats_delta()
+ * for the aggregate of all devices.
+ */
+static seqcount_t netdev_monitor_total_seq = SEQCNT_ZERO(netdev_monitor_total_seq);
+
+/**
+ * struct netdev_counters - Raw 64-bit counters of one device sample
  * @tx_packets: Number of transmitted packets
  * @tx_bytes: Number of transmitted bytes
  * @rx_packets: Number of received packets
  * @rx_bytes: Number of received bytes
  *
  * This structure contains essential traffic statistics for a network device,
- * providing a simplified subset of the full kernel network device statistics.
- * It tracks only the core transmit and receive counters needed for basic
- * traffic monitoring and rate calculations.
+ * providing a simplified subset of the full kernel network device statistics
+ * (struct rtnl_link_stats64). It tracks only the core transmit and receive
+ * counters needed for basic traffic monitoring and rate calculations. The
+ * per-second rates derived from them are returned as the public
+ * struct simple_net_device_stats.
  */
-struct simple_net_device_stats {
+struct netdev_counters {
     u64 tx_packets;
     u64 tx_bytes;
     u64 rx_packets;
     u64 rx_bytes;
 };
 
+/**
+ * struct netdev_history_slot - One sample in a device's history ring
+ * @jiffies: Time of the sample
+ * @counters: Device counters at @jiffies
+ * @rates: Per-second rates since the previous sample, zero for the first
+ */
+struct netdev_history_slot {
+    unsigned long jiffies;
+    struct netdev_counters counters;
+    struct simple_net_device_stats rates;
+};
+
+/**
+ * struct netdev_queue_counters - Raw 64-bit counters of one queue sample
+ * @packets: Packets through the queue
+ * @bytes: Bytes through the queue
+ */
+struct netdev_queue_counters {
+    u64 packets;
+    u64 bytes;
+};
+
+/**
+ * struct netdev_queue_slot - Sampling state of one queue
+ * @prev: Counters of the previous queue sample, sampler only
+ * @cur: Counters of the current queue sample, sampler only
+ * @rates: Per-second rates between @prev and @cur, published to readers
+ */
+struct netdev_queue_slot {
+    struct netdev_queue_counters prev;
+    struct netdev_queue_counters cur;
+    struct traffic_queue_rates rates;
+};
+
+/**
+ * struct netdev_queue_block - Per-queue statistics of one device
+ * @seq: Write side held by the sampler while it replaces the rates
+ * @rcu: Deferred release after the queue count changed
+ * @jiffies: Time of the last queue sample
+ * @num_rx: Number of receive queues, in q[0, num_rx)
+ * @num_tx: Number of transmit queues, in q[num_rx, num_rx + num_tx)
+ * @rates_valid: The block has seen two samples
+ * @q: Queue slots
+ *
+ * Sized for the real queue counts of the device. When they change, the
+ * sampler publishes a new block and the old one is freed after a grace
+ * period, so readers never see a slot array of the wrong length.
+ */
+struct netdev_queue_block {
+    seqcount_t seq;
+    struct rcu_head rcu;
+    unsigned long jiffies;
+    unsigned int num_rx;
+    unsigned int num_tx;
+    bool rates_valid;
+    struct netdev_queue_slot q[];
+};
+
+/**
+ * TRAFFIC_EWMA_SHIFT - Weight of the newest sample in the per-device EWMA
+ *
+ * Each sample contributes 1/2^TRAFFIC_EWMA_SHIFT (1/8) of its rate.
+ */
+#define TRAFFIC_EWMA_SHIFT 3
+
+/**
+ * TRAFFIC_STATS_HIST_BUCKETS - Buckets of the sampler histograms
+ *
+ * Bucket i counts values in [2^i, 2^(i+1)), bucket 0 also counts zero and
+ * the last bucket everything above, like the watchdog statistics.
+ */
+#define TRAFFIC_STATS_HIST_BUCKETS 24
+
+/**
+ * struct traffic_sampler_stats - Cost and timeliness of the sampler
+ * @passes: Sampling passes run
+ * @devices_sampled: Device samples taken
+ * @max_devices_per_pass: Largest number of devices sampled by one pass
+ * @pass_ns: Histogram of the duration of a pass, queues included
+ * @lateness_us: Histogram of how late a pass started against its schedule
+ *
+ * Written by the sampler only and read without locking for the "stats"
+ * debugfs file, to compare sampler changes against a baseline.
+ */
+struct traffic_sampler_stats {
+    u64 passes;
+    u64 devices_sampled;
+    u64 max_devices_per_pass;
+    u64 pass_ns[TRAFFIC_STATS_HIST_BUCKETS];
+    u64 lateness_us[TRAFFIC_STATS_HIST_BUCKETS];
+};
+
+static struct traffic_sampler_stats sampler_stats;
+
+/* Time the next pass is scheduled for (in jiffies) */
+static unsigned long monitor_planned;
+
+/* <debugfs>/traffic_monitor, best effort */
+static struct dentry *traffic_debugfs_dir;
+
+/**
+ * netdev_monitor_total_rates - Sum of the per-second rates of all devices
+ *
+ * Summed by the sampler after each walk over the hash table. A device that
+ * is unregistered drops out of the sum with the next sample.
+ */
+static struct simple_net_device_stats netdev_monitor_total_rates;
+
+/**
+ * struct traffic_subscription - Threshold band evaluated by the sampler
+ * @list: Link in traffic_subscriptions
+ * @metric: enum traffic_metric to watch
+ * @enter: Rate at or above which the band is entered
+ * @exit: Rate below which the band is left
+ * @func: Transition callback, may be NULL
+ * @item: Watch item notified on transitions, may be NULL
+ * @private_data: Passed to @func
+ * @last_sample: Sample time of the device at the last evaluation, sampler only
+ * @above: Current state, sampler only
+ * @item_above: State last accepted by @item, sampler only
+ * @ifname: Watched device, empty for the aggregate
+ */
+struct traffic_subscription {
+    struct list_head list;
+    enum traffic_metric metric;
+    u64 enter;
+    u64 exit;
+    traffic_threshold_func_t func;
+    struct watch_item *item;
+    void *private_data;
+    unsigned long last_sample;
+    bool above;
+    bool item_above;
+    char ifname[IFNAMSIZ];
+};
+
+/**
+ * traffic_subscriptions - Threshold subscriptions, walked by the sampler under RCU
+ */
+static LIST_HEAD(traffic_subscriptions);
+
+/**
+ * traffic_subscriptions_mutex - Serializes changes of traffic_subscriptions
+ */
+static DEFINE_MUTEX(traffic_subscriptions_mutex);
+
 /**
  * struct netdev_monitor_entry - Network device monitoring entry
  * @dev: Pointer to the monitored network device
@@ -132,7 +376,21 @@ struct simple_net_device_stats {
  * @prev_stats: Previous simplified network device statistics
  * @current_stats_jiffies: Timestamp (jiffies) when current stats were updated
  * @prev_stats_jiffies: Timestamp (jiffies) when previous stats were updated
- * @hash_node: Hash table node for linking entries
+ * @rates: Per-second rates between the last two samples, published to readers
+ * @interval: Current sampling interval of this device (in jiffies)
+ * @next_sample: Time the device is due for its next sample (in jiffies)
+ * @ewma: Exponentially weighted moving average of @rates, per sample
+ * @history_head: Index of the next slot of @history to write
+ * @history_count: Number of valid slots in @history
+ * @history: Ring of the last TRAFFIC_HISTORY_LEN samples, on its own cache lines
+ * @queues: Per-queue statistics, NULL until the first queue sample
+ * @queue_jiffies: Value of @current_stats_jiffies at the last queue sample
+ * @stats_seq: Write side held by the sampler while it replaces @rates
+ * @hash_node: Node in netdev_name_table
+ * @ifindex_node: Node in netdev_ifindex_table
+ * @list: Link in netdev_monitor_list
+ * @rcu: Deferred release after the entry left the tables
+ * @ifindex: Interface index of @dev
  * @ifname: Network interface name (null-terminated string)
  *
  * This structure holds monitoring information for a single network device,
@@ -140,176 +398,344 @@ struct simple_net_device_stats {
  * rate calculations. The structure is designed to be stored in a hash table
  * for efficient device lookup and includes timing information for accurate
  * delta calculations between measurement intervals.
+ *
+ * The snapshots are private to the sampler, which turns them into @rates
+ * once per sample. Queries only copy @rates, or read @ewma and @history.
+ * @stats_seq covers @rates, @ewma and the history ring. @queues is sampled
+ * in a separate pass under rtnl_lock, see monitor_queues().
  */
 struct netdev_monitor_entry {
     struct net_device *dev;
-    struct simple_net_device_stats current_stats;
-    struct simple_net_device_stats prev_stats;
+    struct netdev_counters current_stats;
+    struct netdev_counters prev_stats;
     unsigned long current_stats_jiffies;
     unsigned long prev_stats_jiffies;
+    struct simple_net_device_stats rates;
+    unsigned long interval;
+    unsigned long next_sample;
+    struct simple_net_device_stats ewma;
+    unsigned int history_head;
+    unsigned int history_count;
+    struct netdev_queue_block __rcu *queues;
+    unsigned long queue_jiffies;
+    seqcount_t stats_seq;
     struct hlist_node hash_node;
+    struct hlist_node ifindex_node;
+    struct list_head list;
+    struct rcu_head rcu;
+    int ifindex;
     char ifname[IFNAMSIZ];
+    struct netdev_history_slot history[TRAFFIC_HISTORY_LEN] ____cacheline_aligned;
+};
+
+/**
+ * netdev_monitor_entry_free - Release a monitor entry after a grace period
+ * @head: RCU head of the entry
+ *
+ * The sampler may still be reading the device statistics through an entry
+ * that was just removed, so the device reference is only dropped here.
+ *
+ * Context: RCU callback (softirq)
+ */
+static void netdev_monitor_entry_free(struct rcu_head *head)
+{
+    struct netdev_monitor_entry *entry = container_of(head, struct netdev_monitor_entry, rcu);
+
+    // A grace period passed since the entry left the tables, so did its queues
+    kfree(rcu_dereference_protected(entry->queues, 1));
+    dev_put(entry->dev);
+    kfree(entry);
+}
+
+/**
+ * struct target_patterns - Device selection from the "devices" parameter
+ * @rcu: Deferred release after the parameter changed
+ * @count: Number of patterns
+ * @buf: Copy of the parameter, split in place
+ * @pat: Glob patterns, pointing into @buf
+ */
+struct target_patterns {
+    struct rcu_head rcu;
+    unsigned int count;
+    char *buf;
+    const char *pat[];
 };
 
 /**
- * is_target_device - Check if device name is in target list
+ * target_patterns - Patterns set with the "devices" parameter, or NULL
+ *
+ * Replaced by the parameter's set handler and read under RCU. NULL selects
+ * the compiled-in target_devices[].
+ */
+static struct target_patterns __rcu *target_patterns;
+
+/**
+ * monitor_ready - Tables are set up, a parameter change rescans devices
+ *
+ * Written under rtnl_lock() by init_traffic_monitor() and
+ * cleanup_traffic_monitor().
+ */
+static bool monitor_ready;
+
+/* Serializes replacements of target_patterns */
+static DEFINE_MUTEX(target_patterns_mutex);
+
+/**
+ * target_patterns_free - Release a pattern set after a grace period
+ * @head: RCU head of the pattern set
+ *
+ * Context: RCU callback (softirq)
+ */
+static void target_patterns_free(struct rcu_head *head)
+{
+    struct target_patterns *tp = container_of(head, struct target_patterns, rcu);
+
+    kfree(tp->buf);
+    kfree(tp);
+}
+
+/**
+ * is_target_device - Check if device name is selected for monitoring
  * @ifname: Network interface name to check
  *
  * Determines whether the given network interface name matches any of the
- * devices listed in the target_devices array. This function is used to
- * filter which network devices should be monitored for traffic statistics.
+ * glob patterns of the "devices" parameter (e.g. "ens1f0v*,eth[01]"), or
+ * any of the names in target_devices[] when the parameter is not set. This
+ * function is used to filter which network devices should be monitored for
+ * traffic statistics. It only runs on device events, not on queries.
  *
- * Context: Any context. No locking required as target_devices is read-only.
- * Return: true if device is in the target list, false otherwise
+ * Context: Any context. Reads the patterns under RCU.
+ * Return: true if device is selected, false otherwise
  */
 static bool is_target_device(const char *ifname)
 {
-    int idx;
+    struct target_patterns *tp;
+    bool match = false;
+    unsigned int idx;
 
     if (!ifname)
         return false;
 
-    for (idx = 0; idx < ARRAY_SIZE(target_devices); idx++) {
-        if (strcmp(ifname, target_devices[idx]) == 0)
-            return true;
+    rcu_read_lock();
+    tp = rcu_dereference(target_patterns);
+    if (tp) {
+        for (idx = 0; idx < tp->count && !match; idx++)
+            match = glob_match(tp->pat[idx], ifname);
+    } else {
+        for (idx = 0; target_devices[idx] && !match; idx++)
+            match = strcmp(ifname, target_devices[idx]) == 0;
+    }
+    rcu_read_unlock();
+
+    return match;
+}
+
+/**
+ * is_target_netdev - Check if a device should be monitored
+ * @dev: Network device
+ *
+ * Only devices of the initial network namespace are monitored: names and
+ * interface indexes, the keys of all queries, are only unique within one
+ * namespace, so a container device could otherwise shadow a host device.
+ *
+ * Context: Any context. Reads the patterns under RCU.
+ * Return: true if @dev is in init_net and its name is selected
+ */
+static bool is_target_netdev(struct net_device *dev)
+{
+    return net_eq(dev_net(dev), &init_net) && is_target_device(dev->name);
+}
+
+/**
+ * netdev_name_bucket - Bucket of netdev_name_table for an interface name
+ * @ifname: Network interface name
+ *
+ * Context: Any context
+ * Return: Hash chain that holds the entry of @ifname, if any
+ */
+static struct hlist_head *netdev_name_bucket(const char *ifname)
+{
+    return &netdev_name_table[hash_32(full_name_hash(NULL, ifname, strlen(ifname)),
+                                      netdev_hash_bits)];
+}
+
+/**
+ * netdev_ifindex_bucket - Bucket of netdev_ifindex_table for an interface index
+ * @ifindex: Interface index
+ *
+ * Context: Any context
+ * Return: Hash chain that holds the entry of @ifindex, if any
+ */
+static struct hlist_head *netdev_ifindex_bucket(int ifindex)
+{
+    return &netdev_ifindex_table[hash_32(ifindex, netdev_hash_bits)];
+}
+
+/**
+ * find_monitor_entry - Look up the monitor entry of an interface index
+ * @ifindex: Interface index
+ *
+ * Context: Inside an RCU read-side critical section, or with
+ *          netdev_monitor_lock held
+ * Return: The entry, or NULL if the device is not monitored
+ */
+static struct netdev_monitor_entry *find_monitor_entry(int ifindex)
+{
+    struct netdev_monitor_entry *entry;
+
+    hlist_for_each_entry_rcu(entry, netdev_ifindex_bucket(ifindex), ifindex_node) {
+        if (entry->ifindex == ifindex)
+            return entry;
+    }
+
+    return NULL;
+}
+
+/**
+ * find_monitor_dev - Look up the monitor entry of a network device
+ * @dev: Network device
+ *
+ * Matches the device itself rather than its interface index, so an event
+ * of a device in another namespace never finds the entry of a monitored
+ * device that happens to have the same index.
+ *
+ * Context: Inside an RCU read-side critical section, or with
+ *          netdev_monitor_lock held
+ * Return: The entry, or NULL if @dev is not monitored
+ */
+static struct netdev_monitor_entry *find_monitor_dev(struct net_device *dev)
+{
+    struct netdev_monitor_entry *entry;
+
+    hlist_for_each_entry_rcu(entry, netdev_ifindex_bucket(dev->ifindex), ifindex_node) {
+        if (entry->dev == dev)
+            return entry;
     }
 
-    return false;
+    return NULL;
 }
 
 /**
  * register_monitor_netdevice - Register a network device for monitoring
- * @ifname: Network interface name to register
+ * @dev: Network device to register
  *
- * Finds the network device by name and adds it to the monitoring hash table
- * for traffic statistics collection. The function validates the interface
- * name, looks up the device in the network namespace, checks for duplicates,
- * and creates a new monitoring entry. A reference to the network device is
- * held to prevent it from being freed while monitored.
+ * Adds the device to the monitoring tables for traffic statistics
+ * collection. The function validates the interface name, checks for
+ * duplicates, and creates a new monitoring entry. A reference to the
+ * network device is held to prevent it from being freed while monitored.
  *
- * The monitoring entry is initialized with zero statistics and added to the
- * hash table under write lock protection. The active monitor count is
+ * The monitoring entry is initialized with zero statistics and published in
+ * the lookup tables under netdev_monitor_lock. The active monitor count is
  * incremented upon successful registration.
  *
- * Context: Process context. Can sleep due to memory allocation with GFP_ATOMIC.
- *          Uses write lock with IRQ disable for hash table protection.
+ * Context: Process context. Takes netdev_monitor_lock.
  * Return: 
  * * 0 - Success
  * * -EINVAL - Invalid interface name or name too long
- * * -ENODEV - Network device not found
  * * -EEXIST - Device already registered for monitoring
  * * -ENOMEM - Memory allocation failed
  */
-static int register_monitor_netdevice(const char* ifname)
+static int register_monitor_netdevice(struct net_device *dev)
 {
-    struct net_device *dev;
     struct netdev_monitor_entry *entry;
-    struct netdev_monitor_entry *existing;
-    unsigned long flags;
-    u32 hash_key;
 
-    if (!ifname || strlen(ifname) >= IFNAMSIZ)
+    if (!dev || strlen(dev->name) >= IFNAMSIZ)
         return -EINVAL;
 
-    dev = dev_get_by_name(&init_net, ifname);
-    if (!dev) {
-        printk(KERN_WARNING "traffic_monitor: Device %s not found\n", ifname);
-        return -ENODEV;
-    }
-
-    write_lock_irqsave(&netdev_monitor_rwlock, flags);
-
-    // Check if already registered
-    hash_key = full_name_hash(NULL, ifname, strlen(ifname));
-    hash_for_each_possible(netdev_monitor_hash, existing, hash_node, hash_key) {
-        if (strcmp(existing->ifname, ifname) == 0) {
-            write_unlock_irqrestore(&netdev_monitor_rwlock, flags);
-            dev_put(dev);
-            printk(KERN_INFO "traffic_monitor: Device %s already registered\n", ifname);
-            return -EEXIST;
-        }
-    }
-
     // Create new entry
-    entry = kmalloc(sizeof(*entry), GFP_ATOMIC);
-    if (!entry) {
-        write_unlock_irqrestore(&netdev_monitor_rwlock, flags);
-        dev_put(dev);
+    entry = kzalloc(sizeof(*entry), GFP_ATOMIC);
+    if (!entry)
         return -ENOMEM;
-    }
 
     entry->dev = dev;
-    strcpy(entry->ifname, ifname);
-    memset(&entry->current_stats, 0, sizeof(entry->current_stats));
-    memset(&entry->prev_stats, 0, sizeof(entry->prev_stats));
-    entry->current_stats_jiffies = 0;
-    entry->prev_stats_jiffies = 0;
+    entry->ifindex = dev->ifindex;
+    strscpy(entry->ifname, dev->name, sizeof(entry->ifname));
+    entry->interval = monitor_min_interval;
+    entry->next_sample = jiffies;
+    seqcount_init(&entry->stats_seq);
 
-    // Add to hash table
-    hash_add(netdev_monitor_hash, &entry->hash_node, hash_key);
+    spin_lock(&netdev_monitor_lock);
 
-    write_unlock_irqrestore(&netdev_monitor_rwlock, flags);
+    // Check if already registered
+    if (find_monitor_dev(dev)) {
+        spin_unlock(&netdev_monitor_lock);
+        kfree(entry);
+        printk(KERN_INFO "traffic_monitor: Device %s already registered\n", dev->name);
+        return -EEXIST;
+    }
+
+    // Publish in lookup tables, readers may see it from now on
+    dev_hold(dev);
+    hlist_add_head_rcu(&entry->hash_node, netdev_name_bucket(entry->ifname));
+    hlist_add_head_rcu(&entry->ifindex_node, netdev_ifindex_bucket(entry->ifindex));
+    list_add_tail_rcu(&entry->list, &netdev_monitor_list);
+
+    spin_unlock(&netdev_monitor_lock);
 
     atomic_inc(&active_monitors);
 
-    printk(KERN_INFO "traffic_monitor: Registered device %s\n", ifname);
+    printk(KERN_INFO "traffic_monitor: Registered device %s (ifindex %d)\n",
+           entry->ifname, entry->ifindex);
     return 0;
 }
 
+/**
+ * remove_monitor_entry - Unlink a monitor entry and release it later
+ * @entry: Entry to remove
+ *
+ * The network device reference that was acquired during registration and
+ * the entry memory are released after an RCU grace period, once no reader
+ * can still see it.
+ *
+ * Context: Caller holds netdev_monitor_lock
+ */
+static void remove_monitor_entry(struct netdev_monitor_entry *entry)
+{
+    hlist_del_rcu(&entry->hash_node);
+    hlist_del_rcu(&entry->ifindex_node);
+    list_del_rcu(&entry->list);
+    call_rcu(&entry->rcu, netdev_monitor_entry_free);
+}
+
 /**
  * unregister_monitor_netdevice - Unregister a network device from monitoring
- * @ifname: Network interface name to unregister
+ * @dev: Network device to unregister
  *
- * Removes the specified network device from the monitoring hash table and
- * cleans up all associated resources. The function searches for the device
- * entry in the hash table, removes it from the table, releases the network
- * device reference that was acquired during registration, and frees the
- * monitoring entry memory.
+ * Removes the specified network device from the monitoring tables and
+ * cleans up all associated resources, see remove_monitor_entry().
  *
  * The active monitor count is decremented when a device is successfully
- * removed. The function is safe to call multiple times for the same device -
- * duplicate unregistration attempts are handled gracefully and return success.
+ * removed. The function is safe to call multiple times for the same device,
+ * and for devices that were never monitored - both are handled gracefully
+ * and return success.
  *
- * Context: Process context. Uses write lock with IRQ disable for hash table
- *          protection during removal operations.
+ * Context: Process context. Takes netdev_monitor_lock.
  * Return:
  * * 0 - Success (device unregistered or was already unregistered)
- * * -EINVAL - Invalid interface name (NULL pointer)
+ * * -EINVAL - Invalid device (NULL pointer)
  */
-static int unregister_monitor_netdevice(const char* ifname)
+static int unregister_monitor_netdevice(struct net_device *dev)
 {
     struct netdev_monitor_entry *entry;
-    unsigned long flags;
-    u32 hash_key;
-    bool found = false;
 
-    if (!ifname)
+    if (!dev)
         return -EINVAL;
 
-    write_lock_irqsave(&netdev_monitor_rwlock, flags);
+    spin_lock(&netdev_monitor_lock);
 
-    hash_key = full_name_hash(NULL, ifname, strlen(ifname));
-    hash_for_each_possible(netdev_monitor_hash, entry, hash_node, hash_key) {
-        if (strcmp(entry->ifname, ifname) == 0) {
-            hash_del(&entry->hash_node);
-            dev_put(entry->dev);
-            kfree(entry);
-            found = true;
-            break;
-        }
-    }
+    entry = find_monitor_dev(dev);
+    if (entry)
+        remove_monitor_entry(entry);
 
-    write_unlock_irqrestore(&netdev_monitor_rwlock, flags);
+    spin_unlock(&netdev_monitor_lock);
 
-    if (found) {
+    if (entry) {
         atomic_dec(&active_monitors);
-        printk(KERN_INFO "traffic_monitor: Unregistered device %s\n", ifname);
-        return 0;
-    } else {
-        // Device not found - may already be unregistered, which is normal
-        printk(KERN_DEBUG "traffic_monitor: Device %s not found (already unregistered)\n", ifname);
-        return 0;  // Return success instead of error for duplicate calls
+        printk(KERN_INFO "traffic_monitor: Unregistered device %s\n", dev->name);
     }
+
+    // Device not found - not selected or already unregistered, which is normal
+    return 0;
 }
 
 /**
@@ -319,24 +745,25 @@ static int unregister_monitor_netdevice(const char* ifname)
  *
  * Calculates the difference between two counter values while properly
  * handling counter overflow scenarios. Network statistics counters are
- * typically monotonic but can wrap around when they exceed the maximum
- * value for their data type (ULONG_MAX for unsigned long).
+ * monotonic 64-bit values (struct rtnl_link_stats64) that can still wrap
+ * around when they exceed U64_MAX, or when a driver folds in narrower
+ * hardware counters.
  *
  * When overflow is detected (current < prev), the function calculates
- * the delta as if the counter wrapped from ULONG_MAX back to 0. This
+ * the delta as if the counter wrapped from U64_MAX back to 0. This
  * ensures accurate delta calculations even when counters overflow during
  * the monitoring interval.
  *
  * Context: Any context. No locking required.
  * Return: Difference value accounting for potential counter overflow
  */
-static inline unsigned long calc_delta_with_overflow(unsigned long current, unsigned long prev)
+static inline u64 calc_delta_with_overflow(u64 current, u64 prev)
 {
     if (current >= prev) {
         return current - prev;
     } else {
         // Overflow occurred (counter wrap around)
-        return (ULONG_MAX - prev) + current + 1;
+        return (U64_MAX - prev) + current + 1;
     }
 }
 
@@ -356,12 +783,195 @@ static inline unsigned long calc_delta_with_overflow(unsigned long current, unsi
  * Context: Any context. No locking required.
  * Return: Per-second rate, or 0 if time_delta_jiffies is 0 (to avoid division by zero)
  */
-static inline unsigned long calc_per_sec_rate(unsigned long delta, unsigned long time_delta_jiffies)
+static inline u64 calc_per_sec_rate(u64 delta, unsigned long time_delta_jiffies)
 {
     if (time_delta_jiffies == 0)
         return 0;
 
-    return (delta * HZ) / time_delta_jiffies;
+    return div64_u64(delta * HZ, time_delta_jiffies);
+}
+
+/**
+ * publish_rates - Replace rates read by netdevice_stats_delta()
+ * @seq: Seqcount protecting @dst
+ * @dst: Published rates
+ * @src: New rates
+ *
+ * Interrupts are disabled for the short write section so a reader
+ * interrupting the sampler on the same CPU cannot spin on an odd sequence
+ * count, as in record_sample().
+ *
+ * Context: Sampler only (the single writer)
+ */
+static void publish_rates(seqcount_t *seq, struct simple_net_device_stats *dst,
+                          const struct simple_net_device_stats *src)
+{
+    unsigned long flags;
+
+    local_irq_save(flags);
+    write_seqcount_begin(seq);
+    *dst = *src;
+    write_seqcount_end(seq);
+    local_irq_restore(flags);
+}
+
+/**
+ * rate_changed - Check if a rate moved by more than MONITOR_RATE_CHANGE_SHIFT
+ * @old_rate: Rate of the previous sample
+ * @new_rate: Rate of this sample
+ *
+ * Context: Any context
+ * Return: true if the rates differ by more than the allowed fraction
+ */
+static bool rate_changed(u64 old_rate, u64 new_rate)
+{
+    u64 diff = old_rate > new_rate ? old_rate - new_rate : new_rate - old_rate;
+
+    return diff > (max(old_rate, new_rate) >> MONITOR_RATE_CHANGE_SHIFT);
+}
+
+/**
+ * adapt_sample_interval - Choose the next sampling interval of a device
+ * @entry: Monitor entry that was just sampled
+ * @rates: Rates of this sample
+ *
+ * An idle device (no counter moved) doubles its interval up to
+ * max_interval_ms, a device whose byte rate changes quickly drops back to
+ * MONITOR_INTERVAL_MS, and a device with steady traffic keeps its
+ * interval. The rates stay exact at any interval because they are computed
+ * from the measured time between samples; a device that wakes up from idle
+ * is noticed within its current interval.
+ *
+ * Context: Sampler only
+ */
+static void adapt_sample_interval(struct netdev_monitor_entry *entry,
+                                  const struct simple_net_device_stats *rates)
+{
+    if (!rates->tx_packets && !rates->rx_packets) {
+        entry->interval = min(entry->interval * 2, monitor_max_interval);
+    } else if (rate_changed(entry->rates.tx_bytes, rates->tx_bytes) ||
+               rate_changed(entry->rates.rx_bytes, rates->rx_bytes)) {
+        entry->interval = monitor_min_interval;
+    }
+}
+
+/**
+ * traffic_ring - Shared sample ring mapped by /dev/traffic_monitor
+ *
+ * One vmalloc_user() area: the header page followed by the record slots.
+ * The sampler is its only writer. Open files pin the module, and with it
+ * the ring, for as long as userspace keeps them or their mappings.
+ */
+static void *traffic_ring;
+static struct traffic_ring_header *traffic_ring_hdr;
+static struct traffic_ring_record *traffic_ring_data;
+static unsigned long traffic_ring_size;
+static bool traffic_ring_registered;
+
+/**
+ * ring_write_sample - Append a device sample to the shared ring
+ * @entry: Monitor entry that was just sampled
+ * @rates: Rates of the sample
+ * @first: This is the first sample of the device
+ *
+ * Userspace readers never block the sampler. A slot is marked invalid
+ * before it is rewritten and gets its index back once complete, so a
+ * reader that copied a slot while it was overwritten sees the mismatch.
+ *
+ * Context: Sampler only (the single writer)
+ */
+static void ring_write_sample(struct netdev_monitor_entry *entry,
+                              const struct simple_net_device_stats *rates, bool first)
+{
+    struct traffic_ring_record *rec;
+    u64 head;
+
+    if (!traffic_ring_hdr)
+        return;
+
+    head = traffic_ring_hdr->head;
+    rec = &traffic_ring_data[head & (traffic_ring_hdr->nr_records - 1)];
+
+    WRITE_ONCE(rec->seq, U64_MAX);
+    smp_wmb();
+
+    rec->timestamp_ns = ktime_get_ns();
+    rec->ifindex = entry->ifindex;
+    rec->flags = first ? TRAFFIC_RECORD_F_FIRST : 0;
+    memcpy(rec->ifname, entry->ifname, sizeof(rec->ifname));
+    rec->tx_packets = entry->current_stats.tx_packets;
+    rec->tx_bytes = entry->current_stats.tx_bytes;
+    rec->rx_packets = entry->current_stats.rx_packets;
+    rec->rx_bytes = entry->current_stats.rx_bytes;
+    rec->tx_packets_rate = rates->tx_packets;
+    rec->tx_bytes_rate = rates->tx_bytes;
+    rec->rx_packets_rate = rates->rx_packets;
+    rec->rx_bytes_rate = rates->rx_bytes;
+
+    smp_store_release(&rec->seq, head);
+    smp_store_release(&traffic_ring_hdr->head, head + 1);
+}
+
+/**
+ * ewma_update - Fold one rate into a moving average
+ * @avg: Average, updated in place
+ * @rate: New rate
+ *
+ * Context: Any context
+ */
+static inline void ewma_update(u64 *avg, u64 rate)
+{
+    *avg = *avg - (*avg >> TRAFFIC_EWMA_SHIFT) + (rate >> TRAFFIC_EWMA_SHIFT);
+}
+
+/**
+ * record_sample - Publish a sample to the readers of a device
+ * @entry: Monitor entry that was just sampled
+ * @rates: Rates of the sample, all zero for the first sample
+ * @first: This is the first sample of the device
+ *
+ * Replaces entry->rates, folds @rates into entry->ewma (the first rates
+ * seed it) and appends the sample to the history ring, all in one write
+ * section of the entry's seqcount. Interrupts are disabled for the short
+ * section so a reader interrupting the sampler on the same CPU cannot spin
+ * on an odd sequence count. The sample is then exported to the shared
+ * ring, see ring_write_sample().
+ *
+ * Context: Sampler only (the single writer)
+ */
+static void record_sample(struct netdev_monitor_entry *entry,
+                          const struct simple_net_device_stats *rates, bool first)
+{
+    struct netdev_history_slot *slot;
+    unsigned long flags;
+
+    local_irq_save(flags);
+    write_seqcount_begin(&entry->stats_seq);
+
+    if (!first) {
+        if (entry->history_count == 1) {
+            entry->ewma = *rates;
+        } else {
+            ewma_update(&entry->ewma.tx_packets, rates->tx_packets);
+            ewma_update(&entry->ewma.tx_bytes, rates->tx_bytes);
+            ewma_update(&entry->ewma.rx_packets, rates->rx_packets);
+            ewma_update(&entry->ewma.rx_bytes, rates->rx_bytes);
+        }
+    }
+    entry->rates = *rates;
+
+    slot = &entry->history[entry->history_head];
+    slot->jiffies = entry->current_stats_jiffies;
+    slot->counters = entry->current_stats;
+    slot->rates = *rates;
+    entry->history_head = (entry->history_head + 1) % TRAFFIC_HISTORY_LEN;
+    if (entry->history_count < TRAFFIC_HISTORY_LEN)
+        entry->history_count++;
+
+    write_seqcount_end(&entry->stats_seq);
+    local_irq_restore(flags);
+
+    ring_write_sample(entry, rates, first);
 }
 
 /**
@@ -373,83 +983,404 @@ static inline unsigned long calc_per_sec_rate(unsigned long delta, unsigned long
  * the current statistics to previous and fetching fresh statistics from
  * the device. This creates a snapshot pair needed for delta calculations.
  *
- * The function first attempts to use the device's ndo_get_stats operation
- * if available, which may provide more accurate or device-specific statistics.
- * If that method is not available, it falls back to reading directly from
- * the device's built-in stats structure.
+ * The counters come from dev_get_stats(), which uses the driver's
+ * ndo_get_stats64 (or ndo_get_stats) and folds in the core's own drop
+ * counters, and always returns 64-bit values.
  *
  * The timestamp is updated to reflect when this statistics snapshot was
  * taken, enabling accurate rate calculations based on the time difference
  * between consecutive updates.
  *
- * Context: Must be called with netdev_monitor_rwlock held for write access.
- *          The device reference is guaranteed valid during the call.
+ * The per-second rates are computed here, once per sample, and published
+ * with the history and EWMA, see record_sample(). They stay zero until the
+ * device has two samples. The sample also decides when the device is
+ * sampled again.
+ *
+ * Context: Sampler only (the single writer), inside an RCU read-side
+ *          critical section. The device reference is guaranteed valid
+ *          during the call.
  */
 static void update_device_stats(struct netdev_monitor_entry *entry, unsigned long update_jiffies)
 {
-    struct net_device_stats *dev_stats;
+    struct rtnl_link_stats64 dev_stats;
+    struct simple_net_device_stats rates = {};
+    unsigned long time_delta_jiffies;
+    u64 raw_delta;
 
     // Save previous stats
     entry->prev_stats = entry->current_stats;
     entry->prev_stats_jiffies = entry->current_stats_jiffies;
 
-    // Get current stats from device
-    if (entry->dev->netdev_ops && entry->dev->netdev_ops->ndo_get_stats) {
-        dev_stats = entry->dev->netdev_ops->ndo_get_stats(entry->dev);
-        if (dev_stats) {
-            entry->current_stats.tx_packets = dev_stats->tx_packets;
-            entry->current_stats.tx_bytes = dev_stats->tx_bytes;
-            entry->current_stats.rx_packets = dev_stats->rx_packets;
-            entry->current_stats.rx_bytes = dev_stats->rx_bytes;
-        }
-    } else {
-        // Fallback to dev->stats
-        entry->current_stats.tx_packets = entry->dev->stats.tx_packets;
-        entry->current_stats.tx_bytes = entry->dev->stats.tx_bytes;
-        entry->current_stats.rx_packets = entry->dev->stats.rx_packets;
-        entry->current_stats.rx_bytes = entry->dev->stats.rx_bytes;
-    }
+    // Get current 64-bit stats from device
+    dev_get_stats(entry->dev, &dev_stats);
+    entry->current_stats.tx_packets = dev_stats.tx_packets;
+    entry->current_stats.tx_bytes = dev_stats.tx_bytes;
+    entry->current_stats.rx_packets = dev_stats.rx_packets;
+    entry->current_stats.rx_bytes = dev_stats.rx_bytes;
 
     // Update timestamp
     entry->current_stats_jiffies = update_jiffies;
+    entry->next_sample = update_jiffies + entry->interval;
+
+    // First sample, no rates yet
+    if (!entry->prev_stats_jiffies) {
+        record_sample(entry, &rates, true);
+        return;
+    }
+
+    // Calculate time delta
+    if (entry->current_stats_jiffies >= entry->prev_stats_jiffies) {
+        time_delta_jiffies = entry->current_stats_jiffies - entry->prev_stats_jiffies;
+    } else {
+        time_delta_jiffies = (ULONG_MAX - entry->prev_stats_jiffies) + entry->current_stats_jiffies + 1;
+    }
+
+    // Calculate per-second rates
+    raw_delta = calc_delta_with_overflow(entry->current_stats.tx_packets, entry->prev_stats.tx_packets);
+    rates.tx_packets = calc_per_sec_rate(raw_delta, time_delta_jiffies);
+
+    raw_delta = calc_delta_with_overflow(entry->current_stats.tx_bytes, entry->prev_stats.tx_bytes);
+    rates.tx_bytes = calc_per_sec_rate(raw_delta, time_delta_jiffies);
+
+    raw_delta = calc_delta_with_overflow(entry->current_stats.rx_packets, entry->prev_stats.rx_packets);
+    rates.rx_packets = calc_per_sec_rate(raw_delta, time_delta_jiffies);
+
+    raw_delta = calc_delta_with_overflow(entry->current_stats.rx_bytes, entry->prev_stats.rx_bytes);
+    rates.rx_bytes = calc_per_sec_rate(raw_delta, time_delta_jiffies);
+
+    adapt_sample_interval(entry, &rates);
+    entry->next_sample = update_jiffies + entry->interval;
+
+    record_sample(entry, &rates, false);
 }
 
 /**
- * monitor_netdevices - Update statistics for all monitored devices
- *
- * Iterates through all registered network devices in the monitoring hash
- * table and updates their traffic statistics. For each device, the current
- * statistics become the previous statistics, and fresh statistics are
- * fetched from the network device. All devices are updated with the same
- * timestamp to ensure consistent timing across the monitoring system.
- *
- * This function is typically called periodically by the monitoring work
- * queue to maintain up-to-date statistics for rate calculations. The
- * consistent timestamp across all devices enables accurate comparative
- * analysis of traffic rates.
+ * metric_rate - Pick the rate of one metric
+ * @rates: Per-second rates of a device or of the aggregate
+ * @metric: enum traffic_metric
  *
- * Context: Any context. Uses write lock with IRQ disable to protect
- *          hash table iteration and prevent device list modifications
- *          during the update process.
+ * Context: Any context
  */
-static void monitor_netdevices(void)
+static u64 metric_rate(const struct simple_net_device_stats *rates, enum traffic_metric metric)
 {
-    struct netdev_monitor_entry *entry;
-    unsigned long flags;
-    int bkt;
-    unsigned long update_jiffies = jiffies;
-
-    write_lock_irqsave(&netdev_monitor_rwlock, flags);
-
-    hash_for_each(netdev_monitor_hash, bkt, entry, hash_node) {
-        update_device_stats(entry, update_jiffies);
+    switch (metric) {
+    case TRAFFIC_METRIC_TX_PACKETS:
+        return rates->tx_packets;
+    case TRAFFIC_METRIC_TX_BYTES:
+        return rates->tx_bytes;
+    case TRAFFIC_METRIC_RX_PACKETS:
+        return rates->rx_packets;
+    case TRAFFIC_METRIC_RX_BYTES:
+    default:
+        return rates->rx_bytes;
     }
-
-    write_unlock_irqrestore(&netdev_monitor_rwlock, flags);
 }
 
 /**
- * monitor_work_handler - Delayed work handler for periodic monitoring
+ * evaluate_subscriptions - Deliver threshold crossings of the last sampling pass
+ * @total: Aggregate rates just published
+ *
+ * Evaluates every subscription whose device got a new sample, and every
+ * aggregate subscription, against the rates the sampler just computed; no
+ * device is read again. A device that stopped being monitored counts as
+ * idle, so an active band is left once when the device goes away.
+ *
+ * The watch item of a subscription is tracked apart from the callback:
+ * a state state_watcher_notify() refused (e.g. -EAGAIN while the watcher
+ * is stopped) is pushed again with the next sample until it is accepted.
+ *
+ * Context: Sampler only, inside an RCU read-side critical section
+ */
+static void evaluate_subscriptions(const struct simple_net_device_stats *total)
+{
+    static const struct simple_net_device_stats idle;
+    const struct simple_net_device_stats *rates;
+    struct netdev_monitor_entry *entry;
+    struct traffic_subscription *sub;
+    unsigned long sample;
+    bool above;
+    u64 rate;
+
+    list_for_each_entry_rcu(sub, &traffic_subscriptions, list) {
+        if (sub->ifname[0]) {
+            rates = &idle;
+            sample = 0;
+            hlist_for_each_entry_rcu(entry, netdev_name_bucket(sub->ifname), hash_node) {
+                if (strcmp(entry->ifname, sub->ifname) == 0) {
+                    // Rates are owned by the sampler, no seqcount needed to read them
+                    rates = &entry->rates;
+                    sample = entry->current_stats_jiffies;
+                    break;
+                }
+            }
+            // Nothing new since the last evaluation
+            if (sample == sub->last_sample)
+                continue;
+            sub->last_sample = sample;
+        } else {
+            rates = total;
+        }
+
+        rate = metric_rate(rates, sub->metric);
+        above = sub->above ? rate >= sub->exit : rate >= sub->enter;
+        if (above != sub->above) {
+            sub->above = above;
+            if (sub->func)
+                sub->func(sub, above, rate, sub->private_data);
+        }
+
+        // Only a delivered state counts, a refused one is retried next sample
+        if (sub->item && sub->item_above != above &&
+            state_watcher_notify(sub->item, above) == 0)
+            sub->item_above = above;
+    }
+}
+
+/**
+ * monitor_netdevices - Update statistics for all due devices
+ *
+ * Iterates through all registered network devices in netdev_monitor_list
+ * and updates the traffic statistics of those whose sampling interval has
+ * elapsed. For each such device, the current statistics become the
+ * previous statistics, and fresh statistics are fetched from the network
+ * device. All devices sampled by one run share the same timestamp.
+ *
+ * This function is called by the monitoring work, which is shared by all
+ * devices. Only due devices cost a dev_get_stats() call, so the sampling
+ * cost scales with the busy interfaces rather than with all of them.
+ *
+ * The rates of all devices are summed on the way and published as the
+ * aggregate for netdevice_stats_delta(NULL). Threshold subscriptions are
+ * evaluated on the same rates at the end of the pass.
+ *
+ * Context: Any context. Walks the list under RCU; entries are updated one
+ *          at a time, see update_device_stats().
+ * Return: Jiffies until the next device is due
+ */
+static unsigned long monitor_netdevices(void)
+{
+    struct netdev_monitor_entry *entry;
+    struct simple_net_device_stats total;
+    unsigned long update_jiffies = jiffies;
+    unsigned long next = update_jiffies + monitor_max_interval;
+    unsigned int sampled = 0;
+
+    memset(&total, 0, sizeof(total));
+
+    rcu_read_lock();
+
+    list_for_each_entry_rcu(entry, &netdev_monitor_list, list) {
+        if (time_after_eq(update_jiffies, entry->next_sample)) {
+            update_device_stats(entry, update_jiffies);
+            sampled++;
+        }
+
+        if (time_before(entry->next_sample, next))
+            next = entry->next_sample;
+
+        // Rates are owned by the sampler, no seqcount needed to read them
+        total.tx_packets += entry->rates.tx_packets;
+        total.tx_bytes += entry->rates.tx_bytes;
+        total.rx_packets += entry->rates.rx_packets;
+        total.rx_bytes += entry->rates.rx_bytes;
+    }
+
+    publish_rates(&netdev_monitor_total_seq, &netdev_monitor_total_rates, &total);
+
+    evaluate_subscriptions(&total);
+
+    rcu_read_unlock();
+
+    WRITE_ONCE(sampler_stats.devices_sampled, sampler_stats.devices_sampled + sampled);
+    if (sampled > sampler_stats.max_devices_per_pass)
+        WRITE_ONCE(sampler_stats.max_devices_per_pass, sampled);
+
+    return max_t(long, (long)(next - update_jiffies), 1);
+}
+
+/**
+ * queue_counter - Read a per-queue counter a driver may not report
+ * @val: Counter as filled by the driver
+ *
+ * The queue statistics are preset to all ones before the driver fills
+ * them, like the netdev netlink family does; counters left untouched are
+ * not supported and read as zero.
+ *
+ * Context: Any context
+ */
+static inline u64 queue_counter(u64 val)
+{
+    return val == U64_MAX ? 0 : val;
+}
+
+/**
+ * update_queue_stats - Sample the per-queue counters of one device
+ * @entry: Monitor entry whose device was just sampled
+ *
+ * Reads the RX and TX queue counters through the driver's netdev_stat_ops,
+ * the same source as the netdev netlink qstats, and replaces the published
+ * per-queue rates. The driver callbacks may sleep, so they fill the
+ * sampler-private counters first; the rates are then computed in one short
+ * write section, giving readers a consistent view across all queues.
+ *
+ * Devices without queue statistics are skipped. A new block is published
+ * when the device changes its queue counts (ethtool -L); its rates become
+ * valid with its second sample.
+ *
+ * Context: Process context, caller holds rtnl_lock() as netdev_stat_ops
+ *          requires. Sampler only.
+ */
+static void update_queue_stats(struct netdev_monitor_entry *entry)
+{
+    const struct netdev_stat_ops *ops = entry->dev->stat_ops;
+    struct netdev_queue_block *blk, *old;
+    struct netdev_queue_stats_rx rx;
+    struct netdev_queue_stats_tx tx;
+    struct netdev_queue_slot *slot;
+    unsigned long now, time_delta_jiffies, flags;
+    unsigned int i, num_rx, num_tx;
+
+    entry->queue_jiffies = entry->current_stats_jiffies;
+
+    if (!ops)
+        return;
+
+    num_rx = ops->get_queue_stats_rx ? entry->dev->real_num_rx_queues : 0;
+    num_tx = ops->get_queue_stats_tx ? entry->dev->real_num_tx_queues : 0;
+    if (!num_rx && !num_tx)
+        return;
+
+    // Queue counts only change under rtnl, a new block starts over
+    old = rcu_dereference_protected(entry->queues, lockdep_rtnl_is_held());
+    blk = old;
+    if (!blk || blk->num_rx != num_rx || blk->num_tx != num_tx) {
+        blk = kzalloc(struct_size(blk, q, num_rx + num_tx), GFP_KERNEL);
+        if (!blk)
+            return;
+        seqcount_init(&blk->seq);
+        blk->num_rx = num_rx;
+        blk->num_tx = num_tx;
+    }
+
+    // Driver callbacks may sleep, fill the private counters first
+    for (i = 0; i < num_rx; i++) {
+        memset(&rx, 0xff, sizeof(rx));
+        ops->get_queue_stats_rx(entry->dev, i, &rx);
+        blk->q[i].cur.packets = queue_counter(rx.packets);
+        blk->q[i].cur.bytes = queue_counter(rx.bytes);
+    }
+    for (i = 0; i < num_tx; i++) {
+        memset(&tx, 0xff, sizeof(tx));
+        ops->get_queue_stats_tx(entry->dev, i, &tx);
+        blk->q[num_rx + i].cur.packets = queue_counter(tx.packets);
+        blk->q[num_rx + i].cur.bytes = queue_counter(tx.bytes);
+    }
+    now = jiffies;
+
+    if (blk != old) {
+        // First sample of this block, no rates yet
+        for (i = 0; i < num_rx + num_tx; i++)
+            blk->q[i].prev = blk->q[i].cur;
+        blk->jiffies = now;
+        rcu_assign_pointer(entry->queues, blk);
+        if (old)
+            kfree_rcu(old, rcu);
+        return;
+    }
+
+    time_delta_jiffies = now - blk->jiffies;
+
+    local_irq_save(flags);
+    write_seqcount_begin(&blk->seq);
+
+    for (i = 0; i < num_rx + num_tx; i++) {
+        slot = &blk->q[i];
+        slot->rates.packets = calc_per_sec_rate(calc_delta_with_overflow(slot->cur.packets,
+                                                                         slot->prev.packets),
+                                                time_delta_jiffies);
+        slot->rates.bytes = calc_per_sec_rate(calc_delta_with_overflow(slot->cur.bytes,
+                                                                       slot->prev.bytes),
+                                              time_delta_jiffies);
+        slot->prev = slot->cur;
+    }
+    blk->jiffies = now;
+    blk->rates_valid = true;
+
+    write_seqcount_end(&blk->seq);
+    local_irq_restore(flags);
+}
+
+/**
+ * monitor_queues - Update the per-queue statistics of freshly sampled devices
+ *
+ * Runs after monitor_netdevices() and samples the queues of every device
+ * whose device counters were sampled since its last queue sample, so the
+ * queues follow the same adaptive interval. netdev_stat_ops needs
+ * rtnl_lock(); the sampler only tries to take it and leaves the queues for
+ * a later tick when it is contended, rather than delaying the device
+ * samples of all interfaces behind a long configuration change.
+ *
+ * Entries are only added and removed under rtnl_lock(), or with the
+ * sampler stopped, so the list is stable while it is held.
+ *
+ * Context: Process context (monitoring work). May sleep.
+ */
+static void monitor_queues(void)
+{
+    struct netdev_monitor_entry *entry;
+
+    if (!rtnl_trylock())
+        return;
+
+    list_for_each_entry(entry, &netdev_monitor_list, list) {
+        if (entry->queue_jiffies != entry->current_stats_jiffies)
+            update_queue_stats(entry);
+    }
+
+    rtnl_unlock();
+}
+
+/**
+ * monitor_next_delay - Delay until the next statistics sample
+ * @delay: Time until the next device is due (in jiffies)
+ *
+ * @delay, moved up to the next multiple of MONITOR_INTERVAL_MS in absolute
+ * jiffies when coalesce_wakeups is set. All sampling intervals are
+ * multiples of MONITOR_INTERVAL_MS, so devices stay on the grid.
+ *
+ * Context: Any context
+ * Return: Delay in jiffies
+ */
+static unsigned long monitor_next_delay(unsigned long delay)
+{
+    unsigned long rem;
+
+    if (!coalesce_wakeups) {
+        return delay;
+    }
+
+    rem = (jiffies + delay) % monitor_min_interval;
+
+    return rem ? delay + monitor_min_interval - rem : delay;
+}
+
+/**
+ * sampler_hist_bucket - Histogram bucket of a value
+ * @val: Value to account
+ *
+ * Context: Any context
+ * Return: Bucket index, see TRAFFIC_STATS_HIST_BUCKETS
+ */
+static unsigned int sampler_hist_bucket(u64 val)
+{
+    if (!val)
+        return 0;
+
+    return min_t(unsigned int, ilog2(val), TRAFFIC_STATS_HIST_BUCKETS - 1);
+}
+
+/**
+ * monitor_work_handler - Delayed work handler for periodic monitoring
  * @work: Work structure (unused, but required by work queue interface)
  *
  * Periodic work function that updates network device statistics for all
@@ -458,7 +1389,7 @@ static void monitor_netdevices(void)
  * updates statistics for all registered devices.
  *
  * The work handler implements a self-rescheduling pattern: it continues
- * to reschedule itself at MONITOR_INTERVAL_MS intervals as long as there
+ * to reschedule itself for the next due device as long as there
  * are active monitors and the stop flag is not set. When no devices are
  * being monitored or a stop is requested, the periodic updates cease
  * automatically.
@@ -471,6 +1402,9 @@ static void monitor_netdevices(void)
  */
 static void monitor_work_handler(struct work_struct *work)
 {
+    unsigned long delay, late;
+    unsigned int bucket;
+    u64 start_ns;
     int active_count;
 
     // Check stop flag first to avoid infinite rescheduling during cleanup
@@ -479,14 +1413,27 @@ static void monitor_work_handler(struct work_struct *work)
         return;
     }
 
-    // Update all monitored devices
-    monitor_netdevices();
+    late = time_after(jiffies, READ_ONCE(monitor_planned)) ? jiffies - READ_ONCE(monitor_planned) : 0;
+    start_ns = ktime_get_ns();
+
+    // Update all due devices, then their queues
+    delay = monitor_netdevices();
+    monitor_queues();
+
+    // Single writer, plain increments published for the debugfs reader
+    WRITE_ONCE(sampler_stats.passes, sampler_stats.passes + 1);
+    bucket = sampler_hist_bucket(ktime_get_ns() - start_ns);
+    WRITE_ONCE(sampler_stats.pass_ns[bucket], sampler_stats.pass_ns[bucket] + 1);
+    bucket = sampler_hist_bucket(jiffies_to_usecs(late));
+    WRITE_ONCE(sampler_stats.lateness_us[bucket], sampler_stats.lateness_us[bucket] + 1);
 
     // Check if we should continue monitoring
     active_count = atomic_read(&active_monitors);
     if (active_count > 0 && !atomic_read(&monitor_stop_flag)) {
         // Reschedule for next update only if not stopping
-        schedule_delayed_work(&monitor_work, msecs_to_jiffies(MONITOR_INTERVAL_MS));
+        delay = monitor_next_delay(delay);
+        WRITE_ONCE(monitor_planned, jiffies + delay);
+        schedule_delayed_work(&monitor_work, delay);
     } else {
         printk(KERN_INFO "traffic_monitor: No active monitors, stopping periodic updates\n");
     }
@@ -504,20 +1451,49 @@ static void monitor_work_handler(struct work_struct *work)
  * The monitoring work is scheduled to run after MONITOR_INTERVAL_MS
  * milliseconds and will continue to reschedule itself as long as there
  * are active monitors. If monitoring is already running (active_monitors > 1),
- * this function does nothing, avoiding duplicate work scheduling.
+ * the work may be sleeping for the long interval of idle devices, so it is
+ * pulled in to take the first sample of the new device in time.
  *
  * Context: Any context. Should be called after successfully registering
  *          a device and incrementing active_monitors count.
  */
 static void start_monitoring(void)
 {
+    unsigned long delay = monitor_next_delay(monitor_min_interval);
+
+    WRITE_ONCE(monitor_planned, jiffies + delay);
     if (atomic_read(&active_monitors) == 1) {
         // First device registered, start monitoring
-        schedule_delayed_work(&monitor_work, msecs_to_jiffies(MONITOR_INTERVAL_MS));
+        schedule_delayed_work(&monitor_work, delay);
         printk(KERN_INFO "traffic_monitor: Started periodic monitoring\n");
+    } else {
+        mod_delayed_work(system_wq, &monitor_work, delay);
     }
 }
 
+/**
+ * read_rates - Copy rates published by the sampler
+ * @seq: Seqcount protecting @src
+ * @src: Published rates
+ *
+ * Context: Any context. Lock-free, retries only if the sampler replaced
+ *          the rates meanwhile.
+ * Return: Consistent copy of @src
+ */
+static struct simple_net_device_stats read_rates(const seqcount_t *seq,
+                                                 const struct simple_net_device_stats *src)
+{
+    struct simple_net_device_stats rates;
+    unsigned int start;
+
+    do {
+        start = read_seqcount_begin(seq);
+        rates = *src;
+    } while (read_seqcount_retry(seq, start));
+
+    return rates;
+}
+
 /**
  * netdevice_stats_delta_single - Get per-second traffic statistics for one device
  * @ifname: Network interface name (e.g., "eth0", "wlan0")
@@ -531,8 +1507,10 @@ static void start_monitoring(void)
  * - Currently UP and being monitored
  * - Have at least two measurement samples
  *
- * Context: Any context (uses spinlock_irqsave for protection).
- * Locking: Takes netdev_monitor_lock internally.
+ * Context: Any context, including hard and soft interrupts.
+ * Locking: Lock-free. A device query looks the entry up under RCU, the
+ *          aggregate query reads no entry at all; both only copy rates
+ *          the sampler computed with its last sample.
  *
  * Return: struct simple_net_device_stats containing per-second rates.
  *         All fields will be zero if:
@@ -547,14 +1525,14 @@ static void start_monitoring(void)
  * 
  * stats = netdevice_stats_delta("eth0");
  * if (stats.tx_packets > 0 || stats.rx_packets > 0) {
- *     printk("eth0 traffic: TX %lu pps/%lu bps, RX %lu pps/%lu bps\n",
+ *     printk("eth0 traffic: TX %llu pps/%llu bps, RX %llu pps/%llu bps\n",
  *            stats.tx_packets, stats.tx_bytes,
  *            stats.rx_packets, stats.rx_bytes);
  * }
  *
  * stats = netdevice_stats_delta(NULL);
  * if (stats.tx_packets > 0 || stats.rx_packets > 0) {
- *     printk("Total traffic: TX %lu pps/%lu bps, RX %lu pps/%lu bps\n",
+ *     printk("Total traffic: TX %llu pps/%llu bps, RX %llu pps/%llu bps\n",
  *            stats.tx_packets, stats.tx_bytes,
  *            stats.rx_packets, stats.rx_bytes);
  * }
@@ -564,79 +1542,474 @@ struct simple_net_device_stats netdevice_stats_delta(const char* ifname)
 {
     struct simple_net_device_stats delta;
     struct netdev_monitor_entry *entry;
-    unsigned long flags;
-    u32 hash_key;
     bool found = false;
-    int bkt;
-    unsigned long time_delta_jiffies;
-    unsigned long raw_delta;
 
     memset(&delta, 0, sizeof(delta));
 
-    read_lock_irqsave(&netdev_monitor_rwlock, flags);
-
     if (ifname) {
         // Single device mode
-        hash_key = full_name_hash(NULL, ifname, strlen(ifname));
-        hash_for_each_possible(netdev_monitor_hash, entry, hash_node, hash_key) {
+        rcu_read_lock();
+        hlist_for_each_entry_rcu(entry, netdev_name_bucket(ifname), hash_node) {
             if (strcmp(entry->ifname, ifname) == 0) {
-                // Calculate time delta
-                if (entry->current_stats_jiffies >= entry->prev_stats_jiffies) {
-                    time_delta_jiffies = entry->current_stats_jiffies - entry->prev_stats_jiffies;
-                } else {
-                    time_delta_jiffies = (ULONG_MAX - entry->prev_stats_jiffies) + entry->current_stats_jiffies + 1;
-                }
-
-                // Calculate per-second rates
-                raw_delta = calc_delta_with_overflow(entry->current_stats.tx_packets, entry->prev_stats.tx_packets);
-                delta.tx_packets = calc_per_sec_rate(raw_delta, time_delta_jiffies);
-
-                raw_delta = calc_delta_with_overflow(entry->current_stats.tx_bytes, entry->prev_stats.tx_bytes);
-                delta.tx_bytes = calc_per_sec_rate(raw_delta, time_delta_jiffies);
-
-                raw_delta = calc_delta_with_overflow(entry->current_stats.rx_packets, entry->prev_stats.rx_packets);
-                delta.rx_packets = calc_per_sec_rate(raw_delta, time_delta_jiffies);
-
-                raw_delta = calc_delta_with_overflow(entry->current_stats.rx_bytes, entry->prev_stats.rx_bytes);
-                delta.rx_bytes = calc_per_sec_rate(raw_delta, time_delta_jiffies);
-
+                delta = read_rates(&entry->stats_seq, &entry->rates);
                 found = true;
                 break;
             }
         }
+        rcu_read_unlock();
 
         if (!found) {
             printk(KERN_WARNING "traffic_monitor: Device %s not found in monitor list\n", ifname);
         }
     } else {
-        // All devices mode - aggregate statistics
-        hash_for_each(netdev_monitor_hash, bkt, entry, hash_node) {
-            // Calculate time delta for this device
-            if (entry->current_stats_jiffies >= entry->prev_stats_jiffies) {
-                time_delta_jiffies = entry->current_stats_jiffies - entry->prev_stats_jiffies;
-            } else {
-                time_delta_jiffies = (ULONG_MAX - entry->prev_stats_jiffies) + entry->current_stats_jiffies + 1;
-            }
+        // All devices mode - aggregate summed by the sampler
+        delta = read_rates(&netdev_monitor_total_seq, &netdev_monitor_total_rates);
+    }
+
+    return delta;
+}
+EXPORT_SYMBOL_GPL(netdevice_stats_delta);
+
+/**
+ * netdevice_stats_delta_ifindex - Get per-second traffic statistics by ifindex
+ * @ifindex: Interface index of a monitored device (dev->ifindex)
+ *
+ * Same as netdevice_stats_delta() for a single device, but looks the device
+ * up by interface index, which needs neither a name hash nor a string
+ * compare. Callers that already hold a struct net_device or an skb should
+ * prefer this variant on hot paths.
+ *
+ * Context: Any context, including hard and soft interrupts.
+ * Locking: Lock-free, looks the entry up under RCU.
+ *
+ * Return: struct simple_net_device_stats containing per-second rates, all
+ *         zero if the device is not monitored or has fewer than two samples
+ *
+ * Example:
+ * @code
+ * struct simple_net_device_stats rates = netdevice_stats_delta_ifindex(skb->dev->ifindex);
+ *
+ * if (TRAFFIC_STATS_TO_MBPS(rates.tx_bytes) > 5000)
+ *     my_enable_tx_batching(priv);
+ * @endcode
+ */
+struct simple_net_device_stats netdevice_stats_delta_ifindex(int ifindex)
+{
+    struct simple_net_device_stats delta;
+    struct netdev_monitor_entry *entry;
 
-            // Add per-second rates to total
-            raw_delta = calc_delta_with_overflow(entry->current_stats.tx_packets, entry->prev_stats.tx_packets);
-            delta.tx_packets += calc_per_sec_rate(raw_delta, time_delta_jiffies);
+    memset(&delta, 0, sizeof(delta));
+
+    rcu_read_lock();
+    entry = find_monitor_entry(ifindex);
+    if (entry)
+        delta = read_rates(&entry->stats_seq, &entry->rates);
+    rcu_read_unlock();
+
+    return delta;
+}
+EXPORT_SYMBOL_GPL(netdevice_stats_delta_ifindex);
+
+/**
+ * window_top_insert - Keep the largest values seen so far
+ * @top: Values in descending order
+ * @n: Number of valid entries in @top
+ * @k: Capacity of @top
+ * @val: New value
+ *
+ * Context: Any context
+ */
+static void window_top_insert(u64 *top, unsigned int n, unsigned int k, u64 val)
+{
+    unsigned int i = min(n, k - 1);
+
+    if (n >= k && val <= top[k - 1])
+        return;
 
-            raw_delta = calc_delta_with_overflow(entry->current_stats.tx_bytes, entry->prev_stats.tx_bytes);
-            delta.tx_bytes += calc_per_sec_rate(raw_delta, time_delta_jiffies);
+    for (; i > 0 && top[i - 1] < val; i--)
+        top[i] = top[i - 1];
+    top[i] = val;
+}
+
+/**
+ * history_window - Compute windowed statistics from a device's history
+ * @entry: Monitor entry, found under RCU
+ * @window_jiffies: Length of the window
+ * @out: Result
+ *
+ * Walks at most TRAFFIC_HISTORY_LEN slots, newest first, inside a seqcount
+ * read section. The newest sample is always part of the window. The
+ * average is taken from the counters at both ends of the window, so it is
+ * exact regardless of how often the device was sampled, peak and p95 are
+ * taken over the per-sample rates. The p95 is the (n/20 + 1)-th largest of
+ * the n rates, tracked with a small top list instead of sorting.
+ *
+ * Context: Any context, inside an RCU read-side critical section. Lock-free.
+ * Return: 0 on success, -EAGAIN if the device has fewer than two samples
+ */
+static int history_window(struct netdev_monitor_entry *entry, unsigned long window_jiffies,
+                          struct traffic_window_stats *out)
+{
+    u64 top_txp[TRAFFIC_P95_RANK_MAX], top_txb[TRAFFIC_P95_RANK_MAX];
+    u64 top_rxp[TRAFFIC_P95_RANK_MAX], top_rxb[TRAFFIC_P95_RANK_MAX];
+    const struct netdev_history_slot *newest, *slot, *base;
+    unsigned long span;
+    unsigned int n, rank, seq;
+
+    do {
+        seq = read_seqcount_begin(&entry->stats_seq);
+
+        memset(out, 0, sizeof(*out));
+        if (entry->history_count < 2)
+            continue;
+
+        newest = &entry->history[(entry->history_head + TRAFFIC_HISTORY_LEN - 1) %
+                                 TRAFFIC_HISTORY_LEN];
+        for (n = 0; n + 1 < entry->history_count; n++) {
+            slot = &entry->history[(entry->history_head + TRAFFIC_HISTORY_LEN - 1 - n) %
+                                   TRAFFIC_HISTORY_LEN];
+            if (n && newest->jiffies - slot->jiffies >= window_jiffies)
+                break;
+
+            window_top_insert(top_txp, n, TRAFFIC_P95_RANK_MAX, slot->rates.tx_packets);
+            window_top_insert(top_txb, n, TRAFFIC_P95_RANK_MAX, slot->rates.tx_bytes);
+            window_top_insert(top_rxp, n, TRAFFIC_P95_RANK_MAX, slot->rates.rx_packets);
+            window_top_insert(top_rxb, n, TRAFFIC_P95_RANK_MAX, slot->rates.rx_bytes);
+        }
+        base = &entry->history[(entry->history_head + TRAFFIC_HISTORY_LEN - 1 - n) %
+                               TRAFFIC_HISTORY_LEN];
+        span = newest->jiffies - base->jiffies;
+
+        out->samples = n;
+        out->window_ms = jiffies_to_msecs(span);
+        out->avg.tx_packets = calc_per_sec_rate(calc_delta_with_overflow(newest->counters.tx_packets,
+                                                                         base->counters.tx_packets), span);
+        out->avg.tx_bytes = calc_per_sec_rate(calc_delta_with_overflow(newest->counters.tx_bytes,
+                                                                       base->counters.tx_bytes), span);
+        out->avg.rx_packets = calc_per_sec_rate(calc_delta_with_overflow(newest->counters.rx_packets,
+                                                                         base->counters.rx_packets), span);
+        out->avg.rx_bytes = calc_per_sec_rate(calc_delta_with_overflow(newest->counters.rx_bytes,
+                                                                       base->counters.rx_bytes), span);
+
+        out->peak.tx_packets = top_txp[0];
+        out->peak.tx_bytes = top_txb[0];
+        out->peak.rx_packets = top_rxp[0];
+        out->peak.rx_bytes = top_rxb[0];
+
+        rank = min(n / 20, (unsigned int)TRAFFIC_P95_RANK_MAX - 1);
+        out->p95.tx_packets = top_txp[rank];
+        out->p95.tx_bytes = top_txb[rank];
+        out->p95.rx_packets = top_rxp[rank];
+        out->p95.rx_bytes = top_rxb[rank];
+
+        out->ewma = entry->ewma;
+    } while (read_seqcount_retry(&entry->stats_seq, seq));
+
+    return out->samples ? 0 : -EAGAIN;
+}
+
+/**
+ * netdevice_stats_window - Get smoothed traffic statistics of one device
+ * @ifname: Network interface name of a monitored device
+ * @window_ms: Length of the window in milliseconds
+ * @out: Filled with the statistics of the window
+ *
+ * Complements netdevice_stats_delta(), which only reports the last sample,
+ * with statistics over the recent history the sampler keeps per device
+ * (the last TRAFFIC_HISTORY_LEN samples):
+ * - avg: mean rate over the window, exact for any sampling interval
+ * - peak: highest per-sample rate in the window
+ * - p95: 95th percentile of the per-sample rates in the window
+ * - ewma: moving average over all samples, independent of @window_ms
+ *
+ * The window covers the newest sample and all older ones taken less than
+ * @window_ms before it, bounded by the history length; out->window_ms and
+ * out->samples report what was actually covered. Idle devices are sampled
+ * less often (see max_interval_ms), so the same window holds fewer samples.
+ *
+ * Context: Any context, including hard and soft interrupts.
+ * Locking: Lock-free, no allocation; the cost is bounded by
+ *          TRAFFIC_HISTORY_LEN.
+ * Return: 0 on success, -EINVAL for invalid arguments, -ENODEV if the
+ *         device is not monitored, -EAGAIN if it has fewer than two samples
+ *
+ * Example:
+ * @code
+ * struct traffic_window_stats win;
+ *
+ * if (!netdevice_stats_window("eth0", 1000, &win))
+ *     pr_info("eth0: avg %llu Mbps, p95 %llu Mbps over %u ms\n",
+ *             TRAFFIC_STATS_TO_MBPS(win.avg.tx_bytes),
+ *             TRAFFIC_STATS_TO_MBPS(win.p95.tx_bytes), win.window_ms);
+ * @endcode
+ */
+int netdevice_stats_window(const char *ifname, unsigned int window_ms,
+                           struct traffic_window_stats *out)
+{
+    struct netdev_monitor_entry *entry;
+    int ret = -ENODEV;
 
-            raw_delta = calc_delta_with_overflow(entry->current_stats.rx_packets, entry->prev_stats.rx_packets);
-            delta.rx_packets += calc_per_sec_rate(raw_delta, time_delta_jiffies);
+    if (!ifname || !out)
+        return -EINVAL;
 
-            raw_delta = calc_delta_with_overflow(entry->current_stats.rx_bytes, entry->prev_stats.rx_bytes);
-            delta.rx_bytes += calc_per_sec_rate(raw_delta, time_delta_jiffies);
+    rcu_read_lock();
+    hlist_for_each_entry_rcu(entry, netdev_name_bucket(ifname), hash_node) {
+        if (strcmp(entry->ifname, ifname) == 0) {
+            ret = history_window(entry, msecs_to_jiffies(window_ms), out);
+            break;
         }
     }
+    rcu_read_unlock();
 
-    read_unlock_irqrestore(&netdev_monitor_rwlock, flags);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(netdevice_stats_window);
 
-    return delta;
+/**
+ * netdevice_stats_window_ifindex - Get smoothed traffic statistics by ifindex
+ * @ifindex: Interface index of a monitored device (dev->ifindex)
+ * @window_ms: Length of the window in milliseconds
+ * @out: Filled with the statistics of the window
+ *
+ * Same as netdevice_stats_window(), looking the device up by ifindex.
+ *
+ * Context: Any context, including hard and soft interrupts.
+ * Return: 0 on success, -EINVAL for invalid arguments, -ENODEV if the
+ *         device is not monitored, -EAGAIN if it has fewer than two samples
+ */
+int netdevice_stats_window_ifindex(int ifindex, unsigned int window_ms,
+                                   struct traffic_window_stats *out)
+{
+    struct netdev_monitor_entry *entry;
+    int ret = -ENODEV;
+
+    if (!out)
+        return -EINVAL;
+
+    rcu_read_lock();
+    entry = find_monitor_entry(ifindex);
+    if (entry)
+        ret = history_window(entry, msecs_to_jiffies(window_ms), out);
+    rcu_read_unlock();
+
+    return ret;
 }
+EXPORT_SYMBOL_GPL(netdevice_stats_window_ifindex);
+
+/**
+ * read_queue_rates - Copy the per-queue rates of one device
+ * @entry: Monitor entry, found under RCU
+ * @dir: Receive or transmit queues
+ * @rates: Filled with the rates of the first @n queues
+ * @n: Capacity of @rates
+ *
+ * Context: Any context, inside an RCU read-side critical section. Lock-free.
+ * Return: Number of queues in @dir, -EOPNOTSUPP if the driver reports no
+ *         such queue statistics, -EAGAIN if they have fewer than two samples
+ */
+static int read_queue_rates(struct netdev_monitor_entry *entry, enum traffic_queue_dir dir,
+                            struct traffic_queue_rates *rates, unsigned int n)
+{
+    struct netdev_queue_block *blk = rcu_dereference(entry->queues);
+    unsigned int i, first, num, seq;
+    bool valid;
+
+    if (!blk)
+        return entry->dev->stat_ops ? -EAGAIN : -EOPNOTSUPP;
+
+    first = dir == TRAFFIC_QUEUE_RX ? 0 : blk->num_rx;
+    num = dir == TRAFFIC_QUEUE_RX ? blk->num_rx : blk->num_tx;
+    if (!num)
+        return -EOPNOTSUPP;
+
+    do {
+        seq = read_seqcount_begin(&blk->seq);
+        valid = blk->rates_valid;
+        for (i = 0; i < min(n, num); i++)
+            rates[i] = blk->q[first + i].rates;
+    } while (read_seqcount_retry(&blk->seq, seq));
+
+    return valid ? num : -EAGAIN;
+}
+
+/**
+ * netdevice_queue_stats - Get per-queue packet and byte rates of one device
+ * @ifname: Network interface name of a monitored device
+ * @dir: TRAFFIC_QUEUE_RX for the receive queues, TRAFFIC_QUEUE_TX for transmit
+ * @rates: Array filled with the per-second rates of queue 0, 1, ...
+ * @n: Number of entries in @rates
+ *
+ * The per-queue counters come from the driver's queue statistics
+ * (netdev_stat_ops, as reported by the netdev netlink family) and are
+ * sampled by the same work, at the same adaptive interval, as the device
+ * counters. Comparing the queues of one device shows RSS or XPS
+ * hot-spotting without an extra sampling loop.
+ *
+ * If the device has more than @n queues, only the first @n are copied;
+ * the return value still reports the real count so callers can retry with
+ * a larger array. All copied rates come from the same queue sample.
+ *
+ * Context: Any context, including hard and soft interrupts.
+ * Locking: Lock-free, no allocation.
+ * Return: Number of queues in @dir, or -EINVAL for invalid arguments,
+ *         -ENODEV if the device is not monitored, -EOPNOTSUPP if its driver
+ *         has no per-queue statistics, -EAGAIN if fewer than two queue
+ *         samples were taken yet
+ *
+ * Example:
+ * @code
+ * struct traffic_queue_rates q[64];
+ * int i, n = netdevice_queue_stats("eth0", TRAFFIC_QUEUE_RX, q, ARRAY_SIZE(q));
+ *
+ * for (i = 0; i < min_t(int, n, ARRAY_SIZE(q)); i++)
+ *     pr_info("eth0 rx%d: %llu pps\n", i, q[i].packets);
+ * @endcode
+ */
+int netdevice_queue_stats(const char *ifname, enum traffic_queue_dir dir,
+                          struct traffic_queue_rates *rates, unsigned int n)
+{
+    struct netdev_monitor_entry *entry;
+    int ret = -ENODEV;
+
+    if (!ifname || (n && !rates))
+        return -EINVAL;
+
+    rcu_read_lock();
+    hlist_for_each_entry_rcu(entry, netdev_name_bucket(ifname), hash_node) {
+        if (strcmp(entry->ifname, ifname) == 0) {
+            ret = read_queue_rates(entry, dir, rates, n);
+            break;
+        }
+    }
+    rcu_read_unlock();
+
+    return ret;
+}
+EXPORT_SYMBOL_GPL(netdevice_queue_stats);
+
+/**
+ * netdevice_queue_stats_ifindex - Get per-queue rates of one device by ifindex
+ * @ifindex: Interface index of a monitored device (dev->ifindex)
+ * @dir: TRAFFIC_QUEUE_RX for the receive queues, TRAFFIC_QUEUE_TX for transmit
+ * @rates: Array filled with the per-second rates of queue 0, 1, ...
+ * @n: Number of entries in @rates
+ *
+ * Same as netdevice_queue_stats(), looking the device up by ifindex.
+ *
+ * Context: Any context, including hard and soft interrupts.
+ * Return: See netdevice_queue_stats()
+ */
+int netdevice_queue_stats_ifindex(int ifindex, enum traffic_queue_dir dir,
+                                  struct traffic_queue_rates *rates, unsigned int n)
+{
+    struct netdev_monitor_entry *entry;
+    int ret = -ENODEV;
+
+    if (n && !rates)
+        return -EINVAL;
+
+    rcu_read_lock();
+    entry = find_monitor_entry(ifindex);
+    if (entry)
+        ret = read_queue_rates(entry, dir, rates, n);
+    rcu_read_unlock();
+
+    return ret;
+}
+EXPORT_SYMBOL_GPL(netdevice_queue_stats_ifindex);
+
+/**
+ * traffic_subscribe - Get notified when a device rate crosses a threshold band
+ * @init: Device, metric, band and delivery of the subscription
+ *
+ * Replaces a watch item whose state_func polls netdevice_stats_delta() on a
+ * timer of its own: the band is checked by the traffic sampler right after
+ * it computed the rates, once per sample of the device (once per pass for
+ * the aggregate), so transitions cost no extra polling and arrive with the
+ * sample that caused them.
+ *
+ * A subscription starts below the band. It goes above when the rate reaches
+ * init->enter and back below when it falls under init->exit; each
+ * transition calls init->func and/or pushes 1 or 0 to init->item with
+ * state_watcher_notify(). The subscription is bound to the device name and
+ * survives the device going down and coming back.
+ *
+ * init->func runs from the sampler work under rcu_read_lock() and must not
+ * sleep. A state init->item does not accept, e.g. because its watcher is
+ * stopped, is pushed again with the following samples until it is.
+ *
+ * Context: Process context. Takes traffic_subscriptions_mutex.
+ * Return: New subscription, or NULL if @init is invalid or on allocation
+ *         failure
+ *
+ * Example:
+ * @code
+ * // eth0 above 5 Gbps, cleared below 4 Gbps, into a push-only watch item
+ * struct traffic_subscription_init init = {
+ *     .ifname = "eth0",
+ *     .metric = TRAFFIC_METRIC_TX_BYTES,
+ *     .enter = 5000000000ULL / 8,
+ *     .exit = 4000000000ULL / 8,
+ *     .item = busy_item,
+ * };
+ * struct traffic_subscription *sub = traffic_subscribe(&init);
+ * @endcode
+ */
+struct traffic_subscription *traffic_subscribe(const struct traffic_subscription_init *init)
+{
+    struct traffic_subscription *sub;
+
+    if (!init || (!init->func && !init->item))
+        return NULL;
+    if (init->metric > TRAFFIC_METRIC_RX_BYTES || !init->exit || init->exit > init->enter)
+        return NULL;
+    if (init->ifname && strlen(init->ifname) >= IFNAMSIZ)
+        return NULL;
+
+    sub = kzalloc(sizeof(*sub), GFP_KERNEL);
+    if (!sub)
+        return NULL;
+
+    sub->metric = init->metric;
+    sub->enter = init->enter;
+    sub->exit = init->exit;
+    sub->func = init->func;
+    sub->item = init->item;
+    sub->private_data = init->private_data;
+    if (init->ifname)
+        strscpy(sub->ifname, init->ifname, sizeof(sub->ifname));
+
+    mutex_lock(&traffic_subscriptions_mutex);
+    list_add_tail_rcu(&sub->list, &traffic_subscriptions);
+    mutex_unlock(&traffic_subscriptions_mutex);
+
+    return sub;
+}
+EXPORT_SYMBOL_GPL(traffic_subscribe);
+
+/**
+ * traffic_unsubscribe - Remove a threshold subscription
+ * @sub: Subscription from traffic_subscribe(), may be NULL
+ *
+ * Waits for a running evaluation, so neither the callback nor the watch
+ * item is used once this returns. Subscriptions must be removed before
+ * cleanup_traffic_monitor().
+ *
+ * Context: Process context. May sleep.
+ */
+void traffic_unsubscribe(struct traffic_subscription *sub)
+{
+    if (!sub)
+        return;
+
+    mutex_lock(&traffic_subscriptions_mutex);
+    list_del_rcu(&sub->list);
+    mutex_unlock(&traffic_subscriptions_mutex);
+
+    synchronize_rcu();
+    kfree(sub);
+}
+EXPORT_SYMBOL_GPL(traffic_unsubscribe);
 
 /**
  * traffic_netdev_event - Network device event handler for monitoring management
@@ -646,13 +2019,21 @@ struct simple_net_device_stats netdevice_stats_delta(const char* ifname)
  *
  * Handles network device lifecycle events to automatically manage the
  * monitoring of target devices. The handler monitors device state changes
- * and ensures that only devices listed in target_devices are tracked,
+ * and ensures that only devices selected by is_target_device() are tracked,
  * providing automatic registration and cleanup without manual intervention.
  *
- * The function handles three critical events:
+ * The function handles these critical events:
  * - NETDEV_UP: Device becomes available, starts monitoring if it's a target
  * - NETDEV_GOING_DOWN: Normal shutdown, removes device from monitoring
  * - NETDEV_UNREGISTER: Emergency cleanup for abnormal device removal scenarios
+ * - NETDEV_CHANGENAME: The device is re-registered under its new name, if
+ *   the new name is still selected
+ *
+ * Only devices of init_net are added, see is_target_netdev(). Removal
+ * events are handled for every monitored device, even one that no longer
+ * matches after the "devices" parameter changed or that is moving to
+ * another namespace, so no device reference can be leaked. They match the
+ * device itself, never just its ifindex.
  *
  * The dual cleanup approach (GOING_DOWN + UNREGISTER) ensures robust device
  * reference management even when devices are removed unexpectedly, such as
@@ -671,20 +2052,25 @@ static int traffic_netdev_event(struct notifier_block *nb, unsigned long event,
     if (atomic_read(&monitor_stop_flag))
         return NOTIFY_DONE;
 
-    // Only handle events for target devices
-    if (!is_target_device(dev->name))
-        return NOTIFY_DONE;
-
     switch (event) {
     case NETDEV_UP:
+        // Only add target devices
+        if (!is_target_netdev(dev))
+            break;
         printk(KERN_INFO "traffic_monitor: Target device %s is UP - adding to monitoring\n", dev->name);
-        register_monitor_netdevice(dev->name);
-        start_monitoring();
+        if (!register_monitor_netdevice(dev))
+            start_monitoring();
         break;
 
     case NETDEV_GOING_DOWN:
-        printk(KERN_INFO "traffic_monitor: Target device %s is going DOWN - removing from monitoring\n", dev->name);
-        unregister_monitor_netdevice(dev->name);
+        unregister_monitor_netdevice(dev);
+        break;
+
+    case NETDEV_CHANGENAME:
+        unregister_monitor_netdevice(dev);
+        if (netif_running(dev) && is_target_netdev(dev) &&
+            !register_monitor_netdevice(dev))
+            start_monitoring();
         break;
 
     case NETDEV_UNREGISTER:
@@ -694,8 +2080,7 @@ static int traffic_netdev_event(struct notifier_block *nb, unsigned long event,
          * driver errors, virtual device deletion). Safe to call even if
          * device was already unregistered in NETDEV_GOING_DOWN.
          */
-        printk(KERN_INFO "traffic_monitor: Target device %s unregistered (backup cleanup)\n", dev->name);
-        unregister_monitor_netdevice(dev->name);  // Safe for duplicate calls
+        unregister_monitor_netdevice(dev);  // Safe for duplicate calls
         break;
 
     default:
@@ -728,43 +2113,330 @@ static struct notifier_block traffic_netdev_notifier = {
  * traffic_monitor_cleanup - Clean up all monitored devices and resources
  *
  * Performs complete cleanup of the traffic monitoring subsystem by removing
- * all devices from the monitoring hash table and releasing associated resources.
- * The function safely iterates through all hash table entries, removes them
- * from the table, releases the network device references that were acquired
- * during registration, and frees the allocated memory for monitoring entries.
- *
- * The cleanup process uses hash_for_each_safe() to allow safe removal of
- * entries during iteration. After cleanup, the active monitor count is
+ * all devices from the monitoring tables and releasing associated resources.
+ * The function safely iterates through all entries and removes them from
+ * the tables. The network device references that were acquired during
+ * registration and the entries themselves are released after a grace period;
+ * rcu_barrier() waits for that before the module can go away.
+ *
+ * The cleanup process uses list_for_each_entry_safe() to allow safe removal
+ * of entries during iteration. After cleanup, the active monitor count is
  * reset to zero to reflect the empty state of the monitoring system.
  *
  * This function is typically called during module unloading to ensure
  * proper resource cleanup and prevent memory leaks or dangling device
  * references.
  *
- * Context: Process context. Uses write lock with IRQ disable to ensure
- *          exclusive access during the cleanup process and prevent
- *          concurrent modifications.
+ * Context: Process context. Takes netdev_monitor_lock and may sleep in
+ *          rcu_barrier().
  */
 static void traffic_monitor_cleanup(void)
 {
-    struct netdev_monitor_entry *entry;
-    struct hlist_node *tmp;
-    unsigned long flags;
-    int bkt;
+    struct netdev_monitor_entry *entry, *tmp;
     
-    write_lock_irqsave(&netdev_monitor_rwlock, flags);
+    spin_lock(&netdev_monitor_lock);
     
-    hash_for_each_safe(netdev_monitor_hash, bkt, tmp, entry, hash_node) {
-        hash_del(&entry->hash_node);
-        dev_put(entry->dev);
-        kfree(entry);
+    list_for_each_entry_safe(entry, tmp, &netdev_monitor_list, list) {
+        remove_monitor_entry(entry);
     }
     
-    write_unlock_irqrestore(&netdev_monitor_rwlock, flags);
+    spin_unlock(&netdev_monitor_lock);
+
+    // Wait for the release of all entries, including earlier unregistrations
+    rcu_barrier();
     
     atomic_set(&active_monitors, 0);
 }
 
+/**
+ * traffic_monitor_rescan - Apply a changed device selection to existing devices
+ *
+ * Registers running devices that are now selected and unregisters
+ * monitored devices that no longer are. Only init_net is walked, the
+ * notifier does not monitor devices of other namespaces either. Devices
+ * that come up later are handled by traffic_netdev_event() as usual.
+ *
+ * Context: Process context. Takes rtnl_lock().
+ */
+static void traffic_monitor_rescan(void)
+{
+    struct net_device *dev;
+    bool want, have;
+
+    rtnl_lock();
+
+    if (monitor_ready && !atomic_read(&monitor_stop_flag)) {
+        for_each_netdev(&init_net, dev) {
+            want = netif_running(dev) && is_target_netdev(dev);
+            rcu_read_lock();
+            have = find_monitor_dev(dev) != NULL;
+            rcu_read_unlock();
+
+            if (want && !have && !register_monitor_netdevice(dev))
+                start_monitoring();
+            else if (!want && have)
+                unregister_monitor_netdevice(dev);
+        }
+    }
+
+    rtnl_unlock();
+}
+
+/**
+ * target_patterns_update - Publish the patterns of a "devices" string
+ * @val: Comma or whitespace separated glob patterns, may be empty
+ *
+ * An empty list restores the compiled-in target_devices[].
+ *
+ * Context: Process context
+ * Return: 0 on success, -ENOMEM on allocation failure
+ */
+static int target_patterns_update(const char *val)
+{
+    struct target_patterns *tp = NULL, *old;
+    unsigned int max = 1;
+    char *buf, *cur, *tok;
+    const char *c;
+
+    for (c = val; *c; c++)
+        max += (*c == ',' || *c == ' ' || *c == '\n');
+
+    buf = kstrdup(val, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    tp = kzalloc(struct_size(tp, pat, max), GFP_KERNEL);
+    if (!tp) {
+        kfree(buf);
+        return -ENOMEM;
+    }
+    tp->buf = buf;
+
+    cur = buf;
+    while ((tok = strsep(&cur, ", \n"))) {
+        if (*tok)
+            tp->pat[tp->count++] = tok;
+    }
+
+    if (!tp->count) {
+        kfree(buf);
+        kfree(tp);
+        tp = NULL;
+    }
+
+    mutex_lock(&target_patterns_mutex);
+    old = rcu_dereference_protected(target_patterns, lockdep_is_held(&target_patterns_mutex));
+    rcu_assign_pointer(target_patterns, tp);
+    mutex_unlock(&target_patterns_mutex);
+
+    if (old)
+        call_rcu(&old->rcu, target_patterns_free);
+
+    return 0;
+}
+
+/**
+ * devices_param_set - Set handler of the "devices" parameter
+ * @val: New value
+ * @kp: Parameter
+ *
+ * Context: Process context (module load or sysfs write)
+ * Return: 0 on success, negative error code otherwise
+ */
+static int devices_param_set(const char *val, const struct kernel_param *kp)
+{
+    int ret;
+
+    ret = target_patterns_update(val);
+    if (ret)
+        return ret;
+
+    ret = param_set_charp(val, kp);
+    if (ret)
+        return ret;
+
+    traffic_monitor_rescan();
+    return 0;
+}
+
+/**
+ * devices_param_free - Release the "devices" parameter on module unload
+ * @arg: Parameter storage
+ *
+ * Context: Module unload, no readers are left
+ */
+static void devices_param_free(void *arg)
+{
+    struct target_patterns *tp = rcu_dereference_protected(target_patterns, 1);
+
+    if (tp) {
+        kfree(tp->buf);
+        kfree(tp);
+    }
+    param_free_charp(arg);
+}
+
+static const struct kernel_param_ops devices_param_ops = {
+    .set = devices_param_set,
+    .get = param_get_charp,
+    .free = devices_param_free,
+};
+
+/**
+ * devices - Glob patterns of the interfaces to monitor
+ *
+ * Comma separated list, e.g. "eth*,ens1f0v*". Devices matching any pattern
+ * are monitored while they are up. Writable at runtime through
+ * /sys/module/<module>/parameters/devices; running devices are then
+ * re-evaluated immediately. Empty selects target_devices[].
+ */
+static char *devices;
+module_param_cb(devices, &devices_param_ops, &devices, 0644);
+MODULE_PARM_DESC(devices, "Comma separated glob patterns of interfaces to monitor (default: built-in list)");
+
+/**
+ * sampler_stats_show_hist - Print the non-empty buckets of a histogram
+ * @m: seq_file of the "stats" file
+ * @name: Histogram name
+ * @hist: TRAFFIC_STATS_HIST_BUCKETS counters
+ *
+ * Context: Process context
+ */
+static void sampler_stats_show_hist(struct seq_file *m, const char *name, const u64 *hist)
+{
+    int i;
+
+    seq_printf(m, "%s:\n", name);
+    for (i = 0; i < TRAFFIC_STATS_HIST_BUCKETS; i++) {
+        if (READ_ONCE(hist[i]))
+            seq_printf(m, "  >=%llu: %llu\n", i ? 1ULL << i : 0ULL, READ_ONCE(hist[i]));
+    }
+}
+
+/**
+ * sampler_stats_show - Show <debugfs>/traffic_monitor/stats
+ * @m: seq_file
+ * @v: Unused
+ *
+ * Prints the sampler counters without stopping the sampler, e.g.:
+ *
+ *   passes: 3150
+ *   devices_sampled: 4020
+ *   max_devices_per_pass: 4
+ *   monitored_devices: 4
+ *   pass_ns:
+ *     >=4096: 2980
+ *     >=8192: 170
+ *   lateness_us:
+ *     >=0: 3100
+ *     >=2048: 50
+ *
+ * Context: Process context
+ * Return: 0
+ */
+static int sampler_stats_show(struct seq_file *m, void *v)
+{
+    seq_printf(m, "passes: %llu\n", READ_ONCE(sampler_stats.passes));
+    seq_printf(m, "devices_sampled: %llu\n", READ_ONCE(sampler_stats.devices_sampled));
+    seq_printf(m, "max_devices_per_pass: %llu\n", READ_ONCE(sampler_stats.max_devices_per_pass));
+    seq_printf(m, "monitored_devices: %d\n", atomic_read(&active_monitors));
+    sampler_stats_show_hist(m, "pass_ns", sampler_stats.pass_ns);
+    sampler_stats_show_hist(m, "lateness_us", sampler_stats.lateness_us);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sampler_stats);
+
+/**
+ * traffic_ring_mmap - Map the shared sample ring into userspace
+ * @file: Open /dev/traffic_monitor
+ * @vma: Requested mapping, read-only, offset 0 or a page offset into the ring
+ *
+ * Context: Process context
+ * Return: 0 on success, -EPERM for writable mappings, -EINVAL if the
+ *         mapping exceeds the ring
+ */
+static int traffic_ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+    vm_flags_clear(vma, VM_MAYWRITE);
+
+    return remap_vmalloc_range(vma, traffic_ring, vma->vm_pgoff);
+}
+
+static const struct file_operations traffic_ring_fops = {
+    .owner = THIS_MODULE,
+    .mmap = traffic_ring_mmap,
+    .llseek = noop_llseek,
+};
+
+static struct miscdevice traffic_ring_miscdev = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = "traffic_monitor",
+    .fops = &traffic_ring_fops,
+    .mode = 0444,
+};
+
+/**
+ * traffic_ring_init - Allocate the shared sample ring and register its device
+ *
+ * Best effort like the statistics files of the other libraries: without
+ * the ring, samples are simply not exported.
+ *
+ * Context: Process context, before the sampler can run
+ */
+static void traffic_ring_init(void)
+{
+    unsigned int nr;
+    int ret;
+
+    if (!ring_records)
+        return;
+
+    nr = roundup_pow_of_two(clamp_t(unsigned int, ring_records, TRAFFIC_RING_MIN_RECORDS,
+                                    TRAFFIC_RING_MAX_RECORDS));
+    traffic_ring_size = PAGE_SIZE + PAGE_ALIGN((unsigned long)nr * sizeof(struct traffic_ring_record));
+    traffic_ring = vmalloc_user(traffic_ring_size);
+    if (!traffic_ring) {
+        printk(KERN_WARNING "traffic_monitor: No memory for a %u record sample ring\n", nr);
+        return;
+    }
+
+    traffic_ring_hdr = traffic_ring;
+    traffic_ring_hdr->magic = TRAFFIC_RING_MAGIC;
+    traffic_ring_hdr->version = TRAFFIC_RING_VERSION;
+    traffic_ring_hdr->record_size = sizeof(struct traffic_ring_record);
+    traffic_ring_hdr->nr_records = nr;
+    traffic_ring_hdr->data_offset = PAGE_SIZE;
+    traffic_ring_data = traffic_ring + PAGE_SIZE;
+
+    ret = misc_register(&traffic_ring_miscdev);
+    if (ret) {
+        printk(KERN_WARNING "traffic_monitor: Failed to register /dev/%s: %d\n",
+               traffic_ring_miscdev.name, ret);
+        return;
+    }
+    traffic_ring_registered = true;
+}
+
+/**
+ * traffic_ring_cleanup - Unregister the sample ring device and free the ring
+ *
+ * Context: Process context, after the sampler stopped. No file can be open,
+ *          each one pins the module.
+ */
+static void traffic_ring_cleanup(void)
+{
+    if (traffic_ring_registered)
+        misc_deregister(&traffic_ring_miscdev);
+    traffic_ring_registered = false;
+
+    vfree(traffic_ring);
+    traffic_ring = NULL;
+    traffic_ring_hdr = NULL;
+    traffic_ring_data = NULL;
+}
+
 /**
  * init_traffic_monitor - Initialize the traffic monitoring subsystem
  *
@@ -774,7 +2446,7 @@ static void traffic_monitor_cleanup(void)
  * monitor functions.
  *
  * The function will:
- * - Initialize target device hash table with predefined device names
+ * - Allocate the name and ifindex lookup tables (2^hash_bits buckets each)
  * - Register netdevice notifier for automatic device registration
  * - Set up delayed work for periodic statistics updates
  * - Initialize all necessary locks and data structures
@@ -804,26 +2476,69 @@ int init_traffic_monitor(void)
 {
     int ret;
     
-    // Initialize hash tables
-    hash_init(netdev_monitor_hash);
+    // Allocate lookup tables
+    netdev_hash_bits = clamp_t(unsigned int, hash_bits, NETDEV_HASH_BITS_MIN, NETDEV_HASH_BITS_MAX);
+    netdev_name_table = kvcalloc(1U << netdev_hash_bits, sizeof(*netdev_name_table), GFP_KERNEL);
+    netdev_ifindex_table = kvcalloc(1U << netdev_hash_bits, sizeof(*netdev_ifindex_table),
+                                    GFP_KERNEL);
+    if (!netdev_name_table || !netdev_ifindex_table) {
+        ret = -ENOMEM;
+        goto err_free_tables;
+    }
+    memset(&netdev_monitor_total_rates, 0, sizeof(netdev_monitor_total_rates));
+
+    // Sampling intervals, idle devices back off to max_interval_ms
+    monitor_min_interval = msecs_to_jiffies(MONITOR_INTERVAL_MS);
+    monitor_max_interval = max(rounddown(msecs_to_jiffies(max_interval_ms), monitor_min_interval),
+                               monitor_min_interval);
     
     // Reset stop flag to ensure monitoring can start
     // (important for module reload scenarios)
     atomic_set(&monitor_stop_flag, 0);
 
-    // Initialize delayed work
-    INIT_DELAYED_WORK(&monitor_work, monitor_work_handler);
+    // Initialize delayed work, deferrable when wakeups are coalesced
+    if (coalesce_wakeups) {
+        INIT_DEFERRABLE_WORK(&monitor_work, monitor_work_handler);
+    } else {
+        INIT_DELAYED_WORK(&monitor_work, monitor_work_handler);
+    }
     
+    memset(&sampler_stats, 0, sizeof(sampler_stats));
+
+    // Shared sample ring for userspace, before the first sample
+    traffic_ring_init();
+
+    // debugfs is best effort, failures are not fatal
+    traffic_debugfs_dir = debugfs_create_dir("traffic_monitor", NULL);
+    debugfs_create_file("stats", 0444, traffic_debugfs_dir, NULL, &sampler_stats_fops);
+
     // Register netdevice notifier
     ret = register_netdevice_notifier(&traffic_netdev_notifier);
     if (ret) {
         printk(KERN_ERR "traffic_monitor: Failed to register netdevice notifier: %d\n", ret);
-        return ret;
+        goto err_free_ring;
     }
+
+    // Changes of the "devices" parameter apply to running devices from now on
+    rtnl_lock();
+    monitor_ready = true;
+    rtnl_unlock();
     
     printk(KERN_INFO "traffic_monitor: Traffic monitoring module initialized\n");
     return 0;
+
+err_free_ring:
+    debugfs_remove_recursive(traffic_debugfs_dir);
+    traffic_debugfs_dir = NULL;
+    traffic_ring_cleanup();
+err_free_tables:
+    kvfree(netdev_ifindex_table);
+    kvfree(netdev_name_table);
+    netdev_ifindex_table = NULL;
+    netdev_name_table = NULL;
+    return ret;
 }
+EXPORT_SYMBOL_GPL(init_traffic_monitor);
 
 /**
  * cleanup_traffic_monitor - Clean up the traffic monitoring subsystem
@@ -837,7 +2552,8 @@ int init_traffic_monitor(void)
  * - Unregister netdevice notifier to stop receiving events
  * - Cancel and flush any pending delayed work
  * - Release all monitored device references
- * - Free all allocated memory and hash table entries
+ * - Free all allocated memory and hash table entries, and the shared
+ *   sample ring with its /dev/traffic_monitor device
  * - Reset all counters and state
  *
  * Context: Process context during module cleanup.
@@ -862,6 +2578,10 @@ void cleanup_traffic_monitor(void)
     // Ensure memory barrier - stop flag is visible before other operations
     smp_mb();
 
+    rtnl_lock();
+    monitor_ready = false;
+    rtnl_unlock();
+
     // Unregister netdevice notifier
     unregister_netdevice_notifier(&traffic_netdev_notifier);
     
@@ -870,6 +2590,16 @@ void cleanup_traffic_monitor(void)
     
     // Clean up all monitored devices
     traffic_monitor_cleanup();
+
+    debugfs_remove_recursive(traffic_debugfs_dir);
+    traffic_debugfs_dir = NULL;
+    traffic_ring_cleanup();
+
+    kvfree(netdev_ifindex_table);
+    kvfree(netdev_name_table);
+    netdev_ifindex_table = NULL;
+    netdev_name_table = NULL;
     
     printk(KERN_INFO "traffic_monitor: Traffic monitoring module cleaned up\n");
 }
+EXPORT_SYMBOL_GPL(cleanup_traffic_monitor);
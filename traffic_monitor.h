@@ -3,6 +3,8 @@
 
 #include <linux/types.h>
 
+#include "traffic_monitor_ring.h"
+
 /**
  * DOC: Traffic Monitor Module Overview
  *
@@ -12,14 +14,21 @@
  * statistics into meaningful per-second rates with overflow protection.
  *
  * Key features:
- * - Automatic target device detection and registration
+ * - Automatic target device detection and registration, selected by glob
+ *   patterns in the "devices" module parameter
  * - Periodic statistics collection with configurable intervals
  * - Overflow-safe delta calculations for counters and timestamps
  * - Per-device and aggregate traffic rate reporting
+ * - Per-device sample history with windowed average, peak, p95 and EWMA
+ * - Per-queue (RX/TX ring) rates for drivers with queue statistics
+ * - Threshold subscriptions evaluated by the sampler, delivered to a
+ *   callback or a state watcher push item
+ * - Shared-memory ring of all samples for userspace (/dev/traffic_monitor)
  * - Event-driven device lifecycle management
- * - Thread-safe hash table operations with read-write locks
+ * - Lock-free statistics readers (RCU table walk, per-device seqcount)
  * - Clean resource management and module cleanup
- * - Support for both individual device and system-wide queries
+ * - Support for both individual device and system-wide queries, devices
+ *   looked up by name or by ifindex
  *
  * The module automatically monitors predefined network interfaces,
  * collecting statistics at regular intervals and providing APIs to
@@ -89,21 +98,137 @@
  * 
  * This structure contains essential traffic statistics in per-second rates.
  * All values represent the rate of change between the last two measurements.
+ * The rates are 64-bit on all platforms and derived from the device's
+ * 64-bit counters (dev_get_stats()), so they stay correct on high-rate
+ * links where 32-bit counters would wrap between two samples.
  * 
  * Example:
  * @code
- * struct simple_net_device_stats stats = netdevice_stats_delta_single("eth0");
- * printk("eth0: %lu pps TX, %lu bps TX, %lu pps RX, %lu bps RX\n",
+ * struct simple_net_device_stats stats = netdevice_stats_delta("eth0");
+ * printk("eth0: %llu pps TX, %llu bps TX, %llu pps RX, %llu bps RX\n",
  *        stats.tx_packets, stats.tx_bytes, stats.rx_packets, stats.rx_bytes);
  * @endcode
  */
 struct simple_net_device_stats {
-    unsigned long tx_packets;    /**< Transmitted packets per second */
-    unsigned long tx_bytes;      /**< Transmitted bytes per second */
-    unsigned long rx_packets;    /**< Received packets per second */
-    unsigned long rx_bytes;      /**< Received bytes per second */
+    u64 tx_packets;    /**< Transmitted packets per second */
+    u64 tx_bytes;      /**< Transmitted bytes per second */
+    u64 rx_packets;    /**< Received packets per second */
+    u64 rx_bytes;      /**< Received bytes per second */
 };
 
+/**
+ * TRAFFIC_HISTORY_LEN - Number of samples kept per monitored device
+ *
+ * Bounds the window of netdevice_stats_window(): a window spans at most
+ * TRAFFIC_HISTORY_LEN - 1 sampling intervals.
+ */
+#define TRAFFIC_HISTORY_LEN 32
+
+/**
+ * TRAFFIC_P95_RANK_MAX - Largest per-sample rates needed for the p95
+ */
+#define TRAFFIC_P95_RANK_MAX (TRAFFIC_HISTORY_LEN / 20 + 1)
+
+/**
+ * struct traffic_window_stats - Statistics of a device over a time window
+ * @avg: Mean rates over the window
+ * @peak: Highest per-sample rates in the window
+ * @p95: 95th percentile of the per-sample rates in the window
+ * @ewma: Exponentially weighted moving average of the per-sample rates
+ * @samples: Number of per-sample rates in the window
+ * @window_ms: Time actually covered by the window
+ *
+ * All rates are per second, see struct simple_net_device_stats. Filled by
+ * netdevice_stats_window() and netdevice_stats_window_ifindex().
+ */
+struct traffic_window_stats {
+    struct simple_net_device_stats avg;
+    struct simple_net_device_stats peak;
+    struct simple_net_device_stats p95;
+    struct simple_net_device_stats ewma;
+    unsigned int samples;
+    unsigned int window_ms;
+};
+
+
+/**
+ * enum traffic_queue_dir - Queue direction of netdevice_queue_stats()
+ * @TRAFFIC_QUEUE_RX: Receive queues (netdev_rx_queue)
+ * @TRAFFIC_QUEUE_TX: Transmit queues (netdev_queue)
+ */
+enum traffic_queue_dir {
+    TRAFFIC_QUEUE_RX,
+    TRAFFIC_QUEUE_TX,
+};
+
+/**
+ * struct traffic_queue_rates - Per-second rates of one device queue
+ * @packets: Packets per second through the queue
+ * @bytes: Bytes per second through the queue
+ *
+ * Counters a driver does not report per queue read as zero.
+ */
+struct traffic_queue_rates {
+    u64 packets;
+    u64 bytes;
+};
+
+/**
+ * enum traffic_metric - Rate a traffic subscription watches
+ * @TRAFFIC_METRIC_TX_PACKETS: Transmitted packets per second
+ * @TRAFFIC_METRIC_TX_BYTES: Transmitted bytes per second
+ * @TRAFFIC_METRIC_RX_PACKETS: Received packets per second
+ * @TRAFFIC_METRIC_RX_BYTES: Received bytes per second
+ */
+enum traffic_metric {
+    TRAFFIC_METRIC_TX_PACKETS,
+    TRAFFIC_METRIC_TX_BYTES,
+    TRAFFIC_METRIC_RX_PACKETS,
+    TRAFFIC_METRIC_RX_BYTES,
+};
+
+struct traffic_subscription;
+struct watch_item;
+
+/**
+ * typedef traffic_threshold_func_t - Called when a watched rate crosses its band
+ * @sub: Subscription whose state changed
+ * @above: New state, true once the rate reached the enter threshold, false
+ *         once it fell below the exit threshold
+ * @rate: Rate of the sample that caused the transition
+ * @private_data: From struct traffic_subscription_init
+ *
+ * Called from the traffic sampler inside an RCU read-side critical section;
+ * must not sleep.
+ */
+typedef void (*traffic_threshold_func_t)(struct traffic_subscription *sub, bool above, u64 rate,
+                                         void *private_data);
+
+/**
+ * struct traffic_subscription_init - Threshold band of traffic_subscribe()
+ * @ifname: Device to watch, NULL or "" for the aggregate of all devices
+ * @metric: enum traffic_metric to watch
+ * @enter: Rate at or above which the subscription goes above
+ * @exit: Rate below which it returns, 0 < @exit <= @enter
+ * @func: Called on every transition from the sampler work under
+ *        rcu_read_lock(), must not sleep; may be NULL
+ * @item: Push-capable watch item sent the state (1 above, 0 below) with
+ *        state_watcher_notify() on every transition, retried with later
+ *        samples while the push fails; may be NULL
+ * @private_data: Passed to @func
+ *
+ * At least one of @func and @item must be set. Several bands on the same
+ * rate are several subscriptions.
+ */
+struct traffic_subscription_init {
+    const char *ifname;
+    enum traffic_metric metric;
+    u64 enter;
+    u64 exit;
+    traffic_threshold_func_t func;
+    struct watch_item *item;
+    void *private_data;
+};
 
 /**
  * init_traffic_monitor() - Initialize network traffic monitoring
@@ -120,4 +245,43 @@ void cleanup_traffic_monitor(void);
  */
 struct simple_net_device_stats netdevice_stats_delta(const char* ifname);
 
+/**
+ * netdevice_stats_delta_ifindex() - Get network device statistics delta by ifindex
+ */
+struct simple_net_device_stats netdevice_stats_delta_ifindex(int ifindex);
+
+/**
+ * netdevice_stats_window() - Get windowed average, peak, p95 and EWMA rates
+ */
+int netdevice_stats_window(const char *ifname, unsigned int window_ms,
+                           struct traffic_window_stats *out);
+
+/**
+ * netdevice_stats_window_ifindex() - Get windowed rates by ifindex
+ */
+int netdevice_stats_window_ifindex(int ifindex, unsigned int window_ms,
+                                   struct traffic_window_stats *out);
+
+/**
+ * netdevice_queue_stats() - Get per-queue packet and byte rates
+ */
+int netdevice_queue_stats(const char *ifname, enum traffic_queue_dir dir,
+                          struct traffic_queue_rates *rates, unsigned int n);
+
+/**
+ * netdevice_queue_stats_ifindex() - Get per-queue rates by ifindex
+ */
+int netdevice_queue_stats_ifindex(int ifindex, enum traffic_queue_dir dir,
+                                  struct traffic_queue_rates *rates, unsigned int n);
+
+/**
+ * traffic_subscribe() - Get notified when a device rate crosses a threshold band
+ */
+struct traffic_subscription *traffic_subscribe(const struct traffic_subscription_init *init);
+
+/**
+ * traffic_unsubscribe() - Remove a threshold subscription
+ */
+void traffic_unsubscribe(struct traffic_subscription *sub);
+
 #endif /* _TRAFFIC_MONITOR_H */
\ No newline at end of file
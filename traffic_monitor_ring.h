@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _TRAFFIC_MONITOR_RING_H
+#define _TRAFFIC_MONITOR_RING_H
+
+/*
+ * Layout of the /dev/traffic_monitor mapping, shared with userspace. Only
+ * depends on <linux/types.h> so that telemetry agents can include it as is.
+ */
+
+#include <linux/types.h>
+
+/**
+ * DOC: Shared sample ring
+ *
+ * Every sample the traffic sampler takes is also written as a fixed-layout
+ * struct traffic_ring_record into a ring that userspace maps read-only from
+ * /dev/traffic_monitor. A telemetry agent gets each sample of each device,
+ * with counters and rates, without syscalls or text parsing.
+ *
+ * The mapping starts with struct traffic_ring_header, the records follow at
+ * header.data_offset. header.head counts the records ever written; record
+ * n is in slot n & (nr_records - 1) and valid while its seq reads n before
+ * and after it is copied:
+ *
+ * @code
+ * uint64_t head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+ *
+ * for (; next < head; next++) {
+ *     const struct traffic_ring_record *r = &recs[next & (hdr->nr_records - 1)];
+ *     struct traffic_ring_record copy;
+ *
+ *     if (head - next > hdr->nr_records)
+ *         continue;                           // overwritten, lost
+ *     if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != next)
+ *         continue;
+ *     memcpy(&copy, r, sizeof(copy));
+ *     __atomic_thread_fence(__ATOMIC_ACQUIRE);
+ *     if (__atomic_load_n(&r->seq, __ATOMIC_RELAXED) == next)
+ *         consume(&copy);
+ * }
+ * @endcode
+ */
+
+#define TRAFFIC_RING_MAGIC 0x54524d52  /* "TRMR" */
+#define TRAFFIC_RING_VERSION 1
+
+/* The record is the first sample of its device, rates are zero */
+#define TRAFFIC_RECORD_F_FIRST 0x1
+
+/**
+ * struct traffic_ring_header - First page of the shared sample ring
+ * @magic: TRAFFIC_RING_MAGIC
+ * @version: TRAFFIC_RING_VERSION, bumped on incompatible layout changes
+ * @record_size: sizeof(struct traffic_ring_record)
+ * @nr_records: Number of record slots, a power of two
+ * @data_offset: Offset of slot 0 from the start of the mapping
+ * @reserved: Zero
+ * @head: Number of records written so far, stored with release semantics
+ *        after the record
+ */
+struct traffic_ring_header {
+    __u32 magic;
+    __u32 version;
+    __u32 record_size;
+    __u32 nr_records;
+    __u32 data_offset;
+    __u32 reserved;
+    __u64 head;
+};
+
+/**
+ * struct traffic_ring_record - One device sample in the shared ring
+ * @seq: Index of the record, all ones while the slot is being rewritten
+ * @timestamp_ns: CLOCK_MONOTONIC time of the sample
+ * @ifindex: Interface index of the device
+ * @flags: TRAFFIC_RECORD_F_* flags
+ * @ifname: Interface name, NUL-terminated
+ * @tx_packets: Raw 64-bit transmitted packets counter of the device
+ * @tx_bytes: Raw 64-bit transmitted bytes counter
+ * @rx_packets: Raw 64-bit received packets counter
+ * @rx_bytes: Raw 64-bit received bytes counter
+ * @tx_packets_rate: Transmitted packets per second since the previous
+ *                   sample of the device
+ * @tx_bytes_rate: Transmitted bytes per second
+ * @rx_packets_rate: Received packets per second
+ * @rx_bytes_rate: Received bytes per second
+ * @reserved: Zero, pads the record to two cache lines
+ */
+struct traffic_ring_record {
+    __u64 seq;
+    __u64 timestamp_ns;
+    __s32 ifindex;
+    __u32 flags;
+    char ifname[16];
+    __u64 tx_packets;
+    __u64 tx_bytes;
+    __u64 rx_packets;
+    __u64 rx_bytes;
+    __u64 tx_packets_rate;
+    __u64 tx_bytes_rate;
+    __u64 rx_packets_rate;
+    __u64 rx_bytes_rate;
+    __u64 reserved[3];
+};
+
+_Static_assert(sizeof(struct traffic_ring_header) == 32, "traffic_ring_header is 32 bytes");
+_Static_assert(sizeof(struct traffic_ring_record) == 128, "traffic_ring_record is 128 bytes");
+
+#endif /* _TRAFFIC_MONITOR_RING_H */
@@ -7,9 +7,12 @@
  * Key Features:
  * - Lock-free start/cancel operations for hot paths
  * - On-demand work scheduling (zero overhead when idle)
- * - Adaptive period adjustment based on shortest timeout
+ * - Deadline-ordered tree, work armed for the earliest expiry only
+ * - Adaptive recovery period based on shortest timeout
  * - Continuous recovery function calls after timeout
  * - Thread-safe add/remove operations
+ * - Optional per-CPU shards with independent lists, locks and work
+ * - Optional hrtimer engine for timeouts below WATCHDOG_MIN_TIMEOUT_MS
  * - Built-in safety limits to prevent system overload
  *
  * Design Philosophy:
@@ -23,82 +26,548 @@
  */
 
 #include <linux/bug.h>
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
 #include <linux/errno.h>
+#include <linux/export.h>
+#include <linux/hrtimer.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/limits.h>
+#include <linux/log2.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
 #include <linux/printk.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
 
-#include "kernel_watchdog.h"
-/* Global watchdog context - single instance per system */
+#include "watchdog.h"
+
+#define CREATE_TRACE_POINTS
+#include "watchdog_trace.h"
+
+/* Default watchdog instance behind watchdog_init()/watchdog_add() */
 static struct watchdog_context g_watchdog_ctx;
 
-/* Forward declarations */
-static void update_work_period(void);
+/* Slab cache for watchdog items and debugfs root, shared by all instances */
+static struct kmem_cache *watchdog_item_cache;
+static struct dentry *watchdog_debugfs_root;
+static unsigned int watchdog_global_users;
+static unsigned int watchdog_ctx_next_id;
+static DEFINE_MUTEX(watchdog_global_mutex);
+
+/**
+ * watchdog_shard_hires - Check whether a shard runs on the hrtimer engine
+ * @shard: Watchdog shard
+ *
+ * Return: true for shards of a WATCHDOG_F_HRTIMER context
+ */
+static inline bool watchdog_shard_hires(struct watchdog_shard *shard)
+{
+	return shard->ctx->flags & WATCHDOG_F_HRTIMER;
+}
+
+/**
+ * watchdog_now - Current time in the time base of a shard
+ * @shard: Watchdog shard
+ *
+ * Start times, deadlines and the deadline tree keys of a shard are kept in
+ * jiffies, or in microseconds (see watchdog_hr_now()) for the hrtimer engine.
+ *
+ * Return: Current time in the shard's time base
+ */
+static inline unsigned long watchdog_now(struct watchdog_shard *shard)
+{
+	return watchdog_shard_hires(shard) ? watchdog_hr_now() : jiffies;
+}
+
+/**
+ * watchdog_ms_to_ticks - Convert milliseconds to the time base of a shard
+ * @shard: Watchdog shard
+ * @ms: Duration in milliseconds
+ *
+ * Return: @ms in jiffies, or in microseconds for the hrtimer engine
+ */
+static inline unsigned long watchdog_ms_to_ticks(struct watchdog_shard *shard,
+						 unsigned long ms)
+{
+	return watchdog_shard_hires(shard) ? ms * USEC_PER_MSEC : msecs_to_jiffies(ms);
+}
+
+/**
+ * watchdog_work_delay - Delay until a deadline for the work engine
+ * @shard: Watchdog shard
+ * @deadline: Deadline in jiffies
+ *
+ * With WATCHDOG_F_COALESCE the wakeup is moved up to the next multiple of
+ * WATCHDOG_MAX_WORK_PERIOD_MS so it lines up with other coalesced tickers.
+ *
+ * Return: Delay in jiffies, 0 if @deadline already passed
+ */
+static unsigned long watchdog_work_delay(struct watchdog_shard *shard,
+					 unsigned long deadline)
+{
+	unsigned long now = jiffies;
+	unsigned long delay = time_after(deadline, now) ? deadline - now : 0;
+	unsigned long grid, rem;
+
+	if (!(shard->ctx->flags & WATCHDOG_F_COALESCE))
+		return delay;
+
+	grid = msecs_to_jiffies(WATCHDOG_MAX_WORK_PERIOD_MS);
+	rem = (now + delay) % grid;
+
+	return rem ? delay + grid - rem : delay;
+}
+
+/**
+ * watchdog_deadline_less - Deadline ordering for the watchdog deadline tree
+ * @a: Node being inserted
+ * @b: Node already in the tree
+ *
+ * Uses jiffies wrap-safe comparison so that ordering stays correct across
+ * a counter wrap, as long as all deadlines are within half the counter range
+ * of each other. The same holds for the microsecond keys of the hrtimer
+ * engine.
+ *
+ * Return: true if @a expires before @b
+ */
+static bool watchdog_deadline_less(struct rb_node *a, const struct rb_node *b)
+{
+	return time_before(rb_entry(a, struct watchdog_item, node)->deadline,
+			   rb_entry(b, struct watchdog_item, node)->deadline);
+}
+
+/**
+ * watchdog_queue_item - Insert an item into the deadline tree
+ * @shard: Watchdog shard owning the tree
+ * @item: Item to insert, must not currently be in the tree
+ * @deadline: Expiry time in the shard's time base used as the tree key
+ *
+ * Context: Must be called with @shard->lock held
+ */
+static void watchdog_queue_item(struct watchdog_shard *shard,
+				struct watchdog_item *item,
+				unsigned long deadline)
+{
+	item->deadline = deadline;
+	rb_add_cached(&item->node, &shard->deadline_tree, watchdog_deadline_less);
+}
+
+/**
+ * watchdog_dequeue_item - Remove an item from the deadline tree if present
+ * @shard: Watchdog shard owning the tree
+ * @item: Item to remove
+ *
+ * Context: Must be called with @shard->lock held
+ */
+static void watchdog_dequeue_item(struct watchdog_shard *shard,
+				  struct watchdog_item *item)
+{
+	if (!RB_EMPTY_NODE(&item->node)) {
+		rb_erase_cached(&item->node, &shard->deadline_tree);
+		RB_CLEAR_NODE(&item->node);
+	}
+}
+
+/**
+ * watchdog_item_deadline - Compute the real deadline of an active item
+ * @item: Item whose deadline is computed
+ *
+ * Pairs with the smp_wmb() in watchdog_start(): the caller has observed
+ * @item->active set, so @item->start_time is at least the value published
+ * with it. watchdog_kick() may move it forward at any time without a
+ * barrier; a kick that is missed here is seen on the next scan.
+ *
+ * Return: Expiry time in the time base of the item's shard
+ */
+static unsigned long watchdog_item_deadline(struct watchdog_item *item)
+{
+	smp_rmb(); /* Read active before start_time */
+	return READ_ONCE(item->start_time) +
+	       watchdog_ms_to_ticks(item->shard, item->timeout_ms);
+}
+
+/**
+ * watchdog_drain_arm_list - Move freshly started items into the deadline tree
+ * @shard: Watchdog shard to update
+ *
+ * Items pushed by watchdog_start() are inserted with the deadline derived
+ * from their start time. Items that were cancelled in the meantime are still
+ * inserted; they are dropped lazily when they reach the front of the tree.
+ *
+ * Context: Must be called with @shard->lock held
+ */
+static void watchdog_drain_arm_list(struct watchdog_shard *shard)
+{
+	struct llist_node *nodes = llist_del_all(&shard->arm_list);
+	struct watchdog_item *item, *tmp;
+
+	llist_for_each_entry_safe(item, tmp, nodes, arm_node) {
+		watchdog_queue_item(shard, item, watchdog_item_deadline(item));
+	}
+}
+
+/**
+ * watchdog_shard_cpu - CPU to queue a shard's work on
+ * @shard: Watchdog shard
+ *
+ * Per-CPU shards keep their work on their own CPU while it is online. When
+ * the CPU is offline the work is queued unbound so the shard's items keep
+ * being checked from another CPU.
+ *
+ * Return: CPU number or WORK_CPU_UNBOUND
+ */
+static int watchdog_shard_cpu(struct watchdog_shard *shard)
+{
+	if (shard->cpu != WORK_CPU_UNBOUND && cpu_online(shard->cpu))
+		return shard->cpu;
+
+	return WORK_CPU_UNBOUND;
+}
 
 /**
- * watchdog_work_func - Periodic work function that checks for timeouts
- * @work: Work structure (embedded in watchdog_context)
+ * watchdog_release_item - Give up tree ownership of an inactive item
+ * @item: Item that was just taken out of the tree
  *
- * This function runs periodically to check all active watchdog items for
- * timeouts. When a timeout is detected, it calls the associated recovery
- * function and continues to call it every period until the watchdog is
- * cancelled or removed.
+ * Clears @item->queued so that the next watchdog_start() hands the item back
+ * through the arm list. If a start raced with us and already activated the
+ * item, ownership is taken back so the item is not lost: either this function
+ * sees @active set after clearing @queued, or watchdog_start() sees @queued
+ * cleared after setting @active, and only one of the two wins the xchg.
+ *
+ * Context: Must be called with the owning shard lock held
+ * Return: true if the item was released, false if it must be requeued
+ */
+static bool watchdog_release_item(struct watchdog_item *item)
+{
+	atomic_set(&item->queued, 0);
+	smp_mb(); /* Clear queued before re-reading active */
+
+	if (!atomic_read(&item->active))
+		return true;
+
+	return atomic_xchg(&item->queued, 1) != 0;
+}
+
+/**
+ * watchdog_hist_bucket - Histogram bucket of a sample
+ * @val: Sample value
+ *
+ * Return: Bucket index, see WATCHDOG_STATS_HIST_BUCKETS
+ */
+static unsigned int watchdog_hist_bucket(u64 val)
+{
+	if (!val)
+		return 0;
+
+	return min_t(unsigned int, ilog2(val), WATCHDOG_STATS_HIST_BUCKETS - 1);
+}
+
+/**
+ * watchdog_stats_lock_hold - Account a scan lock hold period
+ * @shard: Watchdog shard whose lock is about to be released
+ * @lock_start: local_clock() when the lock was taken
+ *
+ * Context: Caller holds @shard->lock
+ */
+static void watchdog_stats_lock_hold(struct watchdog_shard *shard, u64 lock_start)
+{
+	u64_stats_update_begin(&shard->stats.syncp);
+	shard->stats.lock_hold_ns[watchdog_hist_bucket(local_clock() - lock_start)]++;
+	u64_stats_update_end(&shard->stats.syncp);
+}
+
+/**
+ * watchdog_run_recovery - Call a recovery function and account its run time
+ * @shard: Shard of the expired item
+ * @item: Expired item, only used as a trace cookie (may already be freed)
+ * @timeout_ms: Timeout of the item
+ * @recovery_func: Recovery function to call
+ * @private_data: Argument of @recovery_func
+ *
+ * Context: Workqueue context, without @shard->lock held
+ */
+static void watchdog_run_recovery(struct watchdog_shard *shard, const void *item,
+				  unsigned long timeout_ms,
+				  void (*recovery_func)(void *data), void *private_data)
+{
+	u64 start = local_clock();
+	u64 duration;
+
+	trace_kwatchdog_recovery_begin(item, timeout_ms);
+	recovery_func(private_data);
+	duration = local_clock() - start;
+	trace_kwatchdog_recovery_end(item, duration);
+
+	this_cpu_inc(shard->ctx->recovery_stats->recoveries);
+	this_cpu_inc(shard->ctx->recovery_stats->recovery_us[watchdog_hist_bucket(div_u64(duration,
+											    NSEC_PER_USEC))]);
+}
+
+/**
+ * watchdog_recovery_work_func - Run a recovery function off the scan path
+ * @work: Work structure (embedded in watchdog_item)
+ *
+ * Used by instances created with WATCHDOG_F_DEFERRED_RECOVERY. The scan
+ * only queues this work; clearing @recovery_pending once the recovery
+ * function returns allows the next period's expiry to queue it again.
+ * watchdog_remove() waits for this function before freeing the item.
+ *
+ * Context: Workqueue context (sleepable)
+ */
+static void watchdog_recovery_work_func(struct work_struct *work)
+{
+	struct watchdog_item *item = container_of(work, struct watchdog_item,
+						  recovery_work);
+
+	watchdog_run_recovery(item->shard, item, item->timeout_ms,
+			      item->recovery_func, item->private_data);
+
+	/* Order the recovery before allowing the next one to be queued */
+	atomic_set_release(&item->recovery_pending, 0);
+}
+
+/**
+ * watchdog_scan_shard - Handle the expired items of a shard
+ * @shard: Watchdog shard to scan
+ * @next_deadline: Set to the earliest remaining deadline if there is one
+ *
+ * Walks the deadline tree from the left and stops at the first item whose
+ * key is still in the future, so its cost is proportional to the number of
+ * expired items rather than to the number of watchdogs. For every item at
+ * the front:
+ * - Inactive items are dropped from the tree (see watchdog_release_item())
+ * - Items restarted or kicked since they were queued get their key refreshed
+ * - Expired items have their recovery function called and are requeued
+ *   @period_ms later, so recovery repeats until cancelled or removed
  *
  * The function temporarily releases the spinlock when calling recovery
  * functions to avoid holding locks during potentially long-running callbacks.
- * It uses list_for_each_entry_safe to handle potential list modifications
- * during recovery function execution.
+ * The item is requeued and the callback arguments are copied before the lock
+ * is dropped, so a concurrent watchdog_remove() can free the item safely.
+ * With WATCHDOG_F_DEFERRED_RECOVERY the lock is kept instead: every expired
+ * item only gets its recovery work queued on the instance's recovery
+ * workqueue, unless a recovery of that item is still in flight. The hrtimer
+ * engine always defers, so no recovery function ever runs in softirq context.
  *
- * Context: Workqueue context (sleepable)
+ * Every scan updates the shard's struct watchdog_stats: nodes handled, lock
+ * hold time per locked section and, for each timeout, how late it was
+ * detected.
+ *
+ * Context: Workqueue or hrtimer softirq context, takes @shard->lock
+ * Return: true if items remain in the tree and the shard must be rearmed
  */
-static void watchdog_work_func(struct work_struct *work)
+static bool watchdog_scan_shard(struct watchdog_shard *shard,
+				unsigned long *next_deadline)
 {
-	struct watchdog_context *ctx = container_of(work, struct watchdog_context, work.work);
-	struct watchdog_item *item, *tmp;
+	struct watchdog_item *item;
+	struct rb_node *node;
 	unsigned long flags;
-	unsigned long current_time = jiffies;
+	unsigned long current_time = watchdog_now(shard);
+	unsigned int handled = 0;
+	bool rearm = false;
+	u64 lock_start;
 
-	spin_lock_irqsave(&ctx->lock, flags);
+	spin_lock_irqsave(&shard->lock, flags);
+	lock_start = local_clock();
 
-	/*
-	 * Check all valid and active watchdog items for timeouts.
-	 * We use atomic reads to avoid races with lock-free start/cancel.
-	 */
-	list_for_each_entry_safe(item, tmp, &ctx->item_list, list) {
-		if (atomic_read(&item->valid) && atomic_read(&item->active)) {
-			unsigned long elapsed_ms = jiffies_to_msecs(current_time - item->start_time);
-
-			/* Check if timeout occurred */
-			if (elapsed_ms >= item->timeout_ms) {
-				/*
-				 * Call recovery function every time until cancelled.
-				 * Release lock during callback to avoid holding it
-				 * during potentially long-running recovery operations.
-				 */
-				if (item->recovery_func) {
-					spin_unlock_irqrestore(&ctx->lock, flags);
-					item->recovery_func(item->private_data);
-					spin_lock_irqsave(&ctx->lock, flags);
-				}
-				/*
-				 * Keep active=1 so recovery will be called again
-				 * next period. Only watchdog_cancel() or 
-				 * watchdog_remove() will stop the calls.
-				 */
-			}
+	watchdog_drain_arm_list(shard);
+
+	while ((node = rb_first_cached(&shard->deadline_tree))) {
+		void (*recovery_func)(void *data);
+		void *private_data;
+		unsigned long deadline;
+		u64 lateness_us;
+
+		item = rb_entry(node, struct watchdog_item, node);
+		if (time_before(current_time, item->deadline))
+			break;
+
+		watchdog_dequeue_item(shard, item);
+		handled++;
+
+		/* Cancelled since it was queued: drop it until restarted */
+		if (!atomic_read(&item->active) && watchdog_release_item(item))
+			continue;
+
+		/* Restarted or kicked since it was queued: only the key is stale */
+		deadline = watchdog_item_deadline(item);
+		if (time_before(current_time, deadline)) {
+			watchdog_queue_item(shard, item, deadline);
+			continue;
 		}
-	}
 
-	spin_unlock_irqrestore(&ctx->lock, flags);
+		lateness_us = current_time - deadline;
+		if (!watchdog_shard_hires(shard))
+			lateness_us = jiffies_to_usecs(lateness_us);
+		u64_stats_update_begin(&shard->stats.syncp);
+		shard->stats.expirations++;
+		shard->stats.lateness_us[watchdog_hist_bucket(lateness_us)]++;
+		u64_stats_update_end(&shard->stats.syncp);
+		trace_kwatchdog_item_expire(item, item->timeout_ms, lateness_us);
+
+		/*
+		 * Timeout occurred. Requeue for the next recovery call before
+		 * releasing the lock; active stays 1 so recovery is called again
+		 * every period. Only watchdog_cancel() or watchdog_remove() will
+		 * stop the calls.
+		 */
+		watchdog_queue_item(shard, item,
+				    current_time + watchdog_ms_to_ticks(shard, shard->period_ms));
+
+		/* Deferred: dispatch and keep scanning, coalesce if in flight */
+		if (shard->ctx->recovery_wq) {
+			if (!atomic_xchg(&item->recovery_pending, 1))
+				queue_work(shard->ctx->recovery_wq, &item->recovery_work);
+			continue;
+		}
+
+		recovery_func = item->recovery_func;
+		private_data = item->private_data;
+
+		if (recovery_func) {
+			unsigned long timeout_ms = item->timeout_ms;
 
-	/* Schedule next work iteration if system is still active */
-	if (ctx->initialized && ctx->work_active) {
-		schedule_delayed_work(&ctx->work, msecs_to_jiffies(ctx->period_ms));
+			watchdog_stats_lock_hold(shard, lock_start);
+			spin_unlock_irqrestore(&shard->lock, flags);
+			watchdog_run_recovery(shard, item, timeout_ms,
+					      recovery_func, private_data);
+			spin_lock_irqsave(&shard->lock, flags);
+			lock_start = local_clock();
+		}
+	}
+
+	node = rb_first_cached(&shard->deadline_tree);
+	if (node) {
+		*next_deadline = rb_entry(node, struct watchdog_item, node)->deadline;
+		rearm = true;
 	}
+
+	u64_stats_update_begin(&shard->stats.syncp);
+	shard->stats.scans++;
+	shard->stats.items_scanned += handled;
+	if (handled > shard->stats.max_items_scanned)
+		shard->stats.max_items_scanned = handled;
+	u64_stats_update_end(&shard->stats.syncp);
+
+	watchdog_stats_lock_hold(shard, lock_start);
+	spin_unlock_irqrestore(&shard->lock, flags);
+
+	return rearm && shard->ctx->initialized && shard->work_active;
+}
+
+/**
+ * watchdog_work_func - Deadline-driven work function that checks for timeouts
+ * @work: Work structure (embedded in watchdog_shard)
+ *
+ * This function runs when the earliest deadline in a shard's deadline tree
+ * is due. It scans the expired items with watchdog_scan_shard() and rearms
+ * the work for the new earliest deadline, on the shard's CPU for per-CPU
+ * shards. An empty tree leaves the work idle until watchdog_start() kicks it
+ * again.
+ *
+ * Context: Workqueue context (sleepable)
+ */
+static void watchdog_work_func(struct work_struct *work)
+{
+	struct watchdog_shard *shard = container_of(work, struct watchdog_shard, work.work);
+	unsigned long next_deadline = 0;
+
+	if (!watchdog_scan_shard(shard, &next_deadline))
+		return;
+
+	/* Arm for the next real deadline */
+	queue_delayed_work_on(watchdog_shard_cpu(shard), shard->ctx->wq, &shard->work,
+			      watchdog_work_delay(shard, next_deadline));
+}
+
+/**
+ * watchdog_hrtimer_func - hrtimer engine counterpart of watchdog_work_func()
+ * @timer: hrtimer (embedded in watchdog_shard)
+ *
+ * Runs in softirq context when the earliest deadline of a WATCHDOG_F_HRTIMER
+ * shard is due, scans the expired items and restarts the timer for the new
+ * earliest deadline with microsecond resolution.
+ *
+ * Restarting the timer may overwrite a concurrent immediate restart from
+ * watchdog_start(). The arm list is therefore re-checked after the restart;
+ * if a start slipped in, the timer fires again right away to pick it up.
+ *
+ * Context: hrtimer softirq context
+ * Return: HRTIMER_NORESTART, the timer is restarted explicitly
+ */
+static enum hrtimer_restart watchdog_hrtimer_func(struct hrtimer *timer)
+{
+	struct watchdog_shard *shard = container_of(timer, struct watchdog_shard, timer);
+	unsigned long next_deadline = 0;
+	unsigned long current_time;
+
+	if (!watchdog_scan_shard(shard, &next_deadline))
+		return HRTIMER_NORESTART;
+
+	current_time = watchdog_hr_now();
+	hrtimer_start_range_ns(timer, us_to_ktime(time_after(next_deadline, current_time) ?
+						  next_deadline - current_time : 0),
+			       shard->ctx->flags & WATCHDOG_F_COALESCE ?
+			       WATCHDOG_HR_MAX_WORK_PERIOD_MS * NSEC_PER_MSEC : 0,
+			       HRTIMER_MODE_REL_SOFT);
+
+	smp_mb(); /* Restart the timer before checking for new starts */
+	if (!llist_empty(&shard->arm_list))
+		hrtimer_start(timer, 0, HRTIMER_MODE_REL_SOFT);
+
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * watchdog_shard_kick - Make a shard scan its arm list right away
+ * @shard: Watchdog shard
+ *
+ * Context: Any context
+ */
+static void watchdog_shard_kick(struct watchdog_shard *shard)
+{
+	if (watchdog_shard_hires(shard))
+		hrtimer_start(&shard->timer, 0, HRTIMER_MODE_REL_SOFT);
+	else
+		mod_delayed_work_on(watchdog_shard_cpu(shard), shard->ctx->wq,
+				    &shard->work, 0);
+}
+
+/**
+ * watchdog_shard_stop - Stop the work of a shard whose last item was removed
+ * @shard: Watchdog shard, found empty under its lock
+ *
+ * The cancellation runs without the shard lock. An item added and started
+ * on the shard in that window kicks the work before it is cancelled, and
+ * further starts see a non-empty arm list and never kick again. Once the
+ * work is cancelled, check again under the lock and restore the kick if
+ * the shard gained items or arm requests meanwhile. A start after the
+ * check finds the arm list empty and kicks by itself.
+ *
+ * Context: Process context
+ */
+static void watchdog_shard_stop(struct watchdog_shard *shard)
+{
+	unsigned long flags;
+	bool rekick;
+
+	if (watchdog_shard_hires(shard))
+		hrtimer_try_to_cancel(&shard->timer);
+	else
+		cancel_delayed_work(&shard->work);
+
+	spin_lock_irqsave(&shard->lock, flags);
+	rekick = shard->nr_items || !llist_empty(&shard->arm_list);
+	spin_unlock_irqrestore(&shard->lock, flags);
+
+	if (rekick)
+		watchdog_shard_kick(shard);
 }
 
 /**
@@ -146,25 +615,435 @@ static void watchdog_work_func(struct work_struct *work)
 * @endcode
 */
 int watchdog_init(void)
+{
+	return watchdog_init_flags(0);
+}
+EXPORT_SYMBOL_GPL(watchdog_init);
+
+/**
+ * watchdog_shard_init - Initialize one watchdog shard
+ * @shard: Shard to initialize
+ * @ctx: Context the shard belongs to
+ * @cpu: CPU the shard's work runs on, or WORK_CPU_UNBOUND
+ *
+ * Context: Process context
+ */
+static void watchdog_shard_init(struct watchdog_shard *shard,
+				struct watchdog_context *ctx, int cpu)
+{
+	int i;
+
+	for (i = 0; i < WATCHDOG_TIMEOUT_BUCKETS; i++)
+		INIT_LIST_HEAD(&shard->item_buckets[i]);
+	shard->bucket_map = 0;
+	shard->min_timeout_ms = 0;
+	shard->min_count = 0;
+	shard->nr_items = 0;
+	shard->deadline_tree = RB_ROOT_CACHED;
+	init_llist_head(&shard->arm_list);
+	spin_lock_init(&shard->lock);
+	shard->period_ms = 0;  /* Will be set when first item is added */
+	shard->work_active = false;
+	shard->cpu = cpu;
+	shard->ctx = ctx;
+	memset(&shard->stats, 0, sizeof(shard->stats));
+	u64_stats_init(&shard->stats.syncp);
+
+	/* Initialize delayed work but don't schedule it yet */
+	if (ctx->flags & WATCHDOG_F_COALESCE)
+		INIT_DEFERRABLE_WORK(&shard->work, watchdog_work_func);
+	else
+		INIT_DELAYED_WORK(&shard->work, watchdog_work_func);
+	hrtimer_init(&shard->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+	shard->timer.function = watchdog_hrtimer_func;
+}
+
+/**
+ * watchdog_global_get - Take a reference on the state shared by all instances
+ *
+ * The item cache and the debugfs root directory are created by the first
+ * watchdog instance and shared by all following ones. Using a dedicated
+ * cache means drivers that recreate watchdogs on every link flap or session
+ * setup churn objects of that cache instead of kmalloc buckets. Items are
+ * cacheline aligned so items started on different CPUs never share a line.
+ *
+ * Context: Process context
+ * Return: 0 on success, -ENOMEM if the cache cannot be created
+ */
+static int watchdog_global_get(void)
+{
+	int ret = 0;
+
+	mutex_lock(&watchdog_global_mutex);
+	if (!watchdog_global_users) {
+		watchdog_item_cache = KMEM_CACHE(watchdog_item, SLAB_HWCACHE_ALIGN);
+		if (!watchdog_item_cache) {
+			pr_err("Failed to create watchdog item cache\n");
+			ret = -ENOMEM;
+		} else {
+			/* debugfs is best effort, failures are not fatal */
+			watchdog_debugfs_root = debugfs_create_dir("kwatchdog", NULL);
+		}
+	}
+	if (!ret)
+		watchdog_global_users++;
+	mutex_unlock(&watchdog_global_mutex);
+
+	return ret;
+}
+
+/**
+ * watchdog_global_put - Drop a reference on the state shared by all instances
+ *
+ * Destroys the item cache and the debugfs root when the last instance goes
+ * away. All items of the instance must have been freed.
+ *
+ * Context: Process context
+ */
+static void watchdog_global_put(void)
+{
+	mutex_lock(&watchdog_global_mutex);
+	if (!--watchdog_global_users) {
+		debugfs_remove_recursive(watchdog_debugfs_root);
+		watchdog_debugfs_root = NULL;
+		kmem_cache_destroy(watchdog_item_cache);
+		watchdog_item_cache = NULL;
+	}
+	mutex_unlock(&watchdog_global_mutex);
+}
+
+/**
+ * watchdog_stats_sum_shard - Add a shard's counters to an instance total
+ * @sum: Instance total
+ * @snap: Scratch space for the shard's snapshot
+ * @shard: Shard to add
+ *
+ * Lock-free, the snapshot is retried if a scan updated it meanwhile.
+ *
+ * Context: Any context
+ */
+static void watchdog_stats_sum_shard(struct watchdog_stats *sum,
+				     struct watchdog_stats *snap,
+				     const struct watchdog_shard *shard)
+{
+	unsigned int start;
+	int i;
+
+	do {
+		start = u64_stats_fetch_begin(&shard->stats.syncp);
+		memcpy(snap, &shard->stats, sizeof(*snap));
+	} while (u64_stats_fetch_retry(&shard->stats.syncp, start));
+
+	sum->scans += snap->scans;
+	sum->items_scanned += snap->items_scanned;
+	sum->max_items_scanned = max(sum->max_items_scanned, snap->max_items_scanned);
+	sum->expirations += snap->expirations;
+	for (i = 0; i < WATCHDOG_STATS_HIST_BUCKETS; i++) {
+		sum->lock_hold_ns[i] += snap->lock_hold_ns[i];
+		sum->lateness_us[i] += snap->lateness_us[i];
+	}
+}
+
+/**
+ * watchdog_stats_show_hist - Print the non-empty buckets of a histogram
+ * @m: seq_file to print to
+ * @name: Histogram name, including its unit
+ * @hist: Bucket counters
+ *
+ * Each line gives the lower bound of a bucket and its count.
+ */
+static void watchdog_stats_show_hist(struct seq_file *m, const char *name,
+				     const u64 *hist)
+{
+	int i;
+
+	seq_printf(m, "%s:\n", name);
+	for (i = 0; i < WATCHDOG_STATS_HIST_BUCKETS; i++) {
+		if (hist[i])
+			seq_printf(m, "  >=%llu: %llu\n", i ? 1ULL << i : 0ULL, hist[i]);
+	}
+}
+
+/**
+ * watchdog_stats_show - Show the "stats" debugfs file of an instance
+ * @m: seq_file, private data is the watchdog context
+ * @v: Unused
+ *
+ * Prints the counters of all shards of the instance summed up, without
+ * taking any shard lock, e.g.:
+ *
+ *   scans: 1520
+ *   items_scanned: 1604
+ *   max_items_per_scan: 3
+ *   expirations: 12
+ *   recoveries: 12
+ *   lock_hold_ns:
+ *     >=256: 1490
+ *     >=512: 30
+ *   lateness_us:
+ *     >=2048: 12
+ *   recovery_us:
+ *     >=64: 12
+ *
+ * Context: Process context
+ * Return: 0 on success, -ENOMEM if the summary cannot be allocated
+ */
+static int watchdog_stats_show(struct seq_file *m, void *v)
+{
+	struct watchdog_context *ctx = m->private;
+	u64 recovery_us[WATCHDOG_STATS_HIST_BUCKETS] = {};
+	struct watchdog_stats *sum;
+	u64 recoveries = 0;
+	int cpu, i;
+
+	/* Total and per-shard snapshot */
+	sum = kcalloc(2, sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return -ENOMEM;
+
+	watchdog_stats_sum_shard(sum, sum + 1, &ctx->shard);
+	if (ctx->shards) {
+		for_each_possible_cpu(cpu)
+			watchdog_stats_sum_shard(sum, sum + 1, per_cpu_ptr(ctx->shards, cpu));
+	}
+
+	for_each_possible_cpu(cpu) {
+		const struct watchdog_recovery_stats *rs = per_cpu_ptr(ctx->recovery_stats, cpu);
+
+		recoveries += READ_ONCE(rs->recoveries);
+		for (i = 0; i < WATCHDOG_STATS_HIST_BUCKETS; i++)
+			recovery_us[i] += READ_ONCE(rs->recovery_us[i]);
+	}
+
+	seq_printf(m, "scans: %llu\n", sum->scans);
+	seq_printf(m, "items_scanned: %llu\n", sum->items_scanned);
+	seq_printf(m, "max_items_per_scan: %llu\n", sum->max_items_scanned);
+	seq_printf(m, "expirations: %llu\n", sum->expirations);
+	seq_printf(m, "recoveries: %llu\n", recoveries);
+	watchdog_stats_show_hist(m, "lock_hold_ns", sum->lock_hold_ns);
+	watchdog_stats_show_hist(m, "lateness_us", sum->lateness_us);
+	watchdog_stats_show_hist(m, "recovery_us", recovery_us);
+
+	kfree(sum);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(watchdog_stats);
+
+/**
+ * watchdog_debugfs_add - Create the debugfs directory of an instance
+ * @ctx: Watchdog context
+ *
+ * The default instance is <debugfs>/kwatchdog/default, instances from
+ * watchdog_ctx_create() are numbered in creation order (ctx0, ctx1, ...).
+ *
+ * Context: Process context
+ */
+static void watchdog_debugfs_add(struct watchdog_context *ctx)
+{
+	char name[16];
+
+	mutex_lock(&watchdog_global_mutex);
+	if (ctx == &g_watchdog_ctx)
+		strscpy(name, "default", sizeof(name));
+	else
+		snprintf(name, sizeof(name), "ctx%u", watchdog_ctx_next_id++);
+
+	ctx->debugfs_dir = debugfs_create_dir(name, watchdog_debugfs_root);
+	debugfs_create_file("stats", 0444, ctx->debugfs_dir, ctx, &watchdog_stats_fops);
+	mutex_unlock(&watchdog_global_mutex);
+}
+
+/**
+ * watchdog_ctx_setup - Initialize a watchdog context and its shards
+ * @ctx: Context to initialize
+ * @flags: Bitmask of WATCHDOG_F_* flags
+ * @wq: Workqueue for the shards' work, NULL for system_wq
+ *
+ * Common implementation of watchdog_init_flags() and watchdog_ctx_create().
+ *
+ * Context: Process context
+ * Return: 0 on success, -EINVAL for unknown flags, -ENOMEM if per-CPU
+ *         shards or the item cache cannot be allocated
+ */
+static int watchdog_ctx_setup(struct watchdog_context *ctx, unsigned int flags,
+			      struct workqueue_struct *wq)
+{
+	unsigned int wq_flags = WQ_UNBOUND;
+	int cpu;
+
+	if (flags & ~(WATCHDOG_F_PERCPU | WATCHDOG_F_DEFERRED_RECOVERY |
+		      WATCHDOG_F_HIGHPRI_RECOVERY | WATCHDOG_F_HRTIMER |
+		      WATCHDOG_F_COALESCE)) {
+		pr_err("Unknown watchdog flags 0x%x\n", flags);
+		return -EINVAL;
+	}
+
+	if (flags & WATCHDOG_F_HIGHPRI_RECOVERY) {
+		flags |= WATCHDOG_F_DEFERRED_RECOVERY;
+		wq_flags |= WQ_HIGHPRI;
+	}
+
+	/* Recovery functions must not run from the hrtimer softirq */
+	if (flags & WATCHDOG_F_HRTIMER)
+		flags |= WATCHDOG_F_DEFERRED_RECOVERY;
+
+	/* Initialize context to clean state */
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->flags = flags;
+	ctx->wq = wq ? wq : system_wq;
+	watchdog_shard_init(&ctx->shard, ctx, WORK_CPU_UNBOUND);
+
+	if (flags & WATCHDOG_F_PERCPU) {
+		ctx->shards = alloc_percpu(struct watchdog_shard);
+		if (!ctx->shards) {
+			pr_err("Failed to allocate per-CPU watchdog shards\n");
+			return -ENOMEM;
+		}
+
+		for_each_possible_cpu(cpu)
+			watchdog_shard_init(per_cpu_ptr(ctx->shards, cpu), ctx, cpu);
+	}
+
+	ctx->recovery_stats = alloc_percpu(struct watchdog_recovery_stats);
+	if (!ctx->recovery_stats) {
+		pr_err("Failed to allocate watchdog recovery statistics\n");
+		goto err_free_shards;
+	}
+
+	if (watchdog_global_get())
+		goto err_free_stats;
+
+	if (flags & WATCHDOG_F_DEFERRED_RECOVERY) {
+		ctx->recovery_wq = alloc_workqueue("watchdog_recovery", wq_flags, 0);
+		if (!ctx->recovery_wq) {
+			pr_err("Failed to allocate watchdog recovery workqueue\n");
+			goto err_put_cache;
+		}
+	}
+
+	watchdog_debugfs_add(ctx);
+	ctx->initialized = true;
+
+	return 0;
+
+err_put_cache:
+	watchdog_global_put();
+err_free_stats:
+	free_percpu(ctx->recovery_stats);
+	ctx->recovery_stats = NULL;
+err_free_shards:
+	free_percpu(ctx->shards);
+	ctx->shards = NULL;
+	return -ENOMEM;
+}
+
+/**
+* watchdog_init_flags - Initialize the watchdog system with options
+* @flags: Bitmask of WATCHDOG_F_* flags
+*
+* Same as watchdog_init(), with the ability to select the shard layout.
+* With WATCHDOG_F_PERCPU one shard is created per possible CPU; each shard
+* has its own item list, deadline tree, lock and delayed work queued on that
+* CPU, so add/remove on one CPU never contends with another CPU's items.
+*
+* Context: Process context
+* Return: 0 on success, -EBUSY if already initialized, -EINVAL for unknown
+*         flags, -ENOMEM if per-CPU shards cannot be allocated
+*
+* Example:
+* @code
+* static int __init my_module_init(void)
+* {
+*     // Per-queue watchdogs are added on the CPU of their IRQ
+*     return watchdog_init_flags(WATCHDOG_F_PERCPU);
+* }
+* @endcode
+*/
+int watchdog_init_flags(unsigned int flags)
 {
 	if (g_watchdog_ctx.initialized) {
 		pr_warn("Watchdog already initialized\n");
 		return -EBUSY;
 	}
 
-	/* Initialize context to clean state */
-	memset(&g_watchdog_ctx, 0, sizeof(g_watchdog_ctx));
-	INIT_LIST_HEAD(&g_watchdog_ctx.item_list);
-	spin_lock_init(&g_watchdog_ctx.lock);
-	g_watchdog_ctx.period_ms = 0;  /* Will be set when first item is added */
-	g_watchdog_ctx.initialized = true;
-	g_watchdog_ctx.work_active = false;
+	return watchdog_ctx_setup(&g_watchdog_ctx, flags, NULL);
+}
+EXPORT_SYMBOL_GPL(watchdog_init_flags);
 
-	/* Initialize delayed work but don't schedule it yet */
-	INIT_DELAYED_WORK(&g_watchdog_ctx.work, watchdog_work_func);
+/**
+ * watchdog_shard_destroy - Stop a shard's work and free all of its items
+ * @shard: Shard to tear down
+ *
+ * Context: Process context (may sleep due to work cancellation)
+ */
+static void watchdog_shard_destroy(struct watchdog_shard *shard)
+{
+	struct watchdog_item *item, *tmp;
+	unsigned long flags;
+	int i;
 
+	shard->work_active = false;
+	if (watchdog_shard_hires(shard))
+		hrtimer_cancel(&shard->timer);
+	else
+		cancel_delayed_work_sync(&shard->work);
 
-	return 0;
+	/* The scan is stopped, wait for recoveries it already dispatched */
+	if (shard->ctx->recovery_wq)
+		flush_workqueue(shard->ctx->recovery_wq);
+
+	/* Remove and free all items */
+	spin_lock_irqsave(&shard->lock, flags);
+	llist_del_all(&shard->arm_list);
+	shard->deadline_tree = RB_ROOT_CACHED;
+	for (i = 0; i < WATCHDOG_TIMEOUT_BUCKETS; i++) {
+		list_for_each_entry_safe(item, tmp, &shard->item_buckets[i], list) {
+			atomic_set(&item->valid, 0);  /* Mark invalid to prevent use */
+			list_del(&item->list);
+			kmem_cache_free(watchdog_item_cache, item);
+		}
+	}
+	shard->bucket_map = 0;
+	shard->min_count = 0;
+	shard->nr_items = 0;
+	spin_unlock_irqrestore(&shard->lock, flags);
+}
+
+/**
+ * watchdog_ctx_teardown - Stop all work of a context and free its items
+ * @ctx: Context to tear down
+ *
+ * Common implementation of watchdog_deinit() and watchdog_ctx_destroy().
+ *
+ * Context: Process context (may sleep due to work cancellation)
+ */
+static void watchdog_ctx_teardown(struct watchdog_context *ctx)
+{
+	int cpu;
+
+	/* No stats reader may run into the freed shards */
+	debugfs_remove_recursive(ctx->debugfs_dir);
+	ctx->debugfs_dir = NULL;
+
+	/* Stop the work and prevent further scheduling */
+	ctx->initialized = false;
+	watchdog_shard_destroy(&ctx->shard);
+
+	if (ctx->shards) {
+		for_each_possible_cpu(cpu)
+			watchdog_shard_destroy(per_cpu_ptr(ctx->shards, cpu));
+		free_percpu(ctx->shards);
+		ctx->shards = NULL;
+	}
+
+	if (ctx->recovery_wq) {
+		destroy_workqueue(ctx->recovery_wq);
+		ctx->recovery_wq = NULL;
+	}
+
+	free_percpu(ctx->recovery_stats);
+	ctx->recovery_stats = NULL;
+	watchdog_global_put();
 }
 
 /**
@@ -216,29 +1095,424 @@ int watchdog_init(void)
 */
 void watchdog_deinit(void)
 {
-	struct watchdog_item *item, *tmp;
+	if (!g_watchdog_ctx.initialized) {
+		pr_warn("Watchdog not initialized\n");
+		return;
+	}
+
+	watchdog_ctx_teardown(&g_watchdog_ctx);
+}
+EXPORT_SYMBOL_GPL(watchdog_deinit);
+
+/**
+* watchdog_ctx_create - Create an independent watchdog instance
+* @flags: Bitmask of WATCHDOG_F_* flags
+* @wq: Workqueue to run the instance's work on, NULL for system_wq
+*
+* Allocates and initializes a watchdog instance that is independent from the
+* default one and from every other instance: it has its own items, recovery
+* period and work. Use it to keep consumers with very different timeouts
+* apart, or to run timeout checking on a dedicated (e.g. WQ_HIGHPRI or
+* WQ_UNBOUND) workqueue. @wq must outlive the instance.
+*
+* Items are added with watchdog_add_ctx() or watchdog_add_on_cpu_ctx() and
+* are otherwise handled with the usual watchdog_start(), watchdog_cancel()
+* and watchdog_remove().
+*
+* Context: Process context
+* Return: Pointer to the new instance, or NULL on invalid flags or
+*         allocation failure
+*
+* Example:
+* @code
+* static struct watchdog_context *fw_wdog_ctx;
+*
+* static int my_fw_init(struct my_device *dev)
+* {
+*     fw_wdog_ctx = watchdog_ctx_create(0, dev->highpri_wq);
+*     if (!fw_wdog_ctx)
+*         return -ENOMEM;
+*
+*     dev->fw_wdog = watchdog_add_ctx(fw_wdog_ctx, 500, fw_recovery, dev);
+*     return dev->fw_wdog ? 0 : -ENOMEM;
+* }
+*
+* static void my_fw_exit(struct my_device *dev)
+* {
+*     // Frees dev->fw_wdog as well
+*     watchdog_ctx_destroy(fw_wdog_ctx);
+* }
+* @endcode
+*/
+struct watchdog_context *watchdog_ctx_create(unsigned int flags,
+					     struct workqueue_struct *wq)
+{
+	struct watchdog_context *ctx;
+
+	ctx = kmalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx) {
+		pr_err("Failed to allocate watchdog context\n");
+		return NULL;
+	}
+
+	if (watchdog_ctx_setup(ctx, flags, wq)) {
+		kfree(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+EXPORT_SYMBOL_GPL(watchdog_ctx_create);
+
+/**
+* watchdog_ctx_destroy - Destroy a watchdog instance
+* @ctx: Instance returned by watchdog_ctx_create()
+*
+* Stops the instance's work, removes and frees all of its items and frees
+* the instance itself. Item pointers of this instance become invalid.
+* Must not be used on the default instance; use watchdog_deinit() for that.
+*
+* Context: Process context (may sleep due to work cancellation)
+*/
+void watchdog_ctx_destroy(struct watchdog_context *ctx)
+{
+	if (!ctx)
+		return;
+
+	if (WARN_ON(ctx == &g_watchdog_ctx))
+		return;
+
+	if (ctx->initialized)
+		watchdog_ctx_teardown(ctx);
+
+	kfree(ctx);
+}
+EXPORT_SYMBOL_GPL(watchdog_ctx_destroy);
+
+/**
+ * watchdog_set_period - Derive the recovery period from the shortest timeout
+ * @shard: Shard whose minimum timeout changed
+ *
+ * The period is half the shortest timeout, clamped to
+ * WATCHDOG_MAX_WORK_PERIOD_MS (WATCHDOG_HR_MAX_WORK_PERIOD_MS for the
+ * hrtimer engine) to prevent excessive CPU usage.
+ *
+ * Context: Caller holds @shard->lock
+ */
+static void watchdog_set_period(struct watchdog_shard *shard)
+{
+	unsigned long floor_ms = watchdog_shard_hires(shard) ?
+				 WATCHDOG_HR_MAX_WORK_PERIOD_MS :
+				 WATCHDOG_MAX_WORK_PERIOD_MS;
+
+	shard->period_ms = max(shard->min_timeout_ms / 2, floor_ms);
+}
+
+/**
+ * watchdog_recalc_min - Find the new shortest timeout after the old one left
+ * @shard: Shard with at least one item
+ *
+ * Only the lowest non-empty bucket can hold the minimum, so only that bucket
+ * is scanned. Its items all have timeouts within a factor of two of each
+ * other, which keeps the scan short even with many registered items.
+ *
+ * Context: Caller holds @shard->lock
+ */
+static void watchdog_recalc_min(struct watchdog_shard *shard)
+{
+	struct watchdog_item *item;
+	unsigned int bucket = __ffs(shard->bucket_map);
+
+	shard->min_timeout_ms = ULONG_MAX;
+	shard->min_count = 0;
+
+	list_for_each_entry(item, &shard->item_buckets[bucket], list) {
+		if (item->timeout_ms < shard->min_timeout_ms) {
+			shard->min_timeout_ms = item->timeout_ms;
+			shard->min_count = 1;
+		} else if (item->timeout_ms == shard->min_timeout_ms) {
+			shard->min_count++;
+		}
+	}
+
+	watchdog_set_period(shard);
+}
+
+/**
+ * watchdog_link_item - Put an item into its timeout bucket
+ * @shard: Shard the item belongs to
+ * @item: New item
+ *
+ * Updates the bucket map and the shortest timeout, but leaves the recovery
+ * period and the work state to the caller.
+ *
+ * Context: Caller holds @shard->lock
+ * Return: true if @item lowered the shard's shortest timeout
+ */
+static bool watchdog_link_item(struct watchdog_shard *shard,
+			       struct watchdog_item *item)
+{
+	unsigned int bucket = ilog2(item->timeout_ms);
+
+	list_add_tail(&item->list, &shard->item_buckets[bucket]);
+	__set_bit(bucket, &shard->bucket_map);
+	shard->nr_items++;
+
+	if (!shard->min_count || item->timeout_ms < shard->min_timeout_ms) {
+		shard->min_timeout_ms = item->timeout_ms;
+		shard->min_count = 1;
+		return true;
+	}
+
+	if (item->timeout_ms == shard->min_timeout_ms)
+		shard->min_count++;
+
+	return false;
+}
+
+/**
+ * watchdog_account_item - Add an item to its shard's timeout buckets
+ * @shard: Shard the item belongs to
+ * @item: New item
+ *
+ * O(1). The recovery period is only recomputed when @item lowers the
+ * shard's shortest timeout. The first item enables the work; it is armed
+ * once an item is started.
+ *
+ * Context: Caller holds @shard->lock
+ *
+ * Example behavior:
+ * @code
+ * // Initially no items - no work running
+ * // work_active = false, period_ms = 0
+ * 
+ * watchdog_add(2000, func1, data1);
+ * // period_ms = 1000ms (2000/2), work_active = true, nothing armed yet
+ * 
+ * watchdog_add(800, func2, data2);
+ * // new minimum: period_ms = 400ms (800/2)
+ * 
+ * watchdog_add(3000, func3, data3);
+ * // minimum unchanged: period_ms stays 400ms, nothing recomputed
+ * @endcode
+ */
+static void watchdog_account_item(struct watchdog_shard *shard,
+				  struct watchdog_item *item)
+{
+	if (watchdog_link_item(shard, item))
+		watchdog_set_period(shard);
+
+	shard->work_active = true;
+}
+
+/**
+ * watchdog_unlink_item - Take an item out of its timeout bucket
+ * @shard: Shard the item belongs to
+ * @item: Item being removed
+ *
+ * Leaves a shortest timeout without items (min_count == 0) for
+ * watchdog_account_done() to resolve, so that removing many items
+ * recomputes it only once.
+ *
+ * Context: Caller holds @shard->lock
+ */
+static void watchdog_unlink_item(struct watchdog_shard *shard,
+				 struct watchdog_item *item)
+{
+	unsigned int bucket = ilog2(item->timeout_ms);
+
+	list_del(&item->list);
+	if (list_empty(&shard->item_buckets[bucket]))
+		__clear_bit(bucket, &shard->bucket_map);
+
+	shard->nr_items--;
+	if (item->timeout_ms == shard->min_timeout_ms && shard->min_count)
+		shard->min_count--;
+}
+
+/**
+ * watchdog_account_done - Settle the recovery period after items were unlinked
+ * @shard: Shard after one or more watchdog_unlink_item() calls
+ *
+ * When the last item went away the work is disabled; the caller is
+ * expected to cancel it after dropping the lock.
+ *
+ * Context: Caller holds @shard->lock
+ * Return: true if the shard is now empty and its work should be stopped
+ */
+static bool watchdog_account_done(struct watchdog_shard *shard)
+{
+	if (!shard->nr_items) {
+		shard->min_timeout_ms = 0;
+		shard->min_count = 0;
+		shard->period_ms = 0;
+		shard->work_active = false;
+		return true;
+	}
+
+	if (!shard->min_count)
+		watchdog_recalc_min(shard);
+
+	return false;
+}
+
+/**
+ * watchdog_unaccount_item - Remove an item from its shard's timeout buckets
+ * @shard: Shard the item belongs to
+ * @item: Item being removed
+ *
+ * O(1) unless @item was the last one at the shortest timeout, in which case
+ * watchdog_recalc_min() scans the lowest non-empty bucket. When the last
+ * item goes away the work is disabled; the caller is expected to cancel it
+ * after dropping the lock.
+ *
+ * Context: Caller holds @shard->lock
+ * Return: true if the shard is now empty and its work should be stopped
+ *
+ * Example behavior:
+ * @code
+ * // Items with 2000ms and 800ms timeouts, period_ms = 400ms
+ * 
+ * watchdog_remove(item_800);
+ * // minimum moved: period_ms = 1000ms (back to 2000/2)
+ * 
+ * watchdog_remove(item_2000);
+ * // work_active = false, period_ms = 0, zero overhead achieved
+ * @endcode
+ */
+static bool watchdog_unaccount_item(struct watchdog_shard *shard,
+				    struct watchdog_item *item)
+{
+	watchdog_unlink_item(shard, item);
+
+	return watchdog_account_done(shard);
+}
+
+/**
+ * watchdog_item_params_valid - Check the parameters of a new item
+ * @shard: Shard that will own the item
+ * @timeout_ms: Timeout value in milliseconds
+ * @recovery_func: Function to call when timeout occurs
+ *
+ * Context: Any context
+ * Return: true if the item can be created, false if @recovery_func is NULL,
+ *         or BUG() if @timeout_ms is below the minimum of the shard's engine
+ */
+static bool watchdog_item_params_valid(struct watchdog_shard *shard,
+				       unsigned long timeout_ms,
+				       void (*recovery_func)(void *data))
+{
+	unsigned long min_timeout_ms = watchdog_shard_hires(shard) ?
+				       WATCHDOG_HR_MIN_TIMEOUT_MS :
+				       WATCHDOG_MIN_TIMEOUT_MS;
+
+	/* Enforce minimum timeout to protect system stability */
+	if (timeout_ms < min_timeout_ms) {
+		pr_crit("FATAL: Watchdog timeout (%lu ms) is shorter than minimum allowed (%lu ms)\n",
+			timeout_ms, min_timeout_ms);
+		pr_crit("This would cause excessive CPU usage and system instability\n");
+		pr_crit("Please use timeout >= %lu ms or redesign your timing requirements\n",
+			min_timeout_ms);
+		BUG();
+	}
+
+	if (!recovery_func) {
+		pr_err("Recovery function is NULL\n");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * watchdog_item_setup - Initialize a freshly allocated item in inactive state
+ * @shard: Shard that will own the item
+ * @item: Item from the watchdog item cache
+ * @timeout_ms: Timeout value in milliseconds
+ * @recovery_func: Function to call when timeout occurs
+ * @private_data: Opaque pointer passed to recovery function
+ *
+ * Context: Any context
+ */
+static void watchdog_item_setup(struct watchdog_shard *shard,
+				struct watchdog_item *item,
+				unsigned long timeout_ms,
+				void (*recovery_func)(void *data),
+				void *private_data)
+{
+	INIT_LIST_HEAD(&item->list);
+	item->shard = shard;
+	RB_CLEAR_NODE(&item->node);
+	item->deadline = 0;
+	item->timeout_ms = timeout_ms;
+	item->start_time = 0;
+	item->hires = watchdog_shard_hires(shard);
+	atomic_set(&item->active, 0);     /* Inactive until watchdog_start() */
+	atomic_set(&item->queued, 0);     /* Not yet handed to the work */
+	item->recovery_func = recovery_func;
+	item->private_data = private_data;
+	atomic_set(&item->valid, 1);      /* Valid for use */
+	INIT_WORK(&item->recovery_work, watchdog_recovery_work_func);
+	atomic_set(&item->recovery_pending, 0);
+}
+
+/**
+ * watchdog_add_to_shard - Allocate a watchdog item and link it into a shard
+ * @shard: Shard that will own the item
+ * @timeout_ms: Timeout value in milliseconds
+ * @recovery_func: Function to call when timeout occurs
+ * @private_data: Opaque pointer passed to recovery function
+ * @gfp: Allocation flags for the item
+ *
+ * Common implementation of the watchdog_add*() functions.
+ *
+ * Context: Any context allowed by @gfp
+ * Return: Pointer to watchdog item on success, NULL on failure
+ */
+static struct watchdog_item *watchdog_add_to_shard(struct watchdog_shard *shard,
+						   unsigned long timeout_ms,
+						   void (*recovery_func)(void *data),
+						   void *private_data, gfp_t gfp)
+{
+	struct watchdog_item *item;
 	unsigned long flags;
 
-	if (!g_watchdog_ctx.initialized) {
-		pr_warn("Watchdog not initialized\n");
-		return;
+	if (!watchdog_item_params_valid(shard, timeout_ms, recovery_func))
+		return NULL;
+
+	/* Allocate new item */
+	item = kmem_cache_alloc(watchdog_item_cache, gfp);
+	if (!item) {
+		pr_err("Failed to allocate watchdog item\n");
+		return NULL;
 	}
 
-	/* Stop the work and prevent further scheduling */
-	g_watchdog_ctx.initialized = false;
-	g_watchdog_ctx.work_active = false;
-	cancel_delayed_work_sync(&g_watchdog_ctx.work);
+	watchdog_item_setup(shard, item, timeout_ms, recovery_func, private_data);
 
-	/* Remove and free all items */
-	spin_lock_irqsave(&g_watchdog_ctx.lock, flags);
-	list_for_each_entry_safe(item, tmp, &g_watchdog_ctx.item_list, list) {
-		atomic_set(&item->valid, 0);  /* Mark invalid to prevent use */
-		list_del(&item->list);
-		kfree(item);
-	}
-	spin_unlock_irqrestore(&g_watchdog_ctx.lock, flags);
+	/* Add to the shard and adjust the recovery period in O(1) */
+	spin_lock_irqsave(&shard->lock, flags);
+	watchdog_account_item(shard, item);
+	spin_unlock_irqrestore(&shard->lock, flags);
 
+	trace_kwatchdog_item_add(item, timeout_ms);
+	return item;
+}
+
+/**
+ * watchdog_cpu_shard - Look up the shard of a context serving a CPU
+ * @ctx: Watchdog context
+ * @cpu: CPU number
+ *
+ * Return: The per-CPU shard of @cpu, or the single shared shard when the
+ *         context was not initialized with WATCHDOG_F_PERCPU
+ */
+static struct watchdog_shard *watchdog_cpu_shard(struct watchdog_context *ctx,
+						 int cpu)
+{
+	if (!ctx->shards)
+		return &ctx->shard;
 
+	return per_cpu_ptr(ctx->shards, cpu);
 }
 
 /**
@@ -252,9 +1526,9 @@ void watchdog_deinit(void)
 * The recovery function will be called repeatedly every work period after the
 * timeout occurs, until watchdog_cancel() or watchdog_remove() is called.
 *
-* If this is the first watchdog item, the periodic work is automatically
-* started. If the timeout is shorter than existing items, the work period
-* is dynamically adjusted for better accuracy.
+* If this is the first watchdog item, the work is enabled; it is armed once
+* an item is started. If the timeout is shorter than existing items, the
+* recovery period is adjusted accordingly.
 *
 * The @timeout_ms must be at least WATCHDOG_MIN_TIMEOUT_MS milliseconds to
 * prevent excessive CPU usage. Shorter timeouts will trigger BUG() to
@@ -307,55 +1581,262 @@ struct watchdog_item *watchdog_add(unsigned long timeout_ms,
 				   void (*recovery_func)(void *data),
 				   void *private_data)
 {
-	struct watchdog_item *item;
-	unsigned long flags;
+	return watchdog_add_ctx(&g_watchdog_ctx, timeout_ms, recovery_func,
+				private_data);
+}
+EXPORT_SYMBOL_GPL(watchdog_add);
 
-	if (!g_watchdog_ctx.initialized) {
+/**
+* watchdog_add_ctx - Add a new watchdog item to a given watchdog instance
+* @ctx: Instance from watchdog_ctx_create()
+* @timeout_ms: Timeout value in milliseconds (must be >= WATCHDOG_MIN_TIMEOUT_MS)
+* @recovery_func: Function to call when timeout occurs (must not be NULL)
+* @private_data: Opaque pointer passed to recovery function (can be NULL)
+*
+* Same as watchdog_add(), but adds the item to @ctx instead of the default
+* instance. The item only affects the recovery period of @ctx. Instances
+* created with WATCHDOG_F_HRTIMER accept timeouts down to
+* WATCHDOG_HR_MIN_TIMEOUT_MS.
+*
+* Context: Process context
+* Return: Pointer to watchdog item on success, NULL if @ctx is not
+*         initialized or on allocation failure, or BUG() if
+*         timeout_ms < WATCHDOG_MIN_TIMEOUT_MS
+*/
+struct watchdog_item *watchdog_add_ctx(struct watchdog_context *ctx,
+				       unsigned long timeout_ms,
+				       void (*recovery_func)(void *data),
+				       void *private_data)
+{
+	if (!ctx || !ctx->initialized) {
 		pr_err("Watchdog not initialized\n");
 		return NULL;
 	}
 
-	/* Enforce minimum timeout to protect system stability */
-	if (timeout_ms < WATCHDOG_MIN_TIMEOUT_MS) {
-		pr_crit("FATAL: Watchdog timeout (%lu ms) is shorter than minimum allowed (%d ms)\n",
-			timeout_ms, WATCHDOG_MIN_TIMEOUT_MS);
-		pr_crit("This would cause excessive CPU usage and system instability\n");
-		pr_crit("Please use timeout >= %d ms or redesign your timing requirements\n",
-			WATCHDOG_MIN_TIMEOUT_MS);
-		BUG();
+	return watchdog_add_to_shard(watchdog_cpu_shard(ctx, raw_smp_processor_id()),
+				     timeout_ms, recovery_func, private_data,
+				     GFP_KERNEL);
+}
+EXPORT_SYMBOL_GPL(watchdog_add_ctx);
+
+/**
+* watchdog_add_ctx_gfp - Add a new watchdog item with explicit allocation flags
+* @ctx: Instance from watchdog_ctx_create(), or NULL for the default instance
+* @timeout_ms: Timeout value in milliseconds (must be >= WATCHDOG_MIN_TIMEOUT_MS)
+* @recovery_func: Function to call when timeout occurs (must not be NULL)
+* @private_data: Opaque pointer passed to recovery function (can be NULL)
+* @gfp: Allocation flags, e.g. GFP_ATOMIC
+*
+* Same as watchdog_add_ctx(), but allocates the item from the watchdog item
+* cache with @gfp. With GFP_ATOMIC the item can be created from atomic
+* context, e.g. from a link state interrupt or while holding a spinlock.
+* Unless the instance uses WATCHDOG_F_DEFERRED_RECOVERY, watchdog_remove()
+* never sleeps either, so such short-lived items can be torn down from the
+* same context.
+*
+* Context: Any context allowed by @gfp
+* Return: Pointer to watchdog item on success, NULL if the instance is not
+*         initialized or on allocation failure, or BUG() if
+*         timeout_ms < WATCHDOG_MIN_TIMEOUT_MS
+*
+* Example:
+* @code
+* static void my_link_up(struct my_device *dev)
+* {
+*     spin_lock(&dev->lock);
+*     dev->session_wdog = watchdog_add_ctx_gfp(NULL, 3000, session_recovery,
+*                                              dev, GFP_ATOMIC);
+*     if (dev->session_wdog)
+*         watchdog_start(dev->session_wdog);
+*     spin_unlock(&dev->lock);
+* }
+* @endcode
+*/
+struct watchdog_item *watchdog_add_ctx_gfp(struct watchdog_context *ctx,
+					   unsigned long timeout_ms,
+					   void (*recovery_func)(void *data),
+					   void *private_data, gfp_t gfp)
+{
+	if (!ctx)
+		ctx = &g_watchdog_ctx;
+
+	if (!ctx->initialized) {
+		pr_err("Watchdog not initialized\n");
+		return NULL;
 	}
 
-	if (!recovery_func) {
-		pr_err("Recovery function is NULL\n");
+	return watchdog_add_to_shard(watchdog_cpu_shard(ctx, raw_smp_processor_id()),
+				     timeout_ms, recovery_func, private_data, gfp);
+}
+EXPORT_SYMBOL_GPL(watchdog_add_ctx_gfp);
+
+/**
+* watchdog_add_on_cpu - Add a new watchdog item to the shard of a given CPU
+* @cpu: CPU whose shard checks the item
+* @timeout_ms: Timeout value in milliseconds (must be >= WATCHDOG_MIN_TIMEOUT_MS)
+* @recovery_func: Function to call when timeout occurs (must not be NULL)
+* @private_data: Opaque pointer passed to recovery function (can be NULL)
+*
+* Same as watchdog_add(), but places the item on the shard of @cpu instead
+* of the calling CPU. This lets a driver create all per-queue watchdogs from
+* its probe path and still have each one checked on the CPU its queue IRQ is
+* affine to. Without WATCHDOG_F_PERCPU all CPUs share one shard and @cpu
+* only needs to be a valid CPU number.
+*
+* Context: Process context
+* Return: Pointer to watchdog item on success, NULL on invalid @cpu or
+*         allocation failure, or BUG() if timeout_ms < WATCHDOG_MIN_TIMEOUT_MS
+*
+* Example:
+* @code
+* for (i = 0; i < dev->num_queues; i++) {
+*     struct my_queue *q = &dev->queues[i];
+*
+*     q->wdog = watchdog_add_on_cpu(q->irq_cpu, 1000, queue_recovery, q);
+*     if (!q->wdog)
+*         goto err_remove;
+* }
+* @endcode
+*/
+struct watchdog_item *watchdog_add_on_cpu(int cpu, unsigned long timeout_ms,
+					  void (*recovery_func)(void *data),
+					  void *private_data)
+{
+	return watchdog_add_on_cpu_ctx(&g_watchdog_ctx, cpu, timeout_ms,
+				       recovery_func, private_data);
+}
+EXPORT_SYMBOL_GPL(watchdog_add_on_cpu);
+
+/**
+* watchdog_add_on_cpu_ctx - Add a new watchdog item to a CPU's shard of an instance
+* @ctx: Instance from watchdog_ctx_create()
+* @cpu: CPU whose shard checks the item
+* @timeout_ms: Timeout value in milliseconds (must be >= WATCHDOG_MIN_TIMEOUT_MS)
+* @recovery_func: Function to call when timeout occurs (must not be NULL)
+* @private_data: Opaque pointer passed to recovery function (can be NULL)
+*
+* Same as watchdog_add_on_cpu(), but adds the item to @ctx instead of the
+* default instance.
+*
+* Context: Process context
+* Return: Pointer to watchdog item on success, NULL if @ctx is not
+*         initialized, on invalid @cpu or allocation failure, or BUG() if
+*         timeout_ms < WATCHDOG_MIN_TIMEOUT_MS
+*/
+struct watchdog_item *watchdog_add_on_cpu_ctx(struct watchdog_context *ctx, int cpu,
+					      unsigned long timeout_ms,
+					      void (*recovery_func)(void *data),
+					      void *private_data)
+{
+	if (!ctx || !ctx->initialized) {
+		pr_err("Watchdog not initialized\n");
 		return NULL;
 	}
 
-	/* Allocate new item */
-	item = kmalloc(sizeof(*item), GFP_KERNEL);
-	if (!item) {
-		pr_err("Failed to allocate watchdog item\n");
+	if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_possible(cpu)) {
+		pr_err("Invalid watchdog CPU %d\n", cpu);
 		return NULL;
 	}
 
-	/* Initialize item in inactive state */
-	INIT_LIST_HEAD(&item->list);
-	item->timeout_ms = timeout_ms;
-	item->start_time = 0;
-	atomic_set(&item->active, 0);     /* Inactive until watchdog_start() */
-	item->recovery_func = recovery_func;
-	item->private_data = private_data;
-	atomic_set(&item->valid, 1);      /* Valid for use */
+	return watchdog_add_to_shard(watchdog_cpu_shard(ctx, cpu),
+				     timeout_ms, recovery_func, private_data,
+				     GFP_KERNEL);
+}
+EXPORT_SYMBOL_GPL(watchdog_add_on_cpu_ctx);
 
-	/* Add to global list under lock protection */
-	spin_lock_irqsave(&g_watchdog_ctx.lock, flags);
-	list_add_tail(&item->list, &g_watchdog_ctx.item_list);
-	spin_unlock_irqrestore(&g_watchdog_ctx.lock, flags);
+/**
+* watchdog_add_batch - Add several watchdog items to one shard at once
+* @ctx: Instance from watchdog_ctx_create(), or NULL for the default instance
+* @cpu: CPU whose shard checks the items, or a negative value for the
+*       calling CPU
+* @init: Array of @n item parameters
+* @n: Number of items
+* @out: Array of @n pointers receiving the new items
+* @gfp: Allocation flags, e.g. GFP_KERNEL
+*
+* Same as calling watchdog_add_on_cpu_ctx() (or watchdog_add_ctx_gfp() for
+* a negative @cpu) for each entry of @init, but allocates all items with one
+* bulk allocation from the item cache, links them under a single acquisition
+* of the shard lock and recomputes the recovery period at most once. Either
+* all items are added or none.
+*
+* Context: Any context allowed by @gfp
+* Return: 0 on success, -ENODEV if the instance is not initialized, -EINVAL
+*         on invalid @cpu or parameters, -ENOMEM on allocation failure, or
+*         BUG() if a timeout is below the minimum of the instance's engine
+*
+* Example:
+* @code
+* struct watchdog_item_init init[MY_NUM_QUEUES];
+*
+* for (i = 0; i < MY_NUM_QUEUES; i++) {
+*     init[i].timeout_ms = 1000;
+*     init[i].recovery_func = queue_recovery;
+*     init[i].private_data = &dev->queues[i];
+* }
+*
+* ret = watchdog_add_batch(dev->wdog_ctx, -1, init, MY_NUM_QUEUES,
+*                          dev->queue_wdogs, GFP_KERNEL);
+* @endcode
+*/
+int watchdog_add_batch(struct watchdog_context *ctx, int cpu,
+		       const struct watchdog_item_init *init, unsigned int n,
+		       struct watchdog_item **out, gfp_t gfp)
+{
+	struct watchdog_shard *shard;
+	unsigned long flags;
+	bool new_min = false;
+	unsigned int i;
 
-	/* Check if we need to start/adjust work period */
-	update_work_period();
+	if (!ctx)
+		ctx = &g_watchdog_ctx;
 
-	return item;
+	if (!ctx->initialized) {
+		pr_err("Watchdog not initialized\n");
+		return -ENODEV;
+	}
+
+	if (!init || !out || !n)
+		return -EINVAL;
+
+	if (cpu < 0) {
+		cpu = raw_smp_processor_id();
+	} else if (cpu >= nr_cpu_ids || !cpu_possible(cpu)) {
+		pr_err("Invalid watchdog CPU %d\n", cpu);
+		return -EINVAL;
+	}
+
+	shard = watchdog_cpu_shard(ctx, cpu);
+
+	for (i = 0; i < n; i++) {
+		if (!watchdog_item_params_valid(shard, init[i].timeout_ms,
+						init[i].recovery_func))
+			return -EINVAL;
+	}
+
+	if (!kmem_cache_alloc_bulk(watchdog_item_cache, gfp, n, (void **)out)) {
+		pr_err("Failed to allocate %u watchdog items\n", n);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < n; i++)
+		watchdog_item_setup(shard, out[i], init[i].timeout_ms,
+				    init[i].recovery_func, init[i].private_data);
+
+	spin_lock_irqsave(&shard->lock, flags);
+	for (i = 0; i < n; i++)
+		new_min |= watchdog_link_item(shard, out[i]);
+	if (new_min)
+		watchdog_set_period(shard);
+	shard->work_active = true;
+	spin_unlock_irqrestore(&shard->lock, flags);
+
+	for (i = 0; i < n; i++)
+		trace_kwatchdog_item_add(out[i], out[i]->timeout_ms);
+
+	return 0;
 }
+EXPORT_SYMBOL_GPL(watchdog_add_batch);
 
 /**
 * watchdog_remove - Remove and free a watchdog item from the monitoring system
@@ -377,9 +1858,14 @@ struct watchdog_item *watchdog_add(unsigned long timeout_ms,
 * After this function returns, the @item pointer becomes invalid and must
 * not be used for any further operations.
 *
+* On instances with WATCHDOG_F_DEFERRED_RECOVERY this waits for a queued or
+* running recovery of @item to finish before freeing it, so it must not be
+* called from the item's own recovery function.
+*
 * Context: Process context (may sleep due to work rescheduling)
 * Return: 0 on success, -ENODEV if watchdog system not initialized,
-*         -EINVAL if @item is NULL or invalid
+*         -EINVAL if @item is NULL or invalid, -EDEADLK if called from the
+*         item's own deferred recovery function
 *
 * Example:
 * @code
@@ -428,23 +1914,30 @@ struct watchdog_item *watchdog_add(unsigned long timeout_ms,
 */
 int watchdog_remove(struct watchdog_item *item)
 {
+	struct watchdog_shard *shard;
 	unsigned long flags;
-
-	if (!g_watchdog_ctx.initialized) {
-		pr_err("Watchdog not initialized\n");
-		return -ENODEV;
-	}
+	bool stop_work;
 
 	if (!item) {
 		pr_err("Invalid watchdog item pointer\n");
 		return -EINVAL;
 	}
 
-	spin_lock_irqsave(&g_watchdog_ctx.lock, flags);
+	if (!item->shard->ctx->initialized) {
+		pr_err("Watchdog not initialized\n");
+		return -ENODEV;
+	}
+
+	/* Waiting for our own recovery work below would never finish */
+	if (WARN_ON(current_work() == &item->recovery_work))
+		return -EDEADLK;
+
+	shard = item->shard;
+	spin_lock_irqsave(&shard->lock, flags);
 
 	/* Verify item is still valid */
 	if (!atomic_read(&item->valid)) {
-		spin_unlock_irqrestore(&g_watchdog_ctx.lock, flags);
+		spin_unlock_irqrestore(&shard->lock, flags);
 		pr_err("Watchdog item %p is invalid\n", item);
 		return -EINVAL;
 	}
@@ -452,19 +1945,123 @@ int watchdog_remove(struct watchdog_item *item)
 	/* Mark invalid first to prevent further use */
 	atomic_set(&item->valid, 0);
 
-	/* Remove from list */
-	list_del(&item->list);
+	/*
+	 * Remove from list and deadline tree. Pending arm requests are
+	 * drained first so the item cannot be left on the arm list.
+	 */
+	watchdog_drain_arm_list(shard);
+	watchdog_dequeue_item(shard, item);
+	stop_work = watchdog_unaccount_item(shard, item);
+
+	spin_unlock_irqrestore(&shard->lock, flags);
 
-	spin_unlock_irqrestore(&g_watchdog_ctx.lock, flags);
+	/* No recovery can be dispatched any more, wait for one in flight */
+	if (shard->ctx->recovery_wq)
+		cancel_work_sync(&item->recovery_work);
+
+	trace_kwatchdog_item_remove(item, item->timeout_ms);
 
 	/* Free memory */
-	kfree(item);
+	kmem_cache_free(watchdog_item_cache, item);
 
-	/* Check if we need to adjust work period or stop work */
-	update_work_period();
+	/* Last item gone: stop the work completely for zero overhead */
+	if (stop_work)
+		watchdog_shard_stop(shard);
 
 	return 0;
 }
+EXPORT_SYMBOL_GPL(watchdog_remove);
+
+/**
+* watchdog_remove_batch - Remove and free several watchdog items at once
+* @items: Array of @n items, NULL entries are skipped
+* @n: Number of entries
+*
+* Same as calling watchdog_remove() for each entry, but each run of
+* consecutive items on the same shard is unlinked under a single
+* acquisition of the shard lock, with one recomputation of the recovery
+* period. Items from watchdog_add_batch() form one run. Entries that were
+* removed are set to NULL; entries that are rejected are left untouched
+* and the error is returned after the other items have been removed.
+*
+* Context: Process context (may sleep due to work rescheduling)
+* Return: 0 on success, -ENODEV if an item's instance is not initialized,
+*         -EINVAL if an item is invalid, -EDEADLK if called from the
+*         deferred recovery function of one of the items (nothing is
+*         removed in that case)
+*/
+int watchdog_remove_batch(struct watchdog_item **items, unsigned int n)
+{
+	struct watchdog_item *item, *tmp;
+	struct watchdog_shard *shard;
+	unsigned long flags;
+	unsigned int i, j;
+	bool stop_work;
+	int ret = 0;
+
+	if (!items)
+		return -EINVAL;
+
+	/* Waiting for our own recovery work below would never finish */
+	for (i = 0; i < n; i++) {
+		if (items[i] && WARN_ON(current_work() == &items[i]->recovery_work))
+			return -EDEADLK;
+	}
+
+	for (i = 0; i < n; i = j) {
+		LIST_HEAD(removed);
+
+		j = i + 1;
+		if (!items[i])
+			continue;
+
+		shard = items[i]->shard;
+		if (!shard->ctx->initialized) {
+			pr_err("Watchdog not initialized\n");
+			ret = -ENODEV;
+			continue;
+		}
+
+		spin_lock_irqsave(&shard->lock, flags);
+
+		watchdog_drain_arm_list(shard);
+		for (j = i; j < n && items[j] && items[j]->shard == shard; j++) {
+			item = items[j];
+
+			if (!atomic_read(&item->valid)) {
+				pr_err("Watchdog item %p is invalid\n", item);
+				ret = -EINVAL;
+				continue;
+			}
+
+			/* Mark invalid and unlink, the period is settled below */
+			atomic_set(&item->valid, 0);
+			watchdog_dequeue_item(shard, item);
+			watchdog_unlink_item(shard, item);
+			list_add_tail(&item->list, &removed);
+			items[j] = NULL;
+		}
+		stop_work = !list_empty(&removed) && watchdog_account_done(shard);
+
+		spin_unlock_irqrestore(&shard->lock, flags);
+
+		list_for_each_entry_safe(item, tmp, &removed, list) {
+			/* No recovery can be dispatched any more, wait for one in flight */
+			if (shard->ctx->recovery_wq)
+				cancel_work_sync(&item->recovery_work);
+
+			trace_kwatchdog_item_remove(item, item->timeout_ms);
+			kmem_cache_free(watchdog_item_cache, item);
+		}
+
+		/* Last item gone: stop the work completely for zero overhead */
+		if (stop_work)
+			watchdog_shard_stop(shard);
+	}
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(watchdog_remove_batch);
 
 /**
 * watchdog_start - Start monitoring a watchdog item (Lock-free operation)
@@ -479,10 +2076,14 @@ int watchdog_remove(struct watchdog_item *item)
 * - First watchdog_start() sets the timeout baseline using current jiffies
 * - Subsequent calls are ignored until watchdog_cancel() is called
 * - To restart timeout counting, must call watchdog_cancel() then watchdog_start()
+* - To extend a running timeout cheaply, use watchdog_kick() instead
 *
 * The operation is lock-free for maximum performance on hot paths, using
 * atomic operations and memory barriers to ensure thread safety. This makes
 * it suitable for use in interrupt contexts and performance-critical code paths.
+* A start that brings the item back into the deadline tree pushes it onto a
+* lock-free arm list and kicks the work with mod_delayed_work(); restarting
+* an item the tree still holds costs no more than before.
 *
 * Once started, the recovery function will be called repeatedly every work
 * period after the timeout expires, until the watchdog is cancelled or removed.
@@ -541,16 +2142,16 @@ int watchdog_remove(struct watchdog_item *item)
 */
 int watchdog_start(struct watchdog_item *item)
 {
-	if (!g_watchdog_ctx.initialized) {
-		pr_err("Watchdog not initialized\n");
-		return -ENODEV;
-	}
-
 	if (!item) {
 		pr_err("Invalid watchdog item pointer\n");
 		return -EINVAL;
 	}
 
+	if (!item->shard->ctx->initialized) {
+		pr_err("Watchdog not initialized\n");
+		return -ENODEV;
+	}
+
 	/* Check if item is still valid (atomic read, no lock needed) */
 	if (!atomic_read(&item->valid)) {
 		pr_err("Watchdog item %p is invalid\n", item);
@@ -563,13 +2164,27 @@ int watchdog_start(struct watchdog_item *item)
 	 * This prevents timeout extension through repeated start calls.
 	 */
 	if (!atomic_read(&item->active)) {
-		item->start_time = jiffies;
+		WRITE_ONCE(item->start_time, watchdog_now(item->shard));
 		smp_wmb(); /* Write memory barrier: start_time before active */
 		atomic_set(&item->active, 1);
+		trace_kwatchdog_item_start(item, item->timeout_ms);
+
+		/*
+		 * Hand the item to the work unless it still owns it (item is in
+		 * the deadline tree from a previous start, its key is refreshed
+		 * lazily). atomic_xchg() is fully ordered against the store to
+		 * active above, see watchdog_release_item(). Kick the work only
+		 * when the arm list goes from empty to non-empty; it will insert
+		 * every pending item and rearm for the earliest deadline.
+		 */
+		if (!atomic_xchg(&item->queued, 1) &&
+		    llist_add(&item->arm_node, &item->shard->arm_list))
+			watchdog_shard_kick(item->shard);
 	}
 
 	return 0;
 }
+EXPORT_SYMBOL_GPL(watchdog_start);
 
 /**
 * watchdog_cancel - Stop monitoring a watchdog item (Lock-free operation)
@@ -650,16 +2265,16 @@ int watchdog_start(struct watchdog_item *item)
 */
 int watchdog_cancel(struct watchdog_item *item)
 {
-	if (!g_watchdog_ctx.initialized) {
-		pr_err("Watchdog not initialized\n");
-		return -ENODEV;
-	}
-
 	if (!item) {
 		pr_err("Invalid watchdog item pointer\n");
 		return -EINVAL;
 	}
 
+	if (!item->shard->ctx->initialized) {
+		pr_err("Watchdog not initialized\n");
+		return -ENODEV;
+	}
+
 	/* Check if item is still valid (atomic read, no lock needed) */
 	if (!atomic_read(&item->valid)) {
 		pr_err("Watchdog item %p is invalid\n", item);
@@ -668,135 +2283,8 @@ int watchdog_cancel(struct watchdog_item *item)
 
 	/* Lock-free cancel operation: simply clear active flag */
 	atomic_set(&item->active, 0);
+	trace_kwatchdog_item_cancel(item, item->timeout_ms);
 
 	return 0;
 }
-
-/**
-* update_work_period - Update work period and start/stop work as needed
-*
-* This internal function calculates the optimal work period by finding the
-* shortest timeout among all valid watchdog items. The work period is set to
-* half the shortest timeout for accurate detection, but clamped to a maximum
-* frequency limit (WATCHDOG_MAX_WORK_PERIOD_MS) to prevent excessive CPU usage.
-*
-* Work scheduling behavior:
-* - If no valid items exist: stop work completely (zero CPU overhead)
-* - If items exist but work stopped: start work with calculated period
-* - If period changed significantly: restart work with new period
-* - If period unchanged: no action (avoid unnecessary work cancellation)
-*
-* The function automatically manages the work lifecycle based on the presence
-* and characteristics of watchdog items. This provides:
-* - Zero overhead when no watchdogs are active
-* - Optimal detection accuracy for the shortest timeout
-* - Protection against excessive CPU usage
-* - Automatic adaptation to changing timeout requirements
-*
-* This function must be called whenever items are added or removed to
-* maintain optimal performance and accuracy. It handles all the complexity
-* of work management internally, requiring no user intervention.
-*
-* Context: Process context (may sleep due to work cancellation)
-*
-* Example behavior:
-* @code
-* // Initially no items - no work running
-* // work_active = false, period_ms = 0
-* 
-* // Add first item with 2000ms timeout
-* watchdog_add(2000, func1, data1);
-* // update_work_period() called automatically
-* // period_ms = 1000ms (2000/2), work starts
-* 
-* // Add item with shorter 800ms timeout  
-* watchdog_add(800, func2, data2);
-* // update_work_period() called automatically
-* // period_ms = 400ms (800/2), work rescheduled
-* 
-* // Add item with very short 50ms timeout
-* watchdog_add(50, func3, data3);  // This would BUG() - too short
-* 
-* // Add item with 120ms timeout (above minimum)
-* watchdog_add(120, func3, data3);
-* // update_work_period() called automatically
-* // period_ms = 50ms (clamped to WATCHDOG_MAX_WORK_PERIOD_MS)
-* 
-* // Remove the 120ms item
-* watchdog_remove(item3);
-* // update_work_period() called automatically
-* // period_ms = 400ms (back to 800/2), work rescheduled
-* 
-* // Remove all items
-* watchdog_remove(item1);
-* watchdog_remove(item2);
-* // update_work_period() called automatically
-* // work_active = false, period_ms = 0, zero overhead achieved
-* @endcode
-*/
-static void update_work_period(void)
-{
-	struct watchdog_item *item;
-	unsigned long flags;
-	unsigned long min_timeout = ULONG_MAX;
-	unsigned long new_period;
-	bool has_items = false;
-	bool period_changed = false;
-
-	if (!g_watchdog_ctx.initialized) {
-		return;
-	}
-
-	spin_lock_irqsave(&g_watchdog_ctx.lock, flags);
-
-	/* Find the shortest timeout among all valid items */
-	list_for_each_entry(item, &g_watchdog_ctx.item_list, list) {
-		if (atomic_read(&item->valid)) {
-			has_items = true;
-			if (item->timeout_ms < min_timeout) {
-				min_timeout = item->timeout_ms;
-			}
-		}
-	}
-
-	if (has_items) {
-		/*
-		 * Calculate new period: use min_timeout/2 for better accuracy,
-		 * but clamp to WATCHDOG_MAX_WORK_PERIOD_MS to prevent overload
-		 */
-		new_period = max(min_timeout / 2, (unsigned long)WATCHDOG_MAX_WORK_PERIOD_MS);
-
-		/* Check if period changed significantly to avoid thrashing */
-		if (new_period != g_watchdog_ctx.period_ms) {
-			period_changed = true;
-			g_watchdog_ctx.period_ms = new_period;
-		}
-
-		/* Start work if not already running */
-		if (!g_watchdog_ctx.work_active) {
-			g_watchdog_ctx.work_active = true;
-			spin_unlock_irqrestore(&g_watchdog_ctx.lock, flags);
-
-			schedule_delayed_work(&g_watchdog_ctx.work, msecs_to_jiffies(new_period));
-		} else if (period_changed) {
-			spin_unlock_irqrestore(&g_watchdog_ctx.lock, flags);
-
-			/* Cancel current work and reschedule with new period */
-			cancel_delayed_work(&g_watchdog_ctx.work);
-			schedule_delayed_work(&g_watchdog_ctx.work, msecs_to_jiffies(new_period));
-		} else {
-			spin_unlock_irqrestore(&g_watchdog_ctx.lock, flags);
-		}
-	} else {
-		/* No valid items, stop the work completely for zero overhead */
-		if (g_watchdog_ctx.work_active) {
-			g_watchdog_ctx.work_active = false;
-			g_watchdog_ctx.period_ms = 0;
-			spin_unlock_irqrestore(&g_watchdog_ctx.lock, flags);
-
-			cancel_delayed_work(&g_watchdog_ctx.work);
-		} else {
-			spin_unlock_irqrestore(&g_watchdog_ctx.lock, flags);
-		}
-	}
-}
\ No newline at end of file
+EXPORT_SYMBOL_GPL(watchdog_cancel);
@@ -13,10 +13,21 @@
 #define __KERNEL_WATCHDOG_H__
 
 #include <linux/atomic.h>
+#include <linux/bitops.h>
+#include <linux/compiler.h>
+#include <linux/hrtimer.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/llist.h>
+#include <linux/percpu.h>
+#include <linux/rbtree.h>
 #include <linux/types.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
+struct dentry;
+
 /**
 * WATCHDOG_MIN_TIMEOUT_MS - Minimum allowed watchdog timeout value
 *
@@ -60,15 +71,129 @@
  */
 #define WATCHDOG_MAX_WORK_PERIOD_MS (WATCHDOG_MIN_TIMEOUT_MS / 2)
 
+/**
+ * WATCHDOG_HR_MIN_TIMEOUT_MS - Minimum timeout of a WATCHDOG_F_HRTIMER instance
+ *
+ * The hrtimer engine is armed for the earliest deadline only and never runs
+ * periodically, so it can detect timeouts well below
+ * WATCHDOG_MIN_TIMEOUT_MS without the CPU cost a fast periodic check would
+ * have. The limit still protects against recovery storms: an expired item
+ * is retried every half timeout, i.e. at most every
+ * WATCHDOG_HR_MAX_WORK_PERIOD_MS.
+ */
+#define WATCHDOG_HR_MIN_TIMEOUT_MS  10
+
+/**
+ * WATCHDOG_HR_MAX_WORK_PERIOD_MS - Shortest recovery period of the hrtimer engine
+ */
+#define WATCHDOG_HR_MAX_WORK_PERIOD_MS (WATCHDOG_HR_MIN_TIMEOUT_MS / 2)
+
+/**
+ * WATCHDOG_TIMEOUT_BUCKETS - Number of timeout buckets per shard
+ *
+ * Items of a shard are kept in buckets indexed by ilog2(timeout_ms), so
+ * bucket 'b' holds timeouts in [2^b, 2^(b+1)) milliseconds. One bucket per
+ * bit of an unsigned long covers every possible timeout and lets a single
+ * word serve as the map of non-empty buckets.
+ */
+#define WATCHDOG_TIMEOUT_BUCKETS BITS_PER_LONG
+
+/**
+ * WATCHDOG_F_PERCPU - Create one watchdog shard per possible CPU
+ *
+ * Flag for watchdog_init_flags() and watchdog_ctx_create(). Each shard has its own item list,
+ * deadline tree, lock and delayed work, and the work is queued on the
+ * shard's CPU while that CPU is online. watchdog_add() places an item on
+ * the shard of the calling CPU and watchdog_add_on_cpu() on an explicit
+ * one, so drivers can keep a watchdog next to the IRQ or queue that kicks
+ * it. Add and remove only take the lock of the item's shard.
+ *
+ * Without this flag a single shard serves every CPU.
+ */
+#define WATCHDOG_F_PERCPU           0x1
+
+/**
+ * WATCHDOG_F_DEFERRED_RECOVERY - Run recovery functions off the scan path
+ *
+ * Flag for watchdog_init_flags() and watchdog_ctx_create(). Instead of
+ * dropping the shard lock and calling each expired item's recovery function
+ * inline, the scan queues the item's recovery work on a workqueue owned by
+ * the instance and moves on, so one slow recovery never delays timeout
+ * detection of the other items and the lock is held across the whole scan.
+ *
+ * A recovery that is still queued or running when the item expires again is
+ * not queued a second time; the call for that period is coalesced into the
+ * one in flight.
+ *
+ * With this flag watchdog_remove() waits for an in-flight recovery of the
+ * item and therefore has to be called from process context, and a recovery
+ * function must not remove its own item.
+ */
+#define WATCHDOG_F_DEFERRED_RECOVERY 0x2
+
+/**
+ * WATCHDOG_F_HIGHPRI_RECOVERY - Run deferred recovery on a high-priority workqueue
+ *
+ * Implies WATCHDOG_F_DEFERRED_RECOVERY. The instance's recovery workqueue
+ * is created with WQ_HIGHPRI in addition to WQ_UNBOUND, for recoveries that
+ * must not wait behind normal-priority work.
+ */
+#define WATCHDOG_F_HIGHPRI_RECOVERY 0x4
+
+/**
+ * WATCHDOG_F_HRTIMER - Use the high-resolution timer engine
+ *
+ * Flag for watchdog_init_flags() and watchdog_ctx_create(). Each shard is
+ * driven by an hrtimer armed for its earliest deadline instead of a
+ * jiffies-based delayed work, and start times and deadlines are kept in
+ * microseconds. This allows timeouts down to WATCHDOG_HR_MIN_TIMEOUT_MS,
+ * e.g. for firmware handshakes.
+ *
+ * The timer callback runs in softirq context and only queues recovery work,
+ * so this flag implies WATCHDOG_F_DEFERRED_RECOVERY. Timers are not pinned:
+ * a per-CPU shard's timer fires on the CPU that last armed it.
+ *
+ * On 32-bit systems the microsecond time base wraps after about 71
+ * minutes, so timeouts of such instances must stay well below half that.
+ */
+#define WATCHDOG_F_HRTIMER          0x8
+
+/**
+ * WATCHDOG_F_COALESCE - Batch watchdog wakeups with other timers
+ *
+ * Flag for watchdog_init_flags() and watchdog_ctx_create(), for battery
+ * powered or power-capped systems. The shards' work becomes deferrable, so
+ * it does not wake an idle CPU on its own, and every wakeup is moved up to
+ * the next multiple of WATCHDOG_MAX_WORK_PERIOD_MS in absolute jiffies. Other
+ * tickers aligned the same way (the state watcher and traffic monitor
+ * coalesce modes) then expire together instead of at unrelated times.
+ *
+ * Timeouts are detected up to WATCHDOG_MAX_WORK_PERIOD_MS late, or later
+ * while the CPU stays idle. With WATCHDOG_F_HRTIMER the timer is instead
+ * given WATCHDOG_HR_MAX_WORK_PERIOD_MS of slack.
+ */
+#define WATCHDOG_F_COALESCE         0x10
+
+struct watchdog_shard;
+
 /**
 * struct watchdog_item - Individual watchdog timer entry
-* @list: List head for linking into the global watchdog list
+* @list: List head for linking into the owning shard's item list
+* @shard: Shard this item belongs to, fixed for the lifetime of the item
+* @node: Node in the deadline-ordered tree, owned by the work function
+* @arm_node: Lock-free link used by watchdog_start() to hand the item to the work
+* @deadline: Tree key in the shard's time base, only meaningful while in the tree
 * @timeout_ms: Timeout value in milliseconds, must be >= WATCHDOG_MIN_TIMEOUT_MS
-* @start_time: Start time recorded in jiffies when watchdog_start() is called
+* @start_time: Start time in the shard's time base (jiffies, or microseconds for
+*              WATCHDOG_F_HRTIMER), set by watchdog_start() and watchdog_kick()
+* @hires: Item belongs to a WATCHDOG_F_HRTIMER instance
 * @active: Atomic flag indicating if this watchdog is actively being monitored
+* @queued: Atomic flag set while the item sits in @arm_node's list or in the tree
 * @recovery_func: Function pointer to call when timeout occurs
 * @private_data: Opaque pointer passed to recovery function, can be NULL
 * @valid: Atomic flag for safe memory management and use-after-free prevention
+* @recovery_work: Work running @recovery_func with WATCHDOG_F_DEFERRED_RECOVERY
+* @recovery_pending: Atomic flag set while @recovery_work is queued or running
 *
 * This structure represents a single watchdog timer instance. Each watchdog
 * item can be independently started, cancelled, and removed from the monitoring
@@ -79,11 +204,19 @@
 * use-after-free scenarios when an item is being removed while other threads
 * might still hold references to it.
 *
+* The @node/@deadline pair is only touched under the context lock. Keys are
+* refreshed lazily: when an item reaches the front of the tree, its real
+* deadline is recomputed from @start_time and @timeout_ms, so a cancel or a
+* restart never has to take the lock to reposition the item. @queued tells
+* watchdog_start() whether the work function already owns the item; only an
+* item that is neither queued nor in the tree is pushed onto the arm list.
+*
 * Lifecycle:
 * 1. Created via watchdog_add() in inactive state (@active = 0)
 * 2. Activated via watchdog_start() which sets @start_time and @active = 1
-* 3. Can be deactivated via watchdog_cancel() which sets @active = 0
-* 4. Destroyed via watchdog_remove() which sets @valid = 0 and frees memory
+* 3. Can be fed via watchdog_kick() which moves @start_time to now
+* 4. Can be deactivated via watchdog_cancel() which sets @active = 0
+* 5. Destroyed via watchdog_remove() which sets @valid = 0 and frees memory
 *
 * The @recovery_func is called repeatedly every work period after timeout
 * occurs, until the watchdog is cancelled or removed. This allows for
@@ -110,55 +243,144 @@
 */
 struct watchdog_item {
    struct list_head list;
+   struct watchdog_shard *shard;
+   struct rb_node node;               /* Deadline tree, under ctx lock */
+   struct llist_node arm_node;        /* Lock-free hand-off to the work */
+   unsigned long deadline;            /* Tree key (jiffies) */
    unsigned long timeout_ms;
    unsigned long start_time;
+   bool hires;                        /* Time base is microseconds */
    atomic_t active;                   /* Lock-free active state */
+   atomic_t queued;                   /* Owned by arm list or tree */
    void (*recovery_func)(void *data);
    void *private_data;
    atomic_t valid;                    /* Lock-free validity flag */
+   struct work_struct recovery_work;
+   atomic_t recovery_pending;         /* Deferred recovery in flight */
+};
+
+/**
+* struct watchdog_item_init - Parameters of one item for watchdog_add_batch()
+* @timeout_ms: Timeout value in milliseconds (must be >= WATCHDOG_MIN_TIMEOUT_MS)
+* @recovery_func: Function to call when timeout occurs (must not be NULL)
+* @private_data: Opaque pointer passed to recovery function (can be NULL)
+*/
+struct watchdog_item_init {
+   unsigned long timeout_ms;
+   void (*recovery_func)(void *data);
+   void *private_data;
 };
 
 /**
-* struct watchdog_context - Global watchdog system context
-* @work: Delayed work structure for periodic timeout checking
-* @item_list: Head of the list containing all watchdog items
-* @lock: Spinlock protecting list operations (add/remove/traverse)
-* @period_ms: Current work execution period in milliseconds
-* @initialized: Flag indicating if the watchdog system is initialized
-* @work_active: Flag indicating if the periodic work is currently scheduled
+ * WATCHDOG_STATS_HIST_BUCKETS - Number of buckets of the stats histograms
+ *
+ * Histogram bucket 'b' counts samples in [2^b, 2^(b+1)) units, bucket 0 also
+ * counts zero and the last bucket counts everything above.
+ */
+#define WATCHDOG_STATS_HIST_BUCKETS 24
+
+/**
+* struct watchdog_stats - Per-shard instrumentation counters
+* @syncp: Lets readers take a consistent snapshot without the shard lock
+* @scans: Number of deadline tree scans
+* @items_scanned: Number of tree nodes handled by all scans
+* @max_items_scanned: Largest number of tree nodes handled by one scan
+* @expirations: Number of timeouts detected (including repeated ones)
+* @lock_hold_ns: Histogram of scan lock hold times in nanoseconds
+* @lateness_us: Histogram of detection lateness (now - deadline) in microseconds
+*
+* Only updated by the scan with the shard lock held, inside @syncp write
+* sections. The debugfs "stats" file reads them lock-free and sums the
+* shards of an instance.
+*/
+struct watchdog_stats {
+   struct u64_stats_sync syncp;
+   u64 scans;
+   u64 items_scanned;
+   u64 max_items_scanned;
+   u64 expirations;
+   u64 lock_hold_ns[WATCHDOG_STATS_HIST_BUCKETS];
+   u64 lateness_us[WATCHDOG_STATS_HIST_BUCKETS];
+};
+
+/**
+* struct watchdog_recovery_stats - Per-CPU recovery counters of an instance
+* @recoveries: Number of recovery function calls
+* @recovery_us: Histogram of recovery function run times in microseconds
+*
+* Recovery functions run outside the shard lock and, when deferred, on any
+* CPU of an unbound workqueue, so these are counted per CPU instead of in
+* a shared cache line.
+*/
+struct watchdog_recovery_stats {
+   unsigned long recoveries;
+   unsigned long recovery_us[WATCHDOG_STATS_HIST_BUCKETS];
+};
+
+/**
+* struct watchdog_shard - Independent slice of the watchdog system
+* @work: Delayed work structure for deadline-driven timeout checking
+* @timer: hrtimer used instead of @work with WATCHDOG_F_HRTIMER
+* @item_buckets: Lists of all watchdog items of this shard, by ilog2(timeout_ms)
+* @bucket_map: Bitmap of non-empty @item_buckets
+* @min_timeout_ms: Shortest timeout among the shard's items
+* @min_count: Number of items whose timeout equals @min_timeout_ms
+* @nr_items: Number of items in the shard
+* @deadline_tree: Items ordered by deadline, leftmost is the next to expire
+* @arm_list: Lock-free list of items started since the last tree update
+* @lock: Spinlock protecting list and tree operations (add/remove/traverse)
+* @period_ms: Recovery repeat interval in milliseconds
+* @work_active: Flag indicating that items exist and the work may be armed
+* @cpu: CPU the work is queued on, or WORK_CPU_UNBOUND
+* @ctx: Context this shard belongs to
+* @stats: Instrumentation counters, see struct watchdog_stats
+*
+* A shard owns a set of watchdog items and everything needed to check them.
+* Shards never share state, so operations on items of different shards never
+* contend with each other.
 *
-* This structure maintains the global state of the watchdog system. There is
-* only one instance of this structure per system, managing all watchdog items
-* in a centralized manner.
+* The @work is armed for the earliest deadline in @deadline_tree rather than
+* on a fixed period, so each run only touches the items that actually expired
+* (plus items whose lazily-kept key turned out to be stale). When the tree is
+* empty the work is not rearmed at all, giving zero CPU overhead. The
+* @period_ms is calculated as half of the shortest timeout among all valid
+* items of the shard, clamped to WATCHDOG_MAX_WORK_PERIOD_MS, and is the
+* interval at which an expired item's recovery function is called again.
 *
-* The @work is scheduled on-demand based on the presence of active watchdog
-* items. When no items exist, the work is completely stopped to achieve zero
-* CPU overhead. The @period_ms is dynamically calculated as half of the
-* shortest timeout among all valid items, but clamped to prevent excessive
-* CPU usage.
+* The shortest timeout is tracked incrementally: adding an item is O(1), and
+* so is removing one unless it was the last item at @min_timeout_ms, in which
+* case only the lowest non-empty bucket is scanned for the new minimum. The
+* @period_ms is only recomputed when the minimum actually moves.
 *
-* The @lock protects only list structure modifications (add/remove operations
-* and list traversal during timeout checking). The hot-path operations
-* (start/cancel) are lock-free using atomic operations on individual items.
+* The @lock protects list and tree modifications (add/remove operations and
+* the expiry walk). The hot-path operations (start/cancel) are lock-free:
+* watchdog_start() pushes a newly started item onto @arm_list and kicks the
+* work, which moves it into @deadline_tree under the lock.
 *
 * Work scheduling behavior:
-* - @work_active = false: No work scheduled, zero CPU overhead
-* - @work_active = true: Work running with current @period_ms interval
-* - Period automatically adjusts when items with shorter timeouts are added
+* - @work_active = false: No items, no work scheduled, zero CPU overhead
+* - @work_active = true: Work armed for the earliest deadline, if any
+* - Starting an item that is not yet in the tree kicks the work immediately
 * - Work stops automatically when the last item is removed
+* - Work of a per-CPU shard runs on @cpu while it is online, and on any
+*   CPU otherwise
 *
 * Example:
 * @code
 * // System initialization
 * watchdog_init();
 * 
-* // Adding first item starts the work automatically
+* // Adding first item enables the work
 * struct watchdog_item *wdog1 = watchdog_add(2000, recovery_func1, dev1);
 * // period_ms = 1000ms (2000/2), work_active = true
 * 
-* // Adding shorter timeout adjusts the period
+* // Starting the item arms the work for its deadline
+* watchdog_start(wdog1);
+* // work runs once now + 2000ms, not every period_ms
+* 
+* // Adding shorter timeout adjusts the recovery repeat period
 * struct watchdog_item *wdog2 = watchdog_add(500, recovery_func2, dev2);
-* // period_ms = 250ms (500/2), work rescheduled with new period
+* // period_ms = 250ms (500/2)
 * 
 * // Removing all items stops the work
 * watchdog_remove(wdog1);
@@ -166,13 +388,70 @@ struct watchdog_item {
 * // work_active = false, period_ms = 0, zero CPU overhead
 * @endcode
 */
-struct watchdog_context {
+struct watchdog_shard {
    struct delayed_work work;
-   struct list_head item_list;
-   spinlock_t lock;                   /* Protects list operations only */
+   struct hrtimer timer;              /* WATCHDOG_F_HRTIMER engine */
+   struct list_head item_buckets[WATCHDOG_TIMEOUT_BUCKETS];
+   unsigned long bucket_map;          /* Non-empty item_buckets */
+   unsigned long min_timeout_ms;
+   unsigned int min_count;            /* Items at min_timeout_ms */
+   unsigned int nr_items;
+   struct rb_root_cached deadline_tree;
+   struct llist_head arm_list;
+   spinlock_t lock;                   /* Protects list and tree */
    unsigned long period_ms;
-   bool initialized;
    bool work_active;                  /* On-demand work scheduling */
+   int cpu;
+   struct watchdog_context *ctx;
+   struct watchdog_stats stats;
+};
+
+/**
+* struct watchdog_context - Watchdog instance context
+* @shard: Shard used when the context is not per-CPU
+* @shards: Per-CPU shards when WATCHDOG_F_PERCPU is set, NULL otherwise
+* @wq: Workqueue the shards' work is queued on (system_wq by default)
+* @recovery_wq: Workqueue for deferred recovery, NULL unless
+*               WATCHDOG_F_DEFERRED_RECOVERY is set
+* @flags: WATCHDOG_F_* flags given at initialization
+* @recovery_stats: Per-CPU recovery counters
+* @debugfs_dir: Directory of the instance under <debugfs>/kwatchdog/
+* @initialized: Flag indicating if the watchdog context is initialized
+*
+* This structure maintains the state of one watchdog instance. Instances are
+* fully independent: each has its own shards, recovery periods and work, so a
+* consumer with short timeouts never shortens the recovery period of another
+* consumer's items, and each instance can be bound to its own workqueue.
+*
+* A default instance backs the legacy watchdog_init()/watchdog_add() API.
+* Further instances are created with watchdog_ctx_create() and used through
+* watchdog_add_ctx()/watchdog_add_on_cpu_ctx(). watchdog_start(),
+* watchdog_cancel() and watchdog_remove() work on items of any instance.
+*
+* All items either live in the embedded @shard, or, with WATCHDOG_F_PERCPU,
+* in the shard of the CPU they were added on.
+*
+* Example:
+* @code
+* // Slow link-level watchdogs on their own instance and workqueue
+* link_wq = alloc_workqueue("my_link_wdog", WQ_UNBOUND, 0);
+* link_ctx = watchdog_ctx_create(0, link_wq);
+* dev->link_wdog = watchdog_add_ctx(link_ctx, 10000, link_recovery, dev);
+* 
+* // Per-queue watchdogs, one shard per CPU, on the default instance
+* watchdog_init_flags(WATCHDOG_F_PERCPU);
+* q->wdog = watchdog_add_on_cpu(q->irq_cpu, 1000, queue_recovery, q);
+* @endcode
+*/
+struct watchdog_context {
+   struct watchdog_shard shard;
+   struct watchdog_shard __percpu *shards;
+   struct workqueue_struct *wq;
+   struct workqueue_struct *recovery_wq;
+   unsigned int flags;
+   struct watchdog_recovery_stats __percpu *recovery_stats;
+   struct dentry *debugfs_dir;
+   bool initialized;
 };
 
 /**
@@ -180,6 +459,11 @@ struct watchdog_context {
  */
 int watchdog_init(void);
 
+/**
+ * watchdog_init_flags() - Initialize the watchdog system with WATCHDOG_F_* flags
+ */
+int watchdog_init_flags(unsigned int flags);
+
 /**
  * watchdog_deinit() - Deinitialize and cleanup the watchdog system
  */
@@ -192,11 +476,65 @@ struct watchdog_item *watchdog_add(unsigned long timeout_ms,
    			   void (*recovery_func)(void *data),
    			   void *private_data);
 
+/**
+ * watchdog_add_on_cpu() - Add a new watchdog item to the shard of a given CPU
+ */
+struct watchdog_item *watchdog_add_on_cpu(int cpu, unsigned long timeout_ms,
+   				  void (*recovery_func)(void *data),
+   				  void *private_data);
+
+/**
+ * watchdog_ctx_create() - Create an independent watchdog instance
+ */
+struct watchdog_context *watchdog_ctx_create(unsigned int flags,
+   					     struct workqueue_struct *wq);
+
+/**
+ * watchdog_ctx_destroy() - Destroy a watchdog instance and free all of its items
+ */
+void watchdog_ctx_destroy(struct watchdog_context *ctx);
+
+/**
+ * watchdog_add_ctx() - Add a new watchdog item to a given instance
+ */
+struct watchdog_item *watchdog_add_ctx(struct watchdog_context *ctx,
+   				       unsigned long timeout_ms,
+   				       void (*recovery_func)(void *data),
+   				       void *private_data);
+
+/**
+ * watchdog_add_ctx_gfp() - Add a new watchdog item with explicit allocation flags
+ */
+struct watchdog_item *watchdog_add_ctx_gfp(struct watchdog_context *ctx,
+   					   unsigned long timeout_ms,
+   					   void (*recovery_func)(void *data),
+   					   void *private_data, gfp_t gfp);
+
+/**
+ * watchdog_add_on_cpu_ctx() - Add a new watchdog item to a CPU's shard of a given instance
+ */
+struct watchdog_item *watchdog_add_on_cpu_ctx(struct watchdog_context *ctx, int cpu,
+   					      unsigned long timeout_ms,
+   					      void (*recovery_func)(void *data),
+   					      void *private_data);
+
+/**
+ * watchdog_add_batch() - Add several watchdog items to one shard at once
+ */
+int watchdog_add_batch(struct watchdog_context *ctx, int cpu,
+   		       const struct watchdog_item_init *init, unsigned int n,
+   		       struct watchdog_item **out, gfp_t gfp);
+
 /**
  * watchdog_remove() - Remove and free a watchdog item from monitoring
  */
 int watchdog_remove(struct watchdog_item *item);
 
+/**
+ * watchdog_remove_batch() - Remove and free several watchdog items at once
+ */
+int watchdog_remove_batch(struct watchdog_item **items, unsigned int n);
+
 /**
  * watchdog_start() - Start monitoring a watchdog item (lock-free)
  */
@@ -207,4 +545,56 @@ int watchdog_start(struct watchdog_item *item);
  */
 int watchdog_cancel(struct watchdog_item *item);
 
+/**
+ * watchdog_hr_now - Current time in the hrtimer engine's time base
+ *
+ * Return: CLOCK_MONOTONIC time in microseconds, truncated to unsigned long
+ */
+static inline unsigned long watchdog_hr_now(void)
+{
+   return (unsigned long)ktime_to_us(ktime_get());
+}
+
+/**
+* watchdog_kick - Feed an active watchdog item (hot-path, lock-free)
+* @item: Started watchdog item
+*
+* Publishes "alive now" by moving @item's start time to the current jiffies
+* (microseconds for WATCHDOG_F_HRTIMER instances) with a single store: no
+* atomic read-modify-write, no barrier, no lock and no work kick. Unlike
+* watchdog_start(), which never extends a running timeout, this pushes the
+* expiry out to now + timeout, making it the cheap way to pet a watchdog on
+* every successful completion.
+*
+* The scan picks the new time up lazily: when the item reaches the front of
+* the deadline tree its deadline is recomputed from the start time, and an
+* item that is fed in time is just re-keyed. Feeding an item that already
+* expired stops its recovery calls from the next scan on.
+*
+* Kicking an item that is not started has no effect: the store is skipped
+* (a plain load of the active flag), and watchdog_start() sets its own start
+* time. The caller must own a reference to @item (it must not race with
+* watchdog_remove()), and no validity checks are done here.
+*
+* Context: Any context (atomic, interrupt-safe, lock-free)
+*
+* Example:
+* @code
+* static int my_napi_poll(struct napi_struct *napi, int budget)
+* {
+*     struct my_queue *q = container_of(napi, struct my_queue, napi);
+*     int done = my_clean_tx_ring(q, budget);
+*
+*     if (done)
+*         watchdog_kick(q->wdog);  // Completions seen, queue is alive
+*     ...
+* }
+* @endcode
+*/
+static inline void watchdog_kick(struct watchdog_item *item)
+{
+   if (atomic_read(&item->active))
+      WRITE_ONCE(item->start_time, item->hires ? watchdog_hr_now() : jiffies);
+}
+
 #endif /* __KERNEL_WATCHDOG_H__ */
\ No newline at end of file
@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Kernel Watchdog Library Tracepoints
+ *
+ * Item lifecycle, expiry and recovery events of the watchdog library, under
+ * events/kwatchdog/ in tracefs. The trace header lives next to watchdog.c,
+ * so the object needs the source directory on its include path
+ * (CFLAGS_watchdog.o := -I$(src)).
+ *
+ * Copyright (C) 2025 Dujeong Lee <dujeong.lee82@gmail.com>
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kwatchdog
+
+#if !defined(_WATCHDOG_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _WATCHDOG_TRACE_H
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(kwatchdog_item,
+
+	TP_PROTO(const void *item, unsigned long timeout_ms),
+
+	TP_ARGS(item, timeout_ms),
+
+	TP_STRUCT__entry(
+		__field(const void *, item)
+		__field(unsigned long, timeout_ms)
+	),
+
+	TP_fast_assign(
+		__entry->item = item;
+		__entry->timeout_ms = timeout_ms;
+	),
+
+	TP_printk("item=%p timeout_ms=%lu", __entry->item, __entry->timeout_ms)
+);
+
+DEFINE_EVENT(kwatchdog_item, kwatchdog_item_add,
+	TP_PROTO(const void *item, unsigned long timeout_ms),
+	TP_ARGS(item, timeout_ms)
+);
+
+DEFINE_EVENT(kwatchdog_item, kwatchdog_item_remove,
+	TP_PROTO(const void *item, unsigned long timeout_ms),
+	TP_ARGS(item, timeout_ms)
+);
+
+DEFINE_EVENT(kwatchdog_item, kwatchdog_item_start,
+	TP_PROTO(const void *item, unsigned long timeout_ms),
+	TP_ARGS(item, timeout_ms)
+);
+
+DEFINE_EVENT(kwatchdog_item, kwatchdog_item_cancel,
+	TP_PROTO(const void *item, unsigned long timeout_ms),
+	TP_ARGS(item, timeout_ms)
+);
+
+DEFINE_EVENT(kwatchdog_item, kwatchdog_recovery_begin,
+	TP_PROTO(const void *item, unsigned long timeout_ms),
+	TP_ARGS(item, timeout_ms)
+);
+
+TRACE_EVENT(kwatchdog_item_expire,
+
+	TP_PROTO(const void *item, unsigned long timeout_ms, u64 lateness_us),
+
+	TP_ARGS(item, timeout_ms, lateness_us),
+
+	TP_STRUCT__entry(
+		__field(const void *, item)
+		__field(unsigned long, timeout_ms)
+		__field(u64, lateness_us)
+	),
+
+	TP_fast_assign(
+		__entry->item = item;
+		__entry->timeout_ms = timeout_ms;
+		__entry->lateness_us = lateness_us;
+	),
+
+	TP_printk("item=%p timeout_ms=%lu lateness_us=%llu",
+		  __entry->item, __entry->timeout_ms, __entry->lateness_us)
+);
+
+TRACE_EVENT(kwatchdog_recovery_end,
+
+	TP_PROTO(const void *item, u64 duration_ns),
+
+	TP_ARGS(item, duration_ns),
+
+	TP_STRUCT__entry(
+		__field(const void *, item)
+		__field(u64, duration_ns)
+	),
+
+	TP_fast_assign(
+		__entry->item = item;
+		__entry->duration_ns = duration_ns;
+	),
+
+	TP_printk("item=%p duration_ns=%llu", __entry->item, __entry->duration_ns)
+);
+
+#endif /* _WATCHDOG_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE watchdog_trace
+#include <trace/define_trace.h>
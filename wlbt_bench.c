@@ -0,0 +1,747 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * WLBT Monitoring Benchmark and Stress Module
+ *
+ * Loading wlbt_bench.ko runs a fixed set of workloads against the libraries
+ * of wlbt_monitoring.ko and prints the results to the kernel log, so that
+ * changes to the watchdog, state watcher and traffic monitor engines can be
+ * compared against a baseline on the same machine:
+ *
+ * - watchdog: nr_items watchdogs on one instance, watchdog_start() /
+ *   watchdog_cancel() from nr_threads CPUs; then nr_items watchdogs that
+ *   are left to expire, measuring how late recovery is called
+ * - state_watcher: nr_items polled items on one watcher, probe lateness and
+ *   pass duration, while nr_threads CPUs hammer state_watcher_add_item() /
+ *   state_watcher_remove_item()
+ * - traffic_monitor: nr_netdevs dummy devices with synthetic counters,
+ *   netdevice_stats_delta() / netdevice_stats_delta_ifindex() from
+ *   nr_threads CPUs
+ *
+ * Each stress phase reports the throughput of every operation and a log2
+ * histogram of its latency as percentiles. The module stays loaded after
+ * the run, keeping its watchdog instance, traffic monitor and dummy devices,
+ * so the libraries' own debugfs statistics can be read (watchdog scan lock
+ * hold time and lateness in <debugfs>/kwatchdog/, sampler pass duration in
+ * <debugfs>/traffic_monitor/stats); unloading it cleans them up.
+ *
+ * The benchmark initializes the state watcher and traffic monitor itself,
+ * so it must not be loaded together with another user of the traffic
+ * monitor, such as wlbt_kunit.ko. The dummy devices are only monitored
+ * when the "devices" parameter of wlbt_monitoring.ko selects them:
+ *
+ *   modprobe wlbt_monitoring devices='wlbtb*'
+ *   insmod wlbt_bench.ko nr_threads=8 duration_ms=2000
+ *   dmesg | grep wlbt_bench
+ */
+
+#define pr_fmt(fmt) "wlbt_bench: " fmt
+
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/delay.h>
+#include <linux/errno.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/netdevice.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+#include "state_watcher.h"
+#include "traffic_monitor.h"
+#include "watchdog.h"
+#include "wlbt_test_netdev.h"
+
+static unsigned int nr_items = 1024;
+module_param(nr_items, uint, 0444);
+MODULE_PARM_DESC(nr_items, "Watchdogs and watch items per phase (default: 1024)");
+
+static unsigned int nr_threads;
+module_param(nr_threads, uint, 0444);
+MODULE_PARM_DESC(nr_threads, "Stress threads, one per CPU, 0 for all online CPUs (default: 0)");
+
+static unsigned int duration_ms = 1000;
+module_param(duration_ms, uint, 0444);
+MODULE_PARM_DESC(duration_ms, "Duration of each stress phase in ms (default: 1000)");
+
+static unsigned int nr_netdevs = 4;
+module_param(nr_netdevs, uint, 0444);
+MODULE_PARM_DESC(nr_netdevs, "Dummy devices for the traffic monitor phase (default: 4)");
+
+static unsigned int wdog_flags;
+module_param(wdog_flags, uint, 0444);
+MODULE_PARM_DESC(wdog_flags, "WATCHDOG_F_* flags of the benchmark instance (default: 0)");
+
+static unsigned int wdog_timeout_ms = WATCHDOG_MIN_TIMEOUT_MS;
+module_param(wdog_timeout_ms, uint, 0444);
+MODULE_PARM_DESC(wdog_timeout_ms, "Timeout of the watchdogs of the lateness phase (default: 200)");
+
+static unsigned int sw_interval_ms = 100;
+module_param(sw_interval_ms, uint, 0444);
+MODULE_PARM_DESC(sw_interval_ms, "Interval of the polled watch items (default: 100)");
+
+#define BENCH_TEST_WATCHDOG	0x1
+#define BENCH_TEST_STATE	0x2
+#define BENCH_TEST_TRAFFIC	0x4
+
+static unsigned int tests = BENCH_TEST_WATCHDOG | BENCH_TEST_STATE | BENCH_TEST_TRAFFIC;
+module_param(tests, uint, 0444);
+MODULE_PARM_DESC(tests, "Phases to run: 1 watchdog, 2 state watcher, 4 traffic monitor (default: 7)");
+
+/*
+ * Bucket i of a histogram counts values in [2^i, 2^(i+1)), bucket 0 also
+ * counts zero and the last bucket everything above.
+ */
+#define BENCH_HIST_BUCKETS	32
+
+/**
+ * struct bench_hist - Operation count and latency histogram
+ * @ops: Operations done
+ * @buckets: log2 histogram of the latencies in ns (or us, see users)
+ */
+struct bench_hist {
+	u64 ops;
+	u64 buckets[BENCH_HIST_BUCKETS];
+};
+
+/* Operations timed by one stress thread, see struct bench_phase */
+#define BENCH_MAX_OPS		2
+
+struct bench_phase;
+
+/**
+ * struct bench_thread - One stress thread of a phase
+ * @phase: Phase the thread runs
+ * @id: Index of the thread, 0..nr_threads-1
+ * @iter: Iterations done
+ * @hist: Latency of each operation of the phase
+ * @done: Completed when the thread leaves its loop
+ */
+struct bench_thread {
+	struct bench_phase *phase;
+	unsigned int id;
+	u64 iter;
+	struct bench_hist hist[BENCH_MAX_OPS];
+	struct completion done;
+};
+
+/**
+ * struct bench_phase - A stress phase run by all threads
+ * @name: Phase name for the report
+ * @op_names: Names of the timed operations
+ * @nr_ops: Number of timed operations
+ * @step: Runs one iteration, records the latency of each operation
+ * @data: Phase private data
+ * @start_ns: Time the threads start, all spin until then
+ * @end_ns: Time the threads stop
+ * @errors: Failed operations
+ */
+struct bench_phase {
+	const char *name;
+	const char *op_names[BENCH_MAX_OPS];
+	unsigned int nr_ops;
+	void (*step)(struct bench_thread *t);
+	void *data;
+	u64 start_ns;
+	u64 end_ns;
+	atomic_t errors;
+};
+
+static unsigned int bench_hist_bucket(u64 val)
+{
+	if (!val)
+		return 0;
+
+	return min_t(unsigned int, ilog2(val), BENCH_HIST_BUCKETS - 1);
+}
+
+static inline void bench_hist_add(struct bench_hist *hist, u64 val)
+{
+	hist->ops++;
+	hist->buckets[bench_hist_bucket(val)]++;
+}
+
+/**
+ * bench_hist_percentile - Upper bound of the bucket holding a percentile
+ * @hist: Histogram
+ * @pct: Percentile, 1..100
+ *
+ * Return: Exclusive upper bound of the bucket (2^(i+1)), 0 if @hist is empty
+ */
+static u64 bench_hist_percentile(const struct bench_hist *hist, unsigned int pct)
+{
+	u64 rank, seen = 0;
+	unsigned int i;
+
+	if (!hist->ops)
+		return 0;
+
+	rank = div64_u64(hist->ops * pct + 99, 100);
+	for (i = 0; i < BENCH_HIST_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+
+	return 2ULL << min_t(unsigned int, i, BENCH_HIST_BUCKETS - 1);
+}
+
+/**
+ * bench_hist_report - Print a histogram summary
+ * @what: Name of the measured operation
+ * @hist: Histogram
+ * @unit: Unit of the histogram values
+ * @duration_ns: Duration the operations were spread over, 0 to omit the rate
+ */
+static void bench_hist_report(const char *what, const struct bench_hist *hist,
+			      const char *unit, u64 duration_ns)
+{
+	u64 rate = duration_ns ? div64_u64(hist->ops * NSEC_PER_SEC, duration_ns) : 0;
+
+	pr_info("  %-28s %10llu ops %10llu ops/s  p50 <%llu%s  p90 <%llu%s  p99 <%llu%s  max <%llu%s\n",
+		what, hist->ops, rate,
+		bench_hist_percentile(hist, 50), unit,
+		bench_hist_percentile(hist, 90), unit,
+		bench_hist_percentile(hist, 99), unit,
+		bench_hist_percentile(hist, 100), unit);
+}
+
+static void bench_hist_merge(struct bench_hist *dst, const struct bench_hist *src)
+{
+	unsigned int i;
+
+	dst->ops += src->ops;
+	for (i = 0; i < BENCH_HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+}
+
+static int bench_thread_fn(void *arg)
+{
+	struct bench_thread *t = arg;
+	struct bench_phase *phase = t->phase;
+
+	/* Start together so every CPU contends for the whole phase */
+	while (ktime_get_ns() < phase->start_ns)
+		cond_resched();
+
+	while (ktime_get_ns() < phase->end_ns) {
+		phase->step(t);
+		t->iter++;
+		cond_resched();
+	}
+
+	complete(&t->done);
+	return 0;
+}
+
+static unsigned int bench_nr_threads(void)
+{
+	unsigned int online = num_online_cpus();
+
+	return nr_threads && nr_threads < online ? nr_threads : online;
+}
+
+/**
+ * bench_run_phase - Run a stress phase on bench_nr_threads() CPUs
+ * @phase: Phase to run
+ *
+ * One kthread is bound to each of the first online CPUs. The threads are
+ * released at the same time and run phase->step for duration_ms.
+ *
+ * Context: Process context. Sleeps for the duration of the phase.
+ * Return: 0 on success, -ENOMEM if the threads cannot be created
+ */
+static int bench_run_phase(struct bench_phase *phase)
+{
+	unsigned int i, j, n = bench_nr_threads(), started = 0;
+	struct bench_hist total[BENCH_MAX_OPS] = {};
+	struct bench_thread *threads;
+	struct task_struct *task;
+	u64 duration_ns;
+	int cpu;
+
+	threads = vzalloc(array_size(n, sizeof(*threads)));
+	if (!threads)
+		return -ENOMEM;
+
+	atomic_set(&phase->errors, 0);
+	/* Leave time for all threads to be created and woken up */
+	phase->start_ns = ktime_get_ns() + 20 * NSEC_PER_MSEC;
+	phase->end_ns = phase->start_ns + (u64)duration_ms * NSEC_PER_MSEC;
+
+	for_each_online_cpu(cpu) {
+		struct bench_thread *t;
+
+		if (started == n)
+			break;
+
+		t = &threads[started];
+		t->phase = phase;
+		t->id = started;
+		init_completion(&t->done);
+
+		task = kthread_create_on_cpu(bench_thread_fn, t, cpu, "wlbt_bench/%u");
+		if (IS_ERR(task))
+			break;
+		wake_up_process(task);
+		started++;
+	}
+
+	for (i = 0; i < started; i++) {
+		wait_for_completion(&threads[i].done);
+		for (j = 0; j < phase->nr_ops; j++)
+			bench_hist_merge(&total[j], &threads[i].hist[j]);
+	}
+
+	duration_ns = (u64)duration_ms * NSEC_PER_MSEC;
+	pr_info("%s: %u threads, %u ms, %d errors\n", phase->name, started, duration_ms,
+		atomic_read(&phase->errors));
+	for (i = 0; i < phase->nr_ops; i++)
+		bench_hist_report(phase->op_names[i], &total[i], "ns", duration_ns);
+
+	vfree(threads);
+	return started ? 0 : -ENOMEM;
+}
+
+/* Time one call of an operation into hist[op] of the thread */
+#define BENCH_TIME(t, op, call)						\
+	({								\
+		u64 __t0 = ktime_get_ns();				\
+		int __ret = (call);					\
+		bench_hist_add(&(t)->hist[op], ktime_get_ns() - __t0);	\
+		if (__ret < 0)						\
+			atomic_inc(&(t)->phase->errors);		\
+		__ret;							\
+	})
+
+/* ---------------------------------------------------------------------- */
+/* Watchdog                                                                */
+/* ---------------------------------------------------------------------- */
+
+/**
+ * struct bench_wdog - Watchdog phase data
+ * @ctx: Benchmark instance
+ * @items: nr_items watchdogs
+ * @start_ns: Start time of each item (lateness phase)
+ * @fired_ns: First recovery call of each item (lateness phase)
+ */
+struct bench_wdog {
+	struct watchdog_context *ctx;
+	struct watchdog_item **items;
+	u64 *start_ns;
+	u64 *fired_ns;
+};
+
+/* Kept until unload for <debugfs>/kwatchdog/<instance>/stats */
+static struct watchdog_context *bench_wdog_ctx;
+
+static void bench_wdog_never(void *data)
+{
+}
+
+static struct bench_wdog *bench_wdog_lateness_data;
+
+static void bench_wdog_fired(void *data)
+{
+	struct bench_wdog *bw = bench_wdog_lateness_data;
+	unsigned long idx = (unsigned long)data;
+
+	/* Only the first recovery call of an item counts */
+	cmpxchg64(&bw->fired_ns[idx], 0, ktime_get_ns());
+}
+
+/* Each thread starts and cancels the items of its own slice */
+static void bench_wdog_step(struct bench_thread *t)
+{
+	struct bench_wdog *bw = t->phase->data;
+	unsigned int n = bench_nr_threads();
+	unsigned int slice = max(nr_items / n, 1U);
+	struct watchdog_item *item;
+
+	item = bw->items[(t->id * slice + t->iter % slice) % nr_items];
+	BENCH_TIME(t, 0, watchdog_start(item));
+	BENCH_TIME(t, 1, watchdog_cancel(item));
+}
+
+/**
+ * bench_wdog_lateness - Measure how late expired watchdogs are recovered
+ * @bw: Watchdog phase data
+ *
+ * Starts nr_items watchdogs of wdog_timeout_ms, waits three timeouts and
+ * reports how long after its deadline each one got its first recovery
+ * call.
+ */
+static void bench_wdog_lateness(struct bench_wdog *bw)
+{
+	struct bench_hist late = {};
+	unsigned int i, missed = 0;
+	u64 deadline;
+
+	bench_wdog_lateness_data = bw;
+	for (i = 0; i < nr_items; i++) {
+		bw->items[i] = watchdog_add_ctx(bw->ctx, wdog_timeout_ms, bench_wdog_fired,
+						(void *)(unsigned long)i);
+		if (!bw->items[i])
+			break;
+	}
+
+	for (i = 0; i < nr_items && bw->items[i]; i++) {
+		bw->start_ns[i] = ktime_get_ns();
+		watchdog_start(bw->items[i]);
+	}
+
+	msleep(3 * wdog_timeout_ms);
+
+	for (i = 0; i < nr_items && bw->items[i]; i++) {
+		watchdog_cancel(bw->items[i]);
+		deadline = bw->start_ns[i] + (u64)wdog_timeout_ms * NSEC_PER_MSEC;
+		if (!READ_ONCE(bw->fired_ns[i]))
+			missed++;
+		else
+			bench_hist_add(&late, div_u64(max_t(s64, bw->fired_ns[i] - deadline, 0),
+						      NSEC_PER_USEC));
+	}
+	watchdog_remove_batch(bw->items, i);
+
+	pr_info("watchdog lateness: %u items, %u ms timeout, %u missed\n", i, wdog_timeout_ms,
+		missed);
+	bench_hist_report("recovery after deadline", &late, "us", 0);
+}
+
+static void bench_watchdog(void)
+{
+	struct bench_phase phase = {
+		.name = "watchdog start/cancel",
+		.op_names = { "watchdog_start", "watchdog_cancel" },
+		.nr_ops = 2,
+		.step = bench_wdog_step,
+	};
+	struct bench_wdog bw = {};
+	unsigned int i;
+
+	bw.items = kvcalloc(nr_items, sizeof(*bw.items), GFP_KERNEL);
+	bw.start_ns = kvcalloc(nr_items, sizeof(*bw.start_ns), GFP_KERNEL);
+	bw.fired_ns = kvcalloc(nr_items, sizeof(*bw.fired_ns), GFP_KERNEL);
+	bw.ctx = watchdog_ctx_create(wdog_flags, NULL);
+	if (!bw.items || !bw.start_ns || !bw.fired_ns || !bw.ctx) {
+		pr_err("watchdog: setup failed\n");
+		goto out;
+	}
+
+	/* Long timeouts, the stress phase must not expire anything */
+	for (i = 0; i < nr_items; i++) {
+		bw.items[i] = watchdog_add_ctx(bw.ctx, 60 * MSEC_PER_SEC, bench_wdog_never, NULL);
+		if (!bw.items[i]) {
+			pr_err("watchdog: only %u of %u items added\n", i, nr_items);
+			break;
+		}
+	}
+
+	if (i == nr_items) {
+		phase.data = &bw;
+		bench_run_phase(&phase);
+	}
+	watchdog_remove_batch(bw.items, i);
+
+	bench_wdog_lateness(&bw);
+
+out:
+	bench_wdog_ctx = bw.ctx;
+	kvfree(bw.fired_ns);
+	kvfree(bw.start_ns);
+	kvfree(bw.items);
+}
+
+/* ---------------------------------------------------------------------- */
+/* State watcher                                                           */
+/* ---------------------------------------------------------------------- */
+
+/**
+ * struct bench_sw - State watcher phase data
+ * @watcher: Benchmark watcher
+ * @items: nr_items polled items
+ * @last_probe_ns: Last probe of each item
+ * @late: Probe lateness against the previous probe plus the interval (us)
+ * @pass: Duration of a pass over all due items (ns)
+ * @pass_start_ns: First probe of the current pass
+ * @pass_last_ns: Latest probe of the current pass
+ *
+ * The watcher evaluates items sequentially from its work, so the probe
+ * statistics need no locking.
+ */
+struct bench_sw {
+	struct state_watcher watcher;
+	struct watch_item **items;
+	u64 *last_probe_ns;
+	struct bench_hist late;
+	struct bench_hist pass;
+	u64 pass_start_ns;
+	u64 pass_last_ns;
+};
+
+static struct bench_sw *bench_sw_data;
+
+static unsigned long bench_sw_probe(void *private_data)
+{
+	struct bench_sw *bs = bench_sw_data;
+	unsigned long idx = (unsigned long)private_data;
+	u64 interval_ns = (u64)sw_interval_ms * NSEC_PER_MSEC;
+	u64 now = ktime_get_ns();
+
+	/* A gap of half an interval separates two passes */
+	if (now - bs->pass_last_ns > interval_ns / 2) {
+		if (bs->pass_last_ns)
+			bench_hist_add(&bs->pass, bs->pass_last_ns - bs->pass_start_ns);
+		bs->pass_start_ns = now;
+	}
+	bs->pass_last_ns = now;
+
+	if (bs->last_probe_ns[idx])
+		bench_hist_add(&bs->late,
+			       div_u64(max_t(s64, now - bs->last_probe_ns[idx] - interval_ns, 0),
+				       NSEC_PER_USEC));
+	bs->last_probe_ns[idx] = now;
+
+	return 0;
+}
+
+/* Churned items are never due within the phase and are never probed */
+static unsigned long bench_sw_idle(void *private_data)
+{
+	return 0;
+}
+
+static void bench_sw_action(unsigned long old_state, unsigned long new_state, void *private_data)
+{
+}
+
+static void bench_sw_step(struct bench_thread *t)
+{
+	struct bench_sw *bs = t->phase->data;
+	struct watch_item_init init = {
+		.name = "bench_churn",
+		.interval_ms = 600 * sw_interval_ms,
+		.state_func = bench_sw_idle,
+		.action_func = bench_sw_action,
+	};
+	struct watch_item *item;
+	u64 t0 = ktime_get_ns();
+
+	item = state_watcher_add_item(&bs->watcher, &init);
+	bench_hist_add(&t->hist[0], ktime_get_ns() - t0);
+	if (!item) {
+		atomic_inc(&t->phase->errors);
+		return;
+	}
+
+	BENCH_TIME(t, 1, state_watcher_remove_item(&bs->watcher, item));
+}
+
+static void bench_state_watcher(void)
+{
+	struct bench_phase phase = {
+		.name = "state_watcher add/remove",
+		.op_names = { "state_watcher_add_item", "state_watcher_remove_item" },
+		.nr_ops = 2,
+		.step = bench_sw_step,
+	};
+	struct watch_item_init init = {
+		.name = "bench_poll",
+		.interval_ms = sw_interval_ms,
+		.state_func = bench_sw_probe,
+		.action_func = bench_sw_action,
+	};
+	struct bench_sw *bs;
+	unsigned int i = 0;
+
+	bs = kzalloc(sizeof(*bs), GFP_KERNEL);
+	if (!bs)
+		return;
+	bs->items = kvcalloc(nr_items, sizeof(*bs->items), GFP_KERNEL);
+	bs->last_probe_ns = kvcalloc(nr_items, sizeof(*bs->last_probe_ns), GFP_KERNEL);
+	if (!bs->items || !bs->last_probe_ns || state_watcher_init(&bs->watcher, sw_interval_ms)) {
+		pr_err("state_watcher: setup failed\n");
+		goto out_free;
+	}
+	bench_sw_data = bs;
+
+	for (i = 0; i < nr_items; i++) {
+		init.private_data = (void *)(unsigned long)i;
+		bs->items[i] = state_watcher_add_item(&bs->watcher, &init);
+		if (!bs->items[i]) {
+			pr_err("state_watcher: only %u of %u items added\n", i, nr_items);
+			break;
+		}
+	}
+	state_watcher_start(&bs->watcher);
+
+	/* Settle the schedule, then churn while the items are polled */
+	msleep(2 * sw_interval_ms);
+	memset(&bs->late, 0, sizeof(bs->late));
+	memset(&bs->pass, 0, sizeof(bs->pass));
+
+	phase.data = bs;
+	bench_run_phase(&phase);
+
+	state_watcher_stop(&bs->watcher);
+	pr_info("state_watcher polling: %u items, %u ms interval\n", i, sw_interval_ms);
+	bench_hist_report("probe lateness", &bs->late, "us", 0);
+	bench_hist_report("pass duration", &bs->pass, "ns", 0);
+
+	state_watcher_remove_items(&bs->watcher, bs->items, i);
+	state_watcher_cleanup(&bs->watcher);
+
+out_free:
+	kvfree(bs->last_probe_ns);
+	kvfree(bs->items);
+	kfree(bs);
+}
+
+/* ---------------------------------------------------------------------- */
+/* Traffic monitor                                                         */
+/* ---------------------------------------------------------------------- */
+
+/* Kept until unload for <debugfs>/traffic_monitor/stats */
+static bool bench_traffic_up;
+static struct net_device **bench_netdevs;
+static unsigned int bench_nr_netdevs;
+
+static void bench_netdevs_destroy(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < bench_nr_netdevs; i++)
+		wlbt_test_netdev_destroy(bench_netdevs[i]);
+	kfree(bench_netdevs);
+	bench_netdevs = NULL;
+	bench_nr_netdevs = 0;
+}
+
+/**
+ * bench_netdevs_create - Create and open nr_netdevs dummy devices "wlbtb%d"
+ *
+ * Device i sends (i + 1) Gbps of synthetic traffic.
+ *
+ * Context: Process context, takes rtnl_lock()
+ * Return: 0 on success, negative errno otherwise
+ */
+static int bench_netdevs_create(void)
+{
+	struct net_device *dev;
+	unsigned int i;
+
+	bench_netdevs = kcalloc(nr_netdevs, sizeof(*bench_netdevs), GFP_KERNEL);
+	if (!bench_netdevs)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_netdevs; i++) {
+		dev = wlbt_test_netdev_create("wlbtb%d", 125000000ULL * (i + 1));
+		if (IS_ERR(dev))
+			return PTR_ERR(dev);
+		bench_netdevs[bench_nr_netdevs++] = dev;
+	}
+
+	return 0;
+}
+
+static void bench_traffic_step(struct bench_thread *t)
+{
+	struct net_device *dev = bench_netdevs[(t->id + t->iter) % bench_nr_netdevs];
+	struct simple_net_device_stats stats;
+	u64 t0;
+
+	t0 = ktime_get_ns();
+	stats = netdevice_stats_delta(dev->name);
+	bench_hist_add(&t->hist[0], ktime_get_ns() - t0);
+
+	t0 = ktime_get_ns();
+	stats = netdevice_stats_delta_ifindex(dev->ifindex);
+	bench_hist_add(&t->hist[1], ktime_get_ns() - t0);
+
+	if (!stats.tx_bytes)
+		atomic_inc(&t->phase->errors);
+}
+
+static void bench_traffic(void)
+{
+	struct bench_phase phase = {
+		.name = "traffic_monitor queries",
+		.op_names = { "netdevice_stats_delta", "netdevice_stats_delta_ifindex" },
+		.nr_ops = 2,
+		.step = bench_traffic_step,
+	};
+	int ret;
+
+	if (!nr_netdevs)
+		return;
+
+	ret = init_traffic_monitor();
+	if (ret) {
+		pr_err("traffic_monitor: init failed: %d\n", ret);
+		return;
+	}
+
+	ret = bench_netdevs_create();
+	if (ret) {
+		pr_err("traffic_monitor: dummy devices failed: %d\n", ret);
+		goto out;
+	}
+
+	/* The sampler needs two samples for rates */
+	msleep(500);
+
+	if (netdevice_queue_stats_ifindex(bench_netdevs[0]->ifindex, TRAFFIC_QUEUE_RX,
+					  NULL, 0) == -ENODEV) {
+		pr_warn("traffic_monitor: %s is not monitored, load wlbt_monitoring with devices='wlbtb*'\n",
+			bench_netdevs[0]->name);
+		goto out;
+	}
+
+	bench_run_phase(&phase);
+	bench_traffic_up = true;
+	return;
+
+out:
+	bench_netdevs_destroy();
+	cleanup_traffic_monitor();
+}
+
+static int __init wlbt_bench_init(void)
+{
+	pr_info("%u items, %u threads, %u ms per phase\n", nr_items, bench_nr_threads(),
+		duration_ms);
+
+	if (!nr_items || !duration_ms)
+		return -EINVAL;
+
+	if (tests & BENCH_TEST_WATCHDOG)
+		bench_watchdog();
+	if (tests & BENCH_TEST_STATE)
+		bench_state_watcher();
+	if (tests & BENCH_TEST_TRAFFIC)
+		bench_traffic();
+
+	pr_info("done\n");
+	return 0;
+}
+
+static void __exit wlbt_bench_exit(void)
+{
+	if (bench_traffic_up) {
+		bench_netdevs_destroy();
+		cleanup_traffic_monitor();
+	}
+	if (bench_wdog_ctx)
+		watchdog_ctx_destroy(bench_wdog_ctx);
+}
+
+module_init(wlbt_bench_init);
+module_exit(wlbt_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Benchmark and stress test of the WLBT monitoring libraries");
@@ -0,0 +1,864 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests of the WLBT monitoring libraries
+ *
+ * Functional tests of the watchdog, state watcher and traffic monitor
+ * engines of wlbt_monitoring.ko, and regression tests of fixes that are
+ * hard to spot by inspection: a shard re-kicked after its last item was
+ * removed, an EWMA item fed huge samples, and a watch group removed while a
+ * member's action is still queued.
+ *
+ * The tests wait for real expirations and polls, so most are slow. The
+ * traffic monitor suite initializes the traffic monitor itself; do not
+ * load this module together with another user of it, such as
+ * wlbt_bench.ko. Its rate, window, back-off and subscription tests run on
+ * dummy devices "wlbtk%d" with synthetic counters and are skipped unless
+ * the "devices" parameter selects them:
+ *
+ *   modprobe wlbt_monitoring devices='wlbtk*'
+ *   modprobe wlbt_kunit
+ *   cat /sys/kernel/debug/kunit/wlbt_watchdog/results
+ */
+
+#include <kunit/test.h>
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/errno.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include "state_watcher.h"
+#include "traffic_monitor.h"
+#include "watchdog.h"
+#include "wlbt_test_netdev.h"
+
+/* ---------------------------------------------------------------------- */
+/* Watchdog                                                                */
+/* ---------------------------------------------------------------------- */
+
+#define WLBT_KUNIT_TIMEOUT_MS	WATCHDOG_MIN_TIMEOUT_MS
+
+/**
+ * struct wdog_probe - Records the recovery calls of a watchdog
+ * @calls: Recovery calls
+ * @fired: Completed on the first call
+ */
+struct wdog_probe {
+	atomic_t calls;
+	struct completion fired;
+};
+
+static void wdog_probe_init(struct wdog_probe *probe)
+{
+	atomic_set(&probe->calls, 0);
+	init_completion(&probe->fired);
+}
+
+static void wdog_probe_recovery(void *data)
+{
+	struct wdog_probe *probe = data;
+
+	if (atomic_inc_return(&probe->calls) == 1)
+		complete(&probe->fired);
+}
+
+/* Generous bound for a recovery: the timeout plus a few recovery periods */
+static bool wdog_probe_wait(struct wdog_probe *probe)
+{
+	return wait_for_completion_timeout(&probe->fired,
+					   msecs_to_jiffies(5 * WLBT_KUNIT_TIMEOUT_MS));
+}
+
+static int wdog_test_init(struct kunit *test)
+{
+	struct watchdog_context *ctx = watchdog_ctx_create(0, NULL);
+
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx);
+	test->priv = ctx;
+	return 0;
+}
+
+static void wdog_test_exit(struct kunit *test)
+{
+	watchdog_ctx_destroy(test->priv);
+}
+
+static void wdog_test_expiry_calls_recovery(struct kunit *test)
+{
+	struct wdog_probe probe;
+	struct watchdog_item *item;
+
+	wdog_probe_init(&probe);
+	item = watchdog_add_ctx(test->priv, WLBT_KUNIT_TIMEOUT_MS, wdog_probe_recovery, &probe);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, item);
+
+	KUNIT_EXPECT_EQ(test, watchdog_start(item), 0);
+	KUNIT_EXPECT_TRUE(test, wdog_probe_wait(&probe));
+
+	KUNIT_EXPECT_EQ(test, watchdog_cancel(item), 0);
+	KUNIT_EXPECT_EQ(test, watchdog_remove(item), 0);
+}
+
+static void wdog_test_cancel_prevents_recovery(struct kunit *test)
+{
+	struct wdog_probe probe;
+	struct watchdog_item *item;
+
+	wdog_probe_init(&probe);
+	item = watchdog_add_ctx(test->priv, WLBT_KUNIT_TIMEOUT_MS, wdog_probe_recovery, &probe);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, item);
+
+	KUNIT_EXPECT_EQ(test, watchdog_start(item), 0);
+	KUNIT_EXPECT_EQ(test, watchdog_cancel(item), 0);
+	KUNIT_EXPECT_FALSE(test, wdog_probe_wait(&probe));
+	KUNIT_EXPECT_EQ(test, atomic_read(&probe.calls), 0);
+
+	KUNIT_EXPECT_EQ(test, watchdog_remove(item), 0);
+}
+
+/*
+ * Removing the last item stops the shard; an item added and started right
+ * after must restart it rather than be left unchecked.
+ */
+static void wdog_test_remove_then_add_rekicks(struct kunit *test)
+{
+	struct wdog_probe first, second;
+	struct watchdog_item *item;
+
+	wdog_probe_init(&first);
+	item = watchdog_add_ctx(test->priv, WLBT_KUNIT_TIMEOUT_MS, wdog_probe_recovery, &first);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, item);
+	KUNIT_EXPECT_EQ(test, watchdog_start(item), 0);
+	KUNIT_EXPECT_EQ(test, watchdog_remove(item), 0);
+
+	wdog_probe_init(&second);
+	item = watchdog_add_ctx(test->priv, WLBT_KUNIT_TIMEOUT_MS, wdog_probe_recovery, &second);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, item);
+	KUNIT_EXPECT_EQ(test, watchdog_start(item), 0);
+	KUNIT_EXPECT_TRUE(test, wdog_probe_wait(&second));
+	KUNIT_EXPECT_EQ(test, atomic_read(&first.calls), 0);
+
+	KUNIT_EXPECT_EQ(test, watchdog_remove(item), 0);
+}
+
+/* Kicks keep a started item alive; kicking before the start does nothing */
+static void wdog_test_kick(struct kunit *test)
+{
+	struct wdog_probe probe;
+	struct watchdog_item *item;
+	unsigned int i;
+
+	wdog_probe_init(&probe);
+	item = watchdog_add_ctx(test->priv, WLBT_KUNIT_TIMEOUT_MS, wdog_probe_recovery, &probe);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, item);
+
+	watchdog_kick(item);
+	KUNIT_EXPECT_EQ(test, atomic_read(&item->active), 0);
+
+	KUNIT_EXPECT_EQ(test, watchdog_start(item), 0);
+	for (i = 0; i < 12; i++) {
+		msleep(WLBT_KUNIT_TIMEOUT_MS / 4);
+		watchdog_kick(item);
+	}
+	KUNIT_EXPECT_EQ(test, atomic_read(&probe.calls), 0);
+
+	/* Left alone, it expires */
+	KUNIT_EXPECT_TRUE(test, wdog_probe_wait(&probe));
+
+	KUNIT_EXPECT_EQ(test, watchdog_cancel(item), 0);
+	KUNIT_EXPECT_EQ(test, watchdog_remove(item), 0);
+}
+
+#define WDOG_TEST_BATCH 8
+
+static void wdog_test_batch(struct kunit *test)
+{
+	struct watchdog_item_init init[WDOG_TEST_BATCH];
+	struct watchdog_item *items[WDOG_TEST_BATCH];
+	struct wdog_probe probes[WDOG_TEST_BATCH];
+	unsigned int i;
+
+	for (i = 0; i < WDOG_TEST_BATCH; i++) {
+		wdog_probe_init(&probes[i]);
+		init[i].timeout_ms = WLBT_KUNIT_TIMEOUT_MS;
+		init[i].recovery_func = wdog_probe_recovery;
+		init[i].private_data = &probes[i];
+	}
+
+	KUNIT_ASSERT_EQ(test, watchdog_add_batch(test->priv, -1, init, WDOG_TEST_BATCH, items,
+						 GFP_KERNEL), 0);
+
+	/* Only the even items are started */
+	for (i = 0; i < WDOG_TEST_BATCH; i += 2)
+		KUNIT_EXPECT_EQ(test, watchdog_start(items[i]), 0);
+	for (i = 0; i < WDOG_TEST_BATCH; i += 2)
+		KUNIT_EXPECT_TRUE(test, wdog_probe_wait(&probes[i]));
+	for (i = 1; i < WDOG_TEST_BATCH; i += 2)
+		KUNIT_EXPECT_EQ(test, atomic_read(&probes[i].calls), 0);
+
+	KUNIT_EXPECT_EQ(test, watchdog_remove_batch(items, WDOG_TEST_BATCH), 0);
+}
+
+static void wdog_test_invalid_args(struct kunit *test)
+{
+	KUNIT_EXPECT_EQ(test, watchdog_start(NULL), -EINVAL);
+	KUNIT_EXPECT_EQ(test, watchdog_cancel(NULL), -EINVAL);
+	KUNIT_EXPECT_EQ(test, watchdog_remove(NULL), -EINVAL);
+	KUNIT_EXPECT_NULL(test, watchdog_add_ctx(test->priv, WLBT_KUNIT_TIMEOUT_MS, NULL, NULL));
+}
+
+static struct kunit_case wdog_test_cases[] = {
+	KUNIT_CASE_SLOW(wdog_test_expiry_calls_recovery),
+	KUNIT_CASE_SLOW(wdog_test_cancel_prevents_recovery),
+	KUNIT_CASE_SLOW(wdog_test_remove_then_add_rekicks),
+	KUNIT_CASE_SLOW(wdog_test_kick),
+	KUNIT_CASE_SLOW(wdog_test_batch),
+	KUNIT_CASE(wdog_test_invalid_args),
+	{}
+};
+
+static struct kunit_suite wdog_test_suite = {
+	.name = "wlbt_watchdog",
+	.init = wdog_test_init,
+	.exit = wdog_test_exit,
+	.test_cases = wdog_test_cases,
+};
+
+/* ---------------------------------------------------------------------- */
+/* State watcher                                                           */
+/* ---------------------------------------------------------------------- */
+
+#define SW_TEST_INTERVAL_MS	100
+
+/**
+ * struct sw_probe - State source and action recorder of a watch item
+ * @state: State returned by the probe
+ * @actions: Action calls
+ * @old_state: Old state of the last action
+ * @new_state: New state of the last action
+ * @acted: Completed on every action
+ * @hold_ms: Time each action sleeps before returning
+ */
+struct sw_probe {
+	unsigned long state;
+	atomic_t actions;
+	unsigned long old_state;
+	unsigned long new_state;
+	struct completion acted;
+	unsigned int hold_ms;
+};
+
+static void sw_probe_init(struct sw_probe *probe, unsigned long state)
+{
+	WRITE_ONCE(probe->state, state);
+	atomic_set(&probe->actions, 0);
+	probe->old_state = 0;
+	probe->new_state = 0;
+	init_completion(&probe->acted);
+	probe->hold_ms = 0;
+}
+
+static unsigned long sw_probe_state(void *private_data)
+{
+	struct sw_probe *probe = private_data;
+
+	return READ_ONCE(probe->state);
+}
+
+static void sw_probe_action(unsigned long old_state, unsigned long new_state, void *private_data)
+{
+	struct sw_probe *probe = private_data;
+
+	probe->old_state = old_state;
+	probe->new_state = new_state;
+	atomic_inc(&probe->actions);
+	complete(&probe->acted);
+
+	if (probe->hold_ms)
+		msleep(probe->hold_ms);
+}
+
+static bool sw_probe_wait(struct sw_probe *probe)
+{
+	return wait_for_completion_timeout(&probe->acted,
+					   msecs_to_jiffies(10 * SW_TEST_INTERVAL_MS));
+}
+
+static int sw_test_init(struct kunit *test)
+{
+	struct state_watcher *watcher = kunit_kzalloc(test, sizeof(*watcher), GFP_KERNEL);
+
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, watcher);
+	KUNIT_ASSERT_EQ(test, state_watcher_init(watcher, SW_TEST_INTERVAL_MS), 0);
+	KUNIT_ASSERT_EQ(test, state_watcher_start(watcher), 0);
+	test->priv = watcher;
+	return 0;
+}
+
+static void sw_test_exit(struct kunit *test)
+{
+	state_watcher_stop(test->priv);
+	state_watcher_cleanup(test->priv);
+}
+
+static void sw_test_action_on_change(struct kunit *test)
+{
+	struct watch_item_init init = {
+		.name = "kunit_change",
+		.interval_ms = SW_TEST_INTERVAL_MS,
+		.state_func = sw_probe_state,
+		.action_func = sw_probe_action,
+	};
+	unsigned long checks, actions, state;
+	struct watch_item *item;
+	struct sw_probe probe;
+
+	sw_probe_init(&probe, 0);
+	init.private_data = &probe;
+	item = state_watcher_add_item(test->priv, &init);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, item);
+
+	/* An unchanged state never acts */
+	msleep(3 * SW_TEST_INTERVAL_MS);
+	KUNIT_EXPECT_EQ(test, atomic_read(&probe.actions), 0);
+
+	WRITE_ONCE(probe.state, 5);
+	KUNIT_ASSERT_TRUE(test, sw_probe_wait(&probe));
+	KUNIT_EXPECT_EQ(test, probe.old_state, 0UL);
+	KUNIT_EXPECT_EQ(test, probe.new_state, 5UL);
+
+	/* The action count is committed after the action returns */
+	msleep(SW_TEST_INTERVAL_MS);
+	KUNIT_EXPECT_EQ(test, state_watcher_get_item_state(item, &state), 0);
+	KUNIT_EXPECT_EQ(test, state, 5UL);
+	KUNIT_EXPECT_EQ(test, state_watcher_get_item_stats(item, &checks, &actions), 0);
+	KUNIT_EXPECT_GE(test, checks, 1UL);
+	KUNIT_EXPECT_EQ(test, actions, 1UL);
+
+	KUNIT_EXPECT_EQ(test, state_watcher_remove_item(test->priv, item), 0);
+}
+
+/*
+ * Samples up to ULONG_MAX must not overflow the fixed point average: the
+ * item goes above the band once and stays there.
+ */
+static void sw_test_ewma_huge_samples(struct kunit *test)
+{
+	struct watch_item_init init = {
+		.name = "kunit_ewma",
+		.interval_ms = SW_TEST_INTERVAL_MS,
+		.state_func = sw_probe_state,
+		.action_func = sw_probe_action,
+		.hysteresis_mode = WATCH_HYST_EWMA,
+		.band_enter = 1000,
+		.band_exit = 500,
+		.ewma_shift = 1,
+	};
+	struct watch_item *item;
+	struct sw_probe probe;
+
+	sw_probe_init(&probe, ULONG_MAX);
+	init.private_data = &probe;
+	item = state_watcher_add_item(test->priv, &init);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, item);
+
+	KUNIT_ASSERT_TRUE(test, sw_probe_wait(&probe));
+	KUNIT_EXPECT_EQ(test, probe.new_state, 1UL);
+
+	msleep(10 * SW_TEST_INTERVAL_MS);
+	KUNIT_EXPECT_EQ(test, atomic_read(&probe.actions), 1);
+
+	KUNIT_EXPECT_EQ(test, state_watcher_remove_item(test->priv, item), 0);
+}
+
+/*
+ * A steady sample equal to band_enter, approached from below, must enter
+ * the band: the rounded average reaches the sample instead of stopping one
+ * below it.
+ */
+static void sw_test_ewma_steady_enter(struct kunit *test)
+{
+	struct watch_item_init init = {
+		.name = "kunit_ewma_steady",
+		.interval_ms = SW_TEST_INTERVAL_MS,
+		.state_func = sw_probe_state,
+		.action_func = sw_probe_action,
+		.hysteresis_mode = WATCH_HYST_EWMA,
+		.band_enter = 200,
+		.band_exit = 100,
+		.ewma_shift = 1,
+	};
+	struct watch_item *item;
+	struct sw_probe probe;
+
+	sw_probe_init(&probe, 0);
+	init.private_data = &probe;
+	item = state_watcher_add_item(test->priv, &init);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, item);
+
+	/* Seed the average at 0, then about 17 halvings reach the sample */
+	msleep(3 * SW_TEST_INTERVAL_MS);
+	WRITE_ONCE(probe.state, 200);
+	KUNIT_EXPECT_TRUE(test, wait_for_completion_timeout(&probe.acted,
+							    msecs_to_jiffies(40 * SW_TEST_INTERVAL_MS)));
+	KUNIT_EXPECT_EQ(test, probe.new_state, 1UL);
+
+	KUNIT_EXPECT_EQ(test, state_watcher_remove_item(test->priv, item), 0);
+}
+
+static void sw_test_ewma_invalid_band(struct kunit *test)
+{
+	struct watch_item_init init = {
+		.name = "kunit_ewma_band",
+		.interval_ms = SW_TEST_INTERVAL_MS,
+		.state_func = sw_probe_state,
+		.hysteresis_mode = WATCH_HYST_EWMA,
+		.band_enter = ULONG_MAX,
+		.band_exit = 500,
+	};
+
+	KUNIT_EXPECT_NULL(test, state_watcher_add_item(test->priv, &init));
+}
+
+#define SW_TEST_ITEMS 8
+
+static void sw_test_add_remove_items(struct kunit *test)
+{
+	struct watch_item_init init = {
+		.name = "kunit_bulk",
+		.interval_ms = SW_TEST_INTERVAL_MS,
+		.state_func = sw_probe_state,
+	};
+	struct watch_item *items[SW_TEST_ITEMS];
+	unsigned long checks, actions;
+	unsigned int active;
+	struct sw_probe probe;
+
+	sw_probe_init(&probe, 0);
+	init.private_data = &probe;
+	KUNIT_ASSERT_EQ(test, state_watcher_add_items(test->priv, &init, SW_TEST_ITEMS, items), 0);
+
+	KUNIT_EXPECT_EQ(test, state_watcher_get_stats(test->priv, &checks, &actions, &active), 0);
+	KUNIT_EXPECT_EQ(test, active, SW_TEST_ITEMS);
+
+	KUNIT_EXPECT_EQ(test, state_watcher_remove_items(test->priv, items, SW_TEST_ITEMS), 0);
+	KUNIT_EXPECT_EQ(test, state_watcher_get_stats(test->priv, &checks, &actions, &active), 0);
+	KUNIT_EXPECT_EQ(test, active, 0U);
+}
+
+/*
+ * A pushed state is evaluated right away, also after the watcher was
+ * stopped and restarted, and next to a polled item of a long interval.
+ */
+static void sw_test_push_restart(struct kunit *test)
+{
+	struct watch_item_init poll_init = {
+		.name = "kunit_slow_poll",
+		.interval_ms = 50 * SW_TEST_INTERVAL_MS,
+		.state_func = sw_probe_state,
+	};
+	struct watch_item_init init = {
+		.name = "kunit_push",
+		.mode = WATCH_ITEM_PUSH,
+		.action_func = sw_probe_action,
+	};
+	struct watch_item *item, *poll;
+	struct sw_probe probe, idle;
+
+	sw_probe_init(&idle, 0);
+	poll_init.private_data = &idle;
+	poll = state_watcher_add_item(test->priv, &poll_init);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, poll);
+
+	sw_probe_init(&probe, 0);
+	init.private_data = &probe;
+	item = state_watcher_add_item(test->priv, &init);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, item);
+
+	KUNIT_EXPECT_EQ(test, state_watcher_notify(item, 1), 0);
+	KUNIT_EXPECT_TRUE(test, sw_probe_wait(&probe));
+	KUNIT_EXPECT_EQ(test, probe.new_state, 1UL);
+
+	state_watcher_stop(test->priv);
+	KUNIT_EXPECT_EQ(test, state_watcher_notify(item, 2), -EAGAIN);
+	KUNIT_ASSERT_EQ(test, state_watcher_start(test->priv), 0);
+
+	reinit_completion(&probe.acted);
+	KUNIT_EXPECT_EQ(test, state_watcher_notify(item, 3), 0);
+	KUNIT_EXPECT_TRUE(test, sw_probe_wait(&probe));
+	KUNIT_EXPECT_EQ(test, probe.old_state, 1UL);
+	KUNIT_EXPECT_EQ(test, probe.new_state, 3UL);
+
+	KUNIT_EXPECT_EQ(test, state_watcher_remove_item(test->priv, item), 0);
+	KUNIT_EXPECT_EQ(test, state_watcher_remove_item(test->priv, poll), 0);
+}
+
+#define SW_TEST_GROUP_ITEMS 4
+
+static void sw_test_group_states(unsigned long *states, unsigned int count, void *private_data)
+{
+	struct sw_probe *probe = private_data;
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		states[i] = READ_ONCE(probe->state);
+}
+
+/*
+ * Removing a group while a member's asynchronous action is still queued or
+ * running must keep the group alive until the action work is done.
+ */
+static void sw_test_group_remove_pending_action(struct kunit *test)
+{
+	struct state_watcher_config config = {
+		.base_interval_ms = SW_TEST_INTERVAL_MS,
+		.flags = STATE_WATCHER_F_ASYNC_ACTIONS,
+	};
+	struct watch_item_init items[SW_TEST_GROUP_ITEMS] = {};
+	struct watch_group_init init = {
+		.name = "kunit_group",
+		.interval_ms = SW_TEST_INTERVAL_MS,
+		.batch_state_func = sw_test_group_states,
+		.items = items,
+		.count = SW_TEST_GROUP_ITEMS,
+	};
+	struct sw_probe probe, state;
+	struct state_watcher *watcher;
+	struct watch_group *group;
+	unsigned int i;
+
+	watcher = kunit_kzalloc(test, sizeof(*watcher), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, watcher);
+	KUNIT_ASSERT_EQ(test, state_watcher_init_config(watcher, &config), 0);
+
+	sw_probe_init(&state, 1);
+	sw_probe_init(&probe, 0);
+	probe.hold_ms = 2 * SW_TEST_INTERVAL_MS;
+	init.private_data = &state;
+	for (i = 0; i < SW_TEST_GROUP_ITEMS; i++) {
+		items[i].action_func = sw_probe_action;
+		items[i].private_data = &probe;
+	}
+
+	group = state_watcher_add_group(watcher, &init);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, group);
+	KUNIT_ASSERT_EQ(test, state_watcher_start(watcher), 0);
+
+	/* The actions sleep, so they are still queued or running on removal */
+	KUNIT_EXPECT_TRUE(test, sw_probe_wait(&probe));
+	KUNIT_EXPECT_EQ(test, state_watcher_remove_group(watcher, group), 0);
+
+	state_watcher_stop(watcher);
+	state_watcher_cleanup(watcher);
+	KUNIT_EXPECT_GE(test, atomic_read(&probe.actions), 1);
+	KUNIT_EXPECT_LE(test, atomic_read(&probe.actions), SW_TEST_GROUP_ITEMS);
+}
+
+static struct kunit_case sw_test_cases[] = {
+	KUNIT_CASE_SLOW(sw_test_action_on_change),
+	KUNIT_CASE_SLOW(sw_test_ewma_huge_samples),
+	KUNIT_CASE_SLOW(sw_test_ewma_steady_enter),
+	KUNIT_CASE(sw_test_ewma_invalid_band),
+	KUNIT_CASE(sw_test_add_remove_items),
+	KUNIT_CASE_SLOW(sw_test_group_remove_pending_action),
+	KUNIT_CASE_SLOW(sw_test_push_restart),
+	{}
+};
+
+static struct kunit_suite sw_test_suite = {
+	.name = "wlbt_state_watcher",
+	.init = sw_test_init,
+	.exit = sw_test_exit,
+	.test_cases = sw_test_cases,
+};
+
+/* ---------------------------------------------------------------------- */
+/* Traffic monitor                                                         */
+/* ---------------------------------------------------------------------- */
+
+/* No device of the monitored set can have this name */
+#define TM_TEST_NO_DEV "wlbt_kunit_nx"
+
+static int tm_suite_init(struct kunit_suite *suite)
+{
+	return init_traffic_monitor();
+}
+
+static void tm_suite_exit(struct kunit_suite *suite)
+{
+	cleanup_traffic_monitor();
+}
+
+static void tm_test_unknown_device(struct kunit *test)
+{
+	struct simple_net_device_stats stats = netdevice_stats_delta(TM_TEST_NO_DEV);
+	struct traffic_window_stats window;
+
+	KUNIT_EXPECT_EQ(test, stats.tx_packets, 0ULL);
+	KUNIT_EXPECT_EQ(test, stats.tx_bytes, 0ULL);
+	KUNIT_EXPECT_EQ(test, stats.rx_packets, 0ULL);
+	KUNIT_EXPECT_EQ(test, stats.rx_bytes, 0ULL);
+
+	KUNIT_EXPECT_EQ(test, netdevice_queue_stats(TM_TEST_NO_DEV, TRAFFIC_QUEUE_RX, NULL, 0),
+			-ENODEV);
+	KUNIT_EXPECT_EQ(test, netdevice_stats_window(TM_TEST_NO_DEV, 1000, &window), -ENODEV);
+	KUNIT_EXPECT_EQ(test, netdevice_stats_window(TM_TEST_NO_DEV, 1000, NULL), -EINVAL);
+}
+
+static void tm_test_threshold(struct traffic_subscription *sub, bool above, u64 rate,
+			      void *private_data)
+{
+}
+
+static void tm_test_subscribe_invalid(struct kunit *test)
+{
+	struct traffic_subscription_init init = {
+		.metric = TRAFFIC_METRIC_TX_BYTES,
+		.enter = 2000,
+		.exit = 1000,
+	};
+
+	KUNIT_EXPECT_NULL(test, traffic_subscribe(NULL));
+
+	/* Neither a function nor an item to deliver to */
+	KUNIT_EXPECT_NULL(test, traffic_subscribe(&init));
+
+	init.func = tm_test_threshold;
+	init.exit = 0;
+	KUNIT_EXPECT_NULL(test, traffic_subscribe(&init));
+
+	init.exit = 3000;
+	KUNIT_EXPECT_NULL(test, traffic_subscribe(&init));
+
+	init.exit = 1000;
+	init.metric = TRAFFIC_METRIC_RX_BYTES + 1;
+	KUNIT_EXPECT_NULL(test, traffic_subscribe(&init));
+
+	init.metric = TRAFFIC_METRIC_TX_BYTES;
+	init.ifname = "wlbt_kunit_name_too_long";
+	KUNIT_EXPECT_NULL(test, traffic_subscribe(&init));
+}
+
+static void tm_test_subscribe(struct kunit *test)
+{
+	struct traffic_subscription_init init = {
+		.ifname = TM_TEST_NO_DEV,
+		.metric = TRAFFIC_METRIC_TX_BYTES,
+		.enter = 2000,
+		.exit = 1000,
+		.func = tm_test_threshold,
+	};
+	struct traffic_subscription *sub, *all;
+
+	sub = traffic_subscribe(&init);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, sub);
+
+	/* The aggregate of all devices */
+	init.ifname = NULL;
+	all = traffic_subscribe(&init);
+	KUNIT_EXPECT_NOT_ERR_OR_NULL(test, all);
+
+	traffic_unsubscribe(all);
+	traffic_unsubscribe(sub);
+	traffic_unsubscribe(NULL);
+}
+
+/*
+ * Tests on a dummy device need it to be monitored, which the "devices"
+ * parameter of wlbt_monitoring.ko decides; they are skipped otherwise.
+ */
+#define TM_TEST_DEV	"wlbtk%d"
+#define TM_TEST_RATE	10000000ULL	/* 80 Mbps */
+
+/* Rates are measured over jiffies, allow for a tick of error either way */
+#define TM_EXPECT_NEAR(test, val, want)					\
+	do {								\
+		KUNIT_EXPECT_GE(test, (u64)(val), (u64)(want) / 4 * 3);	\
+		KUNIT_EXPECT_LE(test, (u64)(val), (u64)(want) / 4 * 5);	\
+	} while (0)
+
+static int tm_test_init(struct kunit *test)
+{
+	struct net_device *dev = wlbt_test_netdev_create(TM_TEST_DEV, TM_TEST_RATE);
+
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dev);
+	test->priv = dev;
+	return 0;
+}
+
+static void tm_test_exit(struct kunit *test)
+{
+	wlbt_test_netdev_destroy(test->priv);
+}
+
+/* Wait until the sampler has a first rate of the dummy device */
+static struct net_device *tm_test_dev(struct kunit *test)
+{
+	struct net_device *dev = test->priv;
+	struct traffic_window_stats window;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < 20; i++) {
+		ret = netdevice_stats_window(dev->name, 1000, &window);
+		if (ret != -EAGAIN)
+			break;
+		msleep(TRAFFIC_MONITOR_INTERVAL_MS);
+	}
+	if (ret == -ENODEV)
+		kunit_skip(test, "%s is not monitored, load wlbt_monitoring with devices='wlbtk*'",
+			   dev->name);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+
+	/* The first rate replaces the zero rates of the first sample */
+	msleep(3 * TRAFFIC_MONITOR_INTERVAL_MS);
+	return dev;
+}
+
+static void tm_test_rates(struct kunit *test)
+{
+	struct net_device *dev = tm_test_dev(test);
+	struct simple_net_device_stats stats;
+
+	stats = netdevice_stats_delta(dev->name);
+	TM_EXPECT_NEAR(test, stats.tx_bytes, TM_TEST_RATE);
+	TM_EXPECT_NEAR(test, stats.tx_packets, TM_TEST_RATE / WLBT_TEST_NETDEV_PKT_SIZE);
+	TM_EXPECT_NEAR(test, stats.rx_bytes, TM_TEST_RATE / 2);
+	TM_EXPECT_NEAR(test, stats.rx_packets, TM_TEST_RATE / 2 / WLBT_TEST_NETDEV_PKT_SIZE);
+
+	stats = netdevice_stats_delta_ifindex(dev->ifindex);
+	TM_EXPECT_NEAR(test, stats.tx_bytes, TM_TEST_RATE);
+
+	/* Other monitored devices only add to the aggregate */
+	stats = netdevice_stats_delta(NULL);
+	KUNIT_EXPECT_GE(test, stats.tx_bytes, TM_TEST_RATE / 4 * 3);
+}
+
+static void tm_test_window(struct kunit *test)
+{
+	struct net_device *dev = tm_test_dev(test);
+	struct traffic_window_stats window;
+
+	msleep(10 * TRAFFIC_MONITOR_INTERVAL_MS);
+	KUNIT_ASSERT_EQ(test, netdevice_stats_window(dev->name, 1000, &window), 0);
+	KUNIT_EXPECT_GE(test, window.samples, 2U);
+	KUNIT_EXPECT_LE(test, window.window_ms, 1000U + TRAFFIC_MONITOR_INTERVAL_MS);
+	TM_EXPECT_NEAR(test, window.avg.tx_bytes, TM_TEST_RATE);
+	TM_EXPECT_NEAR(test, window.ewma.tx_bytes, TM_TEST_RATE);
+	KUNIT_EXPECT_GE(test, window.peak.tx_bytes, window.p95.tx_bytes);
+	TM_EXPECT_NEAR(test, window.p95.tx_bytes, TM_TEST_RATE);
+
+	/* A burst shows in the peak of a short window */
+	wlbt_test_netdev_set_rate(dev, 4 * TM_TEST_RATE);
+	msleep(5 * TRAFFIC_MONITOR_INTERVAL_MS);
+	KUNIT_ASSERT_EQ(test, netdevice_stats_window_ifindex(dev->ifindex, 300, &window), 0);
+	KUNIT_EXPECT_GE(test, window.peak.tx_bytes, 3 * TM_TEST_RATE);
+	KUNIT_EXPECT_GE(test, window.avg.tx_bytes, 2 * TM_TEST_RATE);
+}
+
+/* An idle device backs off, so a window holds fewer samples than ticks */
+static void tm_test_idle_backoff(struct kunit *test)
+{
+	struct net_device *dev = tm_test_dev(test);
+	struct traffic_window_stats window;
+
+	wlbt_test_netdev_set_rate(dev, 0);
+	msleep(30 * TRAFFIC_MONITOR_INTERVAL_MS);
+
+	/* 30 samples at the base interval, about 5 when backing off */
+	KUNIT_ASSERT_EQ(test, netdevice_stats_window(dev->name, 3000, &window), 0);
+	KUNIT_EXPECT_LT(test, window.samples, 15U);
+}
+
+/**
+ * struct tm_sub_probe - Records the transitions of a subscription
+ * @transitions: Callback calls
+ * @above: State of the last call
+ * @changed: Completed on every call
+ */
+struct tm_sub_probe {
+	atomic_t transitions;
+	bool above;
+	struct completion changed;
+};
+
+static void tm_sub_probe_func(struct traffic_subscription *sub, bool above, u64 rate,
+			      void *private_data)
+{
+	struct tm_sub_probe *probe = private_data;
+
+	WRITE_ONCE(probe->above, above);
+	atomic_inc(&probe->transitions);
+	complete(&probe->changed);
+}
+
+static bool tm_sub_probe_wait(struct tm_sub_probe *probe)
+{
+	return wait_for_completion_timeout(&probe->changed,
+					   msecs_to_jiffies(20 * TRAFFIC_MONITOR_INTERVAL_MS));
+}
+
+static void tm_test_subscription_transitions(struct kunit *test)
+{
+	struct net_device *dev = tm_test_dev(test);
+	struct traffic_subscription_init init = {
+		.ifname = dev->name,
+		.metric = TRAFFIC_METRIC_TX_BYTES,
+		.enter = 2 * TM_TEST_RATE,
+		.exit = 3 * TM_TEST_RATE / 2,
+		.func = tm_sub_probe_func,
+	};
+	struct traffic_subscription *sub;
+	struct tm_sub_probe probe;
+
+	atomic_set(&probe.transitions, 0);
+	probe.above = false;
+	init_completion(&probe.changed);
+	init.private_data = &probe;
+
+	sub = traffic_subscribe(&init);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, sub);
+
+	/* Below the band, nothing to deliver */
+	msleep(5 * TRAFFIC_MONITOR_INTERVAL_MS);
+	KUNIT_EXPECT_EQ(test, atomic_read(&probe.transitions), 0);
+
+	wlbt_test_netdev_set_rate(dev, 4 * TM_TEST_RATE);
+	KUNIT_EXPECT_TRUE(test, tm_sub_probe_wait(&probe));
+	KUNIT_EXPECT_TRUE(test, READ_ONCE(probe.above));
+
+	reinit_completion(&probe.changed);
+	wlbt_test_netdev_set_rate(dev, TM_TEST_RATE);
+	KUNIT_EXPECT_TRUE(test, tm_sub_probe_wait(&probe));
+	KUNIT_EXPECT_FALSE(test, READ_ONCE(probe.above));
+
+	traffic_unsubscribe(sub);
+	KUNIT_EXPECT_EQ(test, atomic_read(&probe.transitions), 2);
+}
+
+static struct kunit_case tm_test_cases[] = {
+	KUNIT_CASE(tm_test_unknown_device),
+	KUNIT_CASE(tm_test_subscribe_invalid),
+	KUNIT_CASE(tm_test_subscribe),
+	KUNIT_CASE_SLOW(tm_test_rates),
+	KUNIT_CASE_SLOW(tm_test_window),
+	KUNIT_CASE_SLOW(tm_test_idle_backoff),
+	KUNIT_CASE_SLOW(tm_test_subscription_transitions),
+	{}
+};
+
+static struct kunit_suite tm_test_suite = {
+	.name = "wlbt_traffic_monitor",
+	.suite_init = tm_suite_init,
+	.suite_exit = tm_suite_exit,
+	.init = tm_test_init,
+	.exit = tm_test_exit,
+	.test_cases = tm_test_cases,
+};
+
+kunit_test_suites(&wdog_test_suite, &sw_test_suite, &tm_test_suite);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("KUnit tests of the WLBT monitoring libraries");
@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * WLBT Monitoring Library Module
+ *
+ * Links the watchdog, state watcher and traffic monitor libraries into one
+ * module, wlbt_monitoring.ko, that exports their APIs. The libraries have
+ * no module init of their own: each user initializes the parts it needs
+ * (watchdog_init(), state_watcher_init(), init_traffic_monitor()). The
+ * traffic monitor parameters are set on this module, e.g.
+ * "modprobe wlbt_monitoring devices=eth*".
+ */
+
+#include <linux/module.h>
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Watchdog, state watcher and traffic monitor libraries");
@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Dummy network device with synthetic counters, shared by wlbt_bench.ko
+ * and wlbt_kunit.ko to drive the traffic monitor without real traffic.
+ *
+ * The device reports counters that grow at a settable byte rate: tx_bytes
+ * at the rate, rx_bytes at half of it, both in 1500 byte packets. Packets
+ * sent to it are dropped.
+ */
+#ifndef _WLBT_TEST_NETDEV_H
+#define _WLBT_TEST_NETDEV_H
+
+#include <linux/err.h>
+#include <linux/etherdevice.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/netdevice.h>
+#include <linux/rtnetlink.h>
+#include <linux/spinlock.h>
+
+#define WLBT_TEST_NETDEV_PKT_SIZE 1500
+
+/**
+ * struct wlbt_test_netdev - Private data of a dummy device
+ * @lock: Serializes rate changes against counter reads
+ * @since_ns: Time of the last rate change
+ * @base_bytes: tx_bytes at @since_ns
+ * @rate: Transmitted bytes per second since @since_ns
+ */
+struct wlbt_test_netdev {
+	spinlock_t lock;
+	u64 since_ns;
+	u64 base_bytes;
+	u64 rate;
+};
+
+/* Context: Caller holds priv->lock */
+static inline u64 wlbt_test_netdev_bytes(const struct wlbt_test_netdev *priv, u64 now)
+{
+	u64 elapsed_us = div_u64(now - priv->since_ns, NSEC_PER_USEC);
+
+	return priv->base_bytes + div64_u64(elapsed_us * priv->rate, USEC_PER_SEC);
+}
+
+static inline netdev_tx_t wlbt_test_netdev_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	dev_kfree_skb(skb);
+	return NETDEV_TX_OK;
+}
+
+static inline void wlbt_test_netdev_get_stats64(struct net_device *dev,
+						struct rtnl_link_stats64 *stats)
+{
+	struct wlbt_test_netdev *priv = netdev_priv(dev);
+	unsigned long flags;
+	u64 bytes;
+
+	spin_lock_irqsave(&priv->lock, flags);
+	bytes = wlbt_test_netdev_bytes(priv, ktime_get_ns());
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	stats->tx_bytes = bytes;
+	stats->tx_packets = div_u64(bytes, WLBT_TEST_NETDEV_PKT_SIZE);
+	stats->rx_bytes = bytes / 2;
+	stats->rx_packets = div_u64(bytes / 2, WLBT_TEST_NETDEV_PKT_SIZE);
+}
+
+static const struct net_device_ops wlbt_test_netdev_ops = {
+	.ndo_start_xmit = wlbt_test_netdev_xmit,
+	.ndo_get_stats64 = wlbt_test_netdev_get_stats64,
+};
+
+static inline void wlbt_test_netdev_setup(struct net_device *dev)
+{
+	ether_setup(dev);
+	dev->netdev_ops = &wlbt_test_netdev_ops;
+	dev->flags |= IFF_NOARP;
+	eth_hw_addr_random(dev);
+}
+
+/**
+ * wlbt_test_netdev_set_rate - Change the transmit byte rate of a dummy device
+ * @dev: Device from wlbt_test_netdev_create()
+ * @rate: New rate in bytes per second, the counters continue from their
+ *        current values
+ */
+static inline void wlbt_test_netdev_set_rate(struct net_device *dev, u64 rate)
+{
+	struct wlbt_test_netdev *priv = netdev_priv(dev);
+	unsigned long flags;
+	u64 now;
+
+	spin_lock_irqsave(&priv->lock, flags);
+	now = ktime_get_ns();
+	priv->base_bytes = wlbt_test_netdev_bytes(priv, now);
+	priv->since_ns = now;
+	priv->rate = rate;
+	spin_unlock_irqrestore(&priv->lock, flags);
+}
+
+/**
+ * wlbt_test_netdev_create - Register and open a dummy device
+ * @name: Name or format with one %d, e.g. "wlbtb%d"
+ * @rate: Initial transmit rate in bytes per second
+ *
+ * Context: Process context, takes rtnl_lock()
+ * Return: The device, or an ERR_PTR() on failure
+ */
+static inline struct net_device *wlbt_test_netdev_create(const char *name, u64 rate)
+{
+	struct wlbt_test_netdev *priv;
+	struct net_device *dev;
+	int ret;
+
+	dev = alloc_netdev(sizeof(*priv), name, NET_NAME_ENUM, wlbt_test_netdev_setup);
+	if (!dev)
+		return ERR_PTR(-ENOMEM);
+
+	priv = netdev_priv(dev);
+	spin_lock_init(&priv->lock);
+	priv->since_ns = ktime_get_ns();
+	priv->rate = rate;
+
+	ret = register_netdev(dev);
+	if (ret) {
+		free_netdev(dev);
+		return ERR_PTR(ret);
+	}
+
+	rtnl_lock();
+	ret = dev_open(dev, NULL);
+	rtnl_unlock();
+	if (ret) {
+		unregister_netdev(dev);
+		free_netdev(dev);
+		return ERR_PTR(ret);
+	}
+
+	return dev;
+}
+
+/**
+ * wlbt_test_netdev_destroy - Unregister and free a dummy device
+ * @dev: Device from wlbt_test_netdev_create()
+ *
+ * Context: Process context, takes rtnl_lock()
+ */
+static inline void wlbt_test_netdev_destroy(struct net_device *dev)
+{
+	unregister_netdev(dev);
+	free_netdev(dev);
+}
+
+#endif /* _WLBT_TEST_NETDEV_H */